@@ -0,0 +1,243 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <compressor.hpp>
+#include <cxxopts.hpp>
+#include <format>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Measures request body compression of cppurl::compressor on generated json
+ * notifications of typical sizes: the bytes saved, the cpu time per request
+ * and the number of allocations per request once the compressor is warm.
+ * Every compressed body is checked to decompress to the original one.
+ */
+
+
+/*
+ * Every allocation (of the compressors of zlib and zstd as well) is counted by
+ * interposing the allocation functions of glibc.
+ */
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *p, size_t size);
+}
+
+
+namespace {
+
+    std::atomic<size_t> allocations{0};
+
+}  // namespace
+
+
+extern "C" auto malloc(size_t size) -> void * {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+
+extern "C" auto calloc(size_t n, size_t size) -> void * {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+
+extern "C" auto realloc(void *p, size_t size) -> void * {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+
+namespace {
+
+    struct method {
+        cppurl::compression compression{};
+        int level{};
+    };
+
+
+    auto thread_cpu_time() -> std::chrono::microseconds {
+        rusage usage{};
+        getrusage(RUSAGE_THREAD, &usage);
+        return std::chrono::seconds{usage.ru_utime.tv_sec +
+                                    usage.ru_stime.tv_sec} +
+               std::chrono::microseconds{usage.ru_utime.tv_usec +
+                                         usage.ru_stime.tv_usec};
+    }
+
+
+    auto parse_list(const std::string &list) -> std::vector<size_t> {
+        std::vector<size_t> values{};
+        std::istringstream in{list};
+        for (std::string item{}; std::getline(in, item, ',');) {
+            values.push_back(std::stoul(item));
+        }
+        return values;
+    }
+
+
+    /**
+     * @brief      Generates newline separated json notifications until the
+     * body has at least size bytes.
+     */
+    auto generate(size_t size, std::mt19937_64 &random) -> std::string {
+        static constexpr std::array events{"order.created",
+                                           "order.paid",
+                                           "order.shipped",
+                                           "user.signed_up",
+                                           "user.password_changed",
+                                           "invoice.overdue"};
+        static constexpr std::array currencies{"EUR", "USD", "PLN", "GBP"};
+        std::string body{};
+        while (body.size() < size) {
+            auto id{random() % 100'000'000};
+            body += std::format(
+                "{{\"id\":{},\"event\":\"{}\",\"user\":\"user_{}\","
+                "\"timestamp\":\"2024-05-{:02}T{:02}:{:02}:{:02}.{:03}Z\","
+                "\"amount\":{}.{:02},\"currency\":\"{}\",\"attempt\":{},"
+                "\"tags\":[\"notification\",\"{}\"]}}\n",
+                id,
+                events[random() % events.size()],
+                random() % 1'000'000,
+                1 + random() % 28,
+                random() % 24,
+                random() % 60,
+                random() % 60,
+                random() % 1000,
+                random() % 10000,
+                random() % 100,
+                currencies[random() % currencies.size()],
+                random() % 3,
+                id % 2 == 0 ? "priority" : "bulk");
+        }
+        body.resize(size);
+        return body;
+    }
+
+
+    auto decompress(cppurl::compression c,
+                    std::string_view compressed,
+                    size_t size) -> std::string {
+        std::string out(size, '\0');
+        if (c == cppurl::compression::gzip) {
+            z_stream z{};
+            inflateInit2(&z, 15 + 16);
+            z.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(compressed.data()));
+            z.avail_in = static_cast<uInt>(compressed.size());
+            z.next_out = reinterpret_cast<Bytef *>(out.data());
+            z.avail_out = static_cast<uInt>(out.size());
+            auto ok{inflate(&z, Z_FINISH) == Z_STREAM_END};
+            inflateEnd(&z);
+            if (!ok) { out.clear(); }
+        }
+#ifdef CPPURL_WITH_ZSTD
+        if (c == cppurl::compression::zstd) {
+            auto n{ZSTD_decompress(
+                out.data(), out.size(), compressed.data(), compressed.size())};
+            if (ZSTD_isError(n)) { out.clear(); }
+        }
+#endif
+        return out;
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options("compress_bench",
+                             "Measures compression of request bodies\n\n");
+    options.add_options()(
+        "payload-sizes",
+        "comma separated list of body sizes in bytes",
+        cxxopts::value<std::string>()->default_value(
+            "256,1024,4096,16384,65536"))(
+        "megabytes",
+        "bytes compressed by every configuration in MiB",
+        cxxopts::value<int>()->default_value("64"))("h,help", "Usage");
+    auto result{options.parse(argc, argv)};
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    auto volume{
+        static_cast<size_t>(std::max(result["megabytes"].as<int>(), 1)) *
+        1024 * 1024};
+    std::vector<method> methods{{cppurl::compression::gzip, 1},
+                                {cppurl::compression::gzip, 6}};
+    if (cppurl::compressor::has_zstd()) {
+        methods.push_back({cppurl::compression::zstd, 1});
+        methods.push_back({cppurl::compression::zstd, 3});
+    }
+
+    std::cout << std::format("{:>8} {:>6} {:>6} {:>10} {:>8} {:>10} {:>10} "
+                             "{:>10}\n",
+                             "payload",
+                             "method",
+                             "level",
+                             "compressed",
+                             "saved %",
+                             "us/req",
+                             "MB/s",
+                             "allocs/req");
+    std::mt19937_64 random{42};
+    for (auto size : parse_list(result["payload-sizes"].as<std::string>())) {
+        /*a few distinct bodies, so that caches do not flatter the result*/
+        std::vector<std::string> bodies{};
+        for (int i{0}; i < 16; ++i) {
+            bodies.push_back(generate(size, random));
+        }
+        auto requests{std::max(volume / std::max(size, size_t{1}),
+                               bodies.size())};
+        for (auto m : methods) {
+            cppurl::compressor c{{.method = m.compression,
+                                  .min_size = 0,
+                                  .level = m.level}};
+            size_t compressed{0};
+            for (const auto &body : bodies) {
+                auto out{c.compress(body)};
+                auto view{out ? *out : std::string_view{body}};
+                if (out && decompress(m.compression, view, size) != body) {
+                    throw std::runtime_error{"round trip failed"};
+                }
+                compressed += view.size();
+            }
+            auto allocations_start{
+                allocations.load(std::memory_order_relaxed)};
+            auto cpu_start{thread_cpu_time()};
+            for (size_t i{0}; i < requests; ++i) {
+                static_cast<void>(c.compress(bodies[i % bodies.size()]));
+            }
+            auto cpu{std::chrono::duration<double, std::micro>{
+                thread_cpu_time() - cpu_start}
+                         .count()};
+            auto allocated{allocations.load(std::memory_order_relaxed) -
+                           allocations_start};
+            auto mean{static_cast<double>(compressed) /
+                      static_cast<double>(bodies.size())};
+            std::cout << std::format(
+                "{:>8} {:>6} {:>6} {:>10.0f} {:>8.1f} {:>10.2f} {:>10.0f} "
+                "{:>10.3f}\n",
+                size,
+                cppurl::compressor::name(m.compression),
+                m.level,
+                mean,
+                100.0 * (1.0 - mean / static_cast<double>(size)),
+                cpu / static_cast<double>(requests),
+                static_cast<double>(size * requests) / cpu,
+                static_cast<double>(allocated) /
+                    static_cast<double>(requests));
+            std::cout.flush();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cxxopts.hpp>
+#include <event_loop.hpp>
+#include <memory>
+#include <notifier.hpp>
+#include <vector>
+
+/*
+ * Compares poll and socket action engines. Keeps a given number of post
+ * requests in flight against --url and reports CPU time per request and p99
+ * latency of a single request.
+ */
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct result {
+        double cpu_us_per_request{};
+        double p99_ms{};
+        double requests_per_second{};
+    };
+
+
+    auto cpu_time() -> std::chrono::microseconds {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return std::chrono::seconds{usage.ru_utime.tv_sec +
+                                    usage.ru_stime.tv_sec} +
+               std::chrono::microseconds{usage.ru_utime.tv_usec +
+                                         usage.ru_stime.tv_usec};
+    }
+
+
+    auto raise_file_limit() {
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+
+    auto run(cppurl::engine e,
+             std::string_view url,
+             size_t in_flight,
+             size_t total) -> std::expected<result, cppurl::notifier::status> {
+        assert(total > 0);
+        cppurl::nb_handle mhandle{};
+        std::optional<cppurl::event_loop> loop{};
+        if (e == cppurl::engine::socket_action) { loop.emplace(mhandle); }
+        UNEXP_FORWARD_ERROR(mhandle.maximal_number_of_connections(
+            static_cast<int64_t>(in_flight)));
+
+        auto handles{std::make_unique<cppurl::b_handle[]>(in_flight)};
+        std::vector<clock_type::time_point> started(in_flight);
+        std::vector<double> latencies{};
+        latencies.reserve(total);
+        std::string body(256, 'x');
+        size_t launched{0};
+
+        auto launch{[&](size_t i) -> cppurl::notifier::status {
+            auto &h{handles[i]};
+            FORWARD_ERROR(h.post<false>(body));
+            started[i] = clock_type::now();
+            ++launched;
+            return mhandle.add(h);
+        }};
+
+        for (size_t i{0}; i < in_flight; ++i) {
+            UNEXP_FORWARD_ERROR(handles[i].url(url));
+            UNEXP_FORWARD_ERROR(handles[i].write(
+                +[](char *, size_t n, size_t l, void *) { return n * l; }));
+        }
+        auto cpu_start{cpu_time()};
+        auto wall_start{clock_type::now()};
+        for (size_t i{0}; i < std::min(in_flight, total); ++i) {
+            UNEXP_FORWARD_ERROR(launch(i));
+        }
+        while (true) {
+            if (!loop) { UNEXP_FORWARD_UNEXPECTED(mhandle.perform()); }
+            for (auto info{mhandle.info()}; info.first; info = mhandle.info()) {
+                auto h{info.first.handle()};
+                UNEXP_FORWARD_UNEXPECTED(h);
+                auto i{static_cast<size_t>(*h - handles.get())};
+                latencies.push_back(
+                    std::chrono::duration<double, std::milli>{
+                        clock_type::now() - started[i]}
+                        .count());
+                UNEXP_FORWARD_ERROR(mhandle.remove(**h));
+                if (launched < total) { UNEXP_FORWARD_ERROR(launch(i)); }
+            }
+            if (latencies.size() >= total) { break; }
+            if (loop) {
+                UNEXP_FORWARD_UNEXPECTED(loop->wait(-1));
+            } else {
+                UNEXP_FORWARD_UNEXPECTED(mhandle.wait(100));
+            }
+        }
+        auto wall{
+            std::chrono::duration<double>{clock_type::now() - wall_start}};
+        auto cpu{cpu_time() - cpu_start};
+        std::ranges::sort(latencies);
+        return result{
+            static_cast<double>(cpu.count()) / static_cast<double>(total),
+            latencies[latencies.size() * 99 / 100],
+            static_cast<double>(total) / wall.count()};
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options("engine_bench",
+                             "Compares poll and socket action engines\n\n");
+    options.add_options()(
+        "u,url", "the post url", cxxopts::value<std::string>())(
+        "r,rounds",
+        "requests per in-flight handle",
+        cxxopts::value<int>()->default_value("10")) /**/ ("h,help", "Usage");
+    auto result{options.parse(argc, argv)};
+    if (result.count("help") || !result.count("url")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    raise_file_limit();
+    cppurl::curl_global global{};
+    auto url{result["url"].as<std::string>()};
+    auto rounds{static_cast<size_t>(result["rounds"].as<int>())};
+
+    std::cout << std::format("{:>14} {:>10} {:>14} {:>10} {:>12}\n",
+                             "engine",
+                             "in flight",
+                             "cpu us/req",
+                             "p99 ms",
+                             "req/s");
+    for (auto in_flight : {size_t{1000}, size_t{10000}}) {
+        for (auto [e, name] : {std::pair{cppurl::engine::poll, "poll"},
+                               std::pair{cppurl::engine::socket_action,
+                                         "socket_action"}}) {
+            auto r{run(e, url, in_flight, in_flight * rounds)};
+            if (!r) {
+                std::cout << std::format("{:>14} {:>10} failed: {}\n",
+                                         name,
+                                         in_flight,
+                                         r.error().what());
+                continue;
+            }
+            std::cout << std::format("{:>14} {:>10} {:>14.2f} {:>10.2f} "
+                                     "{:>12.0f}\n",
+                                     name,
+                                     in_flight,
+                                     r->cpu_us_per_request,
+                                     r->p99_ms,
+                                     r->requests_per_second);
+        }
+    }
+    return 0;
+}
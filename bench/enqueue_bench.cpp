@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <charconv>
+#include <cxxopts.hpp>
+#include <metrics.hpp>
+#include <notifier.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loopback_server.hpp"
+
+/*
+ * Measures submit-to-completion latency of notifier::enqueue against an
+ * in-process loopback server. Producer threads enqueue requests at a fixed
+ * pace (so that the notifier is idle most of the time and has to be woken
+ * up), the transfer callback records the time from enqueue() to completion
+ * of the transfer and the time spent in enqueue() is recorded separately.
+ */
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct result {
+        cppurl::latency_histogram end_to_end{};
+        cppurl::latency_histogram submit{};
+        size_t rejected{0};
+        size_t failed{0};
+    };
+
+
+    auto ms(std::chrono::microseconds d) {
+        return std::chrono::duration<double, std::milli>{d}.count();
+    }
+
+
+    /**
+     * @brief      Runs producers against a notifier driven by a given engine.
+     * Every request is {"id":i}, the id indexes the enqueue times.
+     */
+    auto run(cppurl::engine engine,
+             size_t producers,
+             size_t per_producer,
+             std::chrono::microseconds pace,
+             result &r) -> cppurl::notifier::status {
+        bench::loopback_server server{};
+        auto url{server.url()};
+        cppurl::notifier n{
+            url,
+            std::chrono::seconds{1},
+            cppurl::notifier_options{
+                .engine = engine,
+                /*responses are captured, so that they are not printed*/
+                .max_response_size = 64,
+                .read_stdin = false,
+                .submission_capacity = 4096}};
+        auto total{producers * per_producer};
+        std::vector<clock_type::time_point> enqueued(total);
+        size_t done{0};
+        std::atomic<size_t> rejected{0};
+        auto complete{[&](cppurl::handle_info info,
+                           bool ok) -> cppurl::notifier::status {
+            auto h{info.handle()};
+            FORWARD_UNEXPECTED(h);
+            auto body{(*h)->body()};
+            size_t id{};
+            std::from_chars(body.data() + body.find(':') + 1,
+                            body.data() + body.size(),
+                            id);
+            r.end_to_end.record(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    clock_type::now() - enqueued[id]));
+            r.failed += ok ? 0 : 1;
+            if (++done + rejected == total) { n.stop(); }
+            return cppurl::status_ok;
+        }};
+        std::vector<std::thread> threads{};
+        for (size_t p{0}; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                for (size_t i{0}; i < per_producer; ++i) {
+                    auto id{p * per_producer + i};
+                    auto body{std::format("{{\"id\":{}}}", id)};
+                    auto start{clock_type::now()};
+                    enqueued[id] = start;
+                    if (!n.enqueue(std::move(body))) { ++rejected; }
+                    r.submit.record(
+                        std::chrono::duration_cast<std::chrono::microseconds>(
+                            clock_type::now() - start));
+                    std::this_thread::sleep_for(pace);
+                }
+            });
+        }
+        auto status{n.run(
+            [&](cppurl::handle_info info) -> cppurl::notifier::status {
+                return complete(info, true);
+            },
+            [&](cppurl::handle_info info) -> cppurl::notifier::status {
+                return complete(info, false);
+            })};
+        for (auto &t : threads) { t.join(); }
+        r.rejected = rejected;
+        return status;
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options(
+        "enqueue_bench",
+        "Measures submit-to-wire latency of notifier::enqueue\n\n");
+    options.add_options()(
+        "p,producers",
+        "number of producer threads",
+        cxxopts::value<int>()->default_value("4"))(
+        "n,requests",
+        "number of requests of every producer",
+        cxxopts::value<int>()->default_value("2000"))(
+        "pace",
+        "pause of a producer between requests in microseconds",
+        cxxopts::value<int>()->default_value("500")) /**/ ("h,help",
+                                                          "Usage");
+    auto parsed{options.parse(argc, argv)};
+    if (parsed.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    cppurl::curl_global global{};
+    auto producers{static_cast<size_t>(
+        std::max(parsed["producers"].as<int>(), 1))};
+    auto per_producer{static_cast<size_t>(
+        std::max(parsed["requests"].as<int>(), 1))};
+    std::chrono::microseconds pace{std::max(parsed["pace"].as<int>(), 0)};
+
+    std::cout << std::format("{:>14} {:>10} {:>10} {:>10} {:>12} {:>9} "
+                             "{:>7}\n",
+                             "engine",
+                             "p50 ms",
+                             "p99 ms",
+                             "p999 ms",
+                             "enq p99 us",
+                             "rejected",
+                             "failed");
+    for (auto [name, engine] :
+         {std::pair{"poll", cppurl::engine::poll},
+          std::pair{"socket_action", cppurl::engine::socket_action}}) {
+        result r{};
+        auto status{run(engine, producers, per_producer, pace, r)};
+        if (!status) {
+            std::cout << std::format(
+                "{:>14} failed: {}\n", name, status.what());
+            continue;
+        }
+        std::cout << std::format(
+            "{:>14} {:>10.3f} {:>10.3f} {:>10.3f} {:>12} {:>9} {:>7}\n",
+            name,
+            ms(r.end_to_end.quantile(0.5)),
+            ms(r.end_to_end.quantile(0.99)),
+            ms(r.end_to_end.quantile(0.999)),
+            r.submit.quantile(0.99).count(),
+            r.rejected,
+            r.failed);
+    }
+    return 0;
+}
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Minimal HTTP/1.1 and HTTP/2 (h2c with prior knowledge) receiver of post
+ * requests running in its own thread on 127.0.0.1. It answers every request
+ * with "ok" after a configurable delay, and fails a configurable fraction of
+ * them with 503 or by resetting the connection. HTTP/2 request headers are
+ * not decoded (the answer does not depend on them), so no HPACK state is
+ * kept.
+ */
+
+
+namespace bench {
+
+
+    /**
+     * @brief      Behaviour of the loopback server.
+     */
+    struct server_options {
+        /*delay of every response*/
+        std::chrono::microseconds delay{0};
+        /*fraction of requests answered with 503*/
+        double error_rate{0.0};
+        /*fraction of requests answered by resetting the connection*/
+        double reset_rate{0.0};
+    };
+
+
+    /**
+     * @brief      Loopback HTTP/1.1 and HTTP/2 server.
+     */
+    class loopback_server {
+      private:
+        using clock_type = std::chrono::steady_clock;
+
+        static constexpr std::string_view http2_preface{
+            "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"};
+        static constexpr size_t frame_header_size{9};
+        static constexpr uint32_t max_window{0x7fffffff};
+        static constexpr int max_events{256};
+        /*epoll ids of the stop eventfd and the listening socket (connections
+         * get ids from 1 up)*/
+        static constexpr uint64_t stop_id{0};
+        static constexpr uint64_t listen_id{UINT64_MAX};
+
+        enum frame_type : uint8_t {
+            data = 0x0,
+            headers = 0x1,
+            settings = 0x4,
+            ping = 0x6,
+            goaway = 0x7,
+            window_update = 0x8,
+        };
+
+        enum frame_flag : uint8_t {
+            end_stream = 0x1,
+            ack = 0x1,
+            end_headers = 0x4,
+        };
+
+        enum class protocol { unknown, http1, http2 };
+
+
+        /**
+         * @brief      Accepted connection.
+         */
+        struct connection {
+            int fd{-1};
+            protocol proto{protocol::unknown};
+            std::string in{};
+            std::string out{};
+            /*http/1.1: 100 Continue was sent for the current request*/
+            bool continued{false};
+            /*http/2: bytes of data received since the last window update*/
+            uint32_t consumed{0};
+            bool writable{true};
+        };
+
+
+        /**
+         * @brief      Response waiting for its delay.
+         */
+        struct delayed_response {
+            clock_type::time_point due{};
+            uint64_t connection{};
+            uint32_t stream{};
+            int status{};
+
+            auto operator>(const delayed_response &other) const {
+                return due > other.due;
+            }
+        };
+
+      private:
+        server_options _options{};
+        int _listen_fd{-1};
+        int _epoll_fd{-1};
+        int _stop_fd{-1};
+        uint16_t _port{};
+        uint64_t _next_id{1};
+        std::unordered_map<uint64_t, std::unique_ptr<connection>>
+            _connections{};
+        std::priority_queue<delayed_response,
+                            std::vector<delayed_response>,
+                            std::greater<>>
+            _delayed{};
+        std::minstd_rand _random{std::random_device{}()};
+        std::uniform_real_distribution<double> _uniform{0.0, 1.0};
+        std::thread _thread{};
+
+      private:
+        static auto put24(std::string &out, uint32_t v) {
+            out.push_back(static_cast<char>((v >> 16) & 0xff));
+            out.push_back(static_cast<char>((v >> 8) & 0xff));
+            out.push_back(static_cast<char>(v & 0xff));
+        }
+
+
+        static auto put32(std::string &out, uint32_t v) {
+            out.push_back(static_cast<char>((v >> 24) & 0xff));
+            put24(out, v & 0xffffff);
+        }
+
+
+        static auto get32(std::string_view in) -> uint32_t {
+            return (static_cast<uint32_t>(static_cast<uint8_t>(in[0])) << 24) |
+                   (static_cast<uint32_t>(static_cast<uint8_t>(in[1])) << 16) |
+                   (static_cast<uint32_t>(static_cast<uint8_t>(in[2])) << 8) |
+                   static_cast<uint32_t>(static_cast<uint8_t>(in[3]));
+        }
+
+
+        static auto frame(std::string &out,
+                          uint8_t type,
+                          uint8_t flags,
+                          uint32_t stream,
+                          std::string_view payload = {}) {
+            put24(out, static_cast<uint32_t>(payload.size()));
+            out.push_back(static_cast<char>(type));
+            out.push_back(static_cast<char>(flags));
+            put32(out, stream & max_window);
+            out.append(payload);
+        }
+
+
+        /**
+         * @brief      Decides the fate of a request: 200, 503 or 0 (reset).
+         */
+        auto outcome() -> int {
+            auto x{_uniform(_random)};
+            if (x < _options.reset_rate) { return 0; }
+            if (x < _options.reset_rate + _options.error_rate) { return 503; }
+            return 200;
+        }
+
+
+        auto close(uint64_t id, bool reset) {
+            auto it{_connections.find(id)};
+            if (it == _connections.end()) { return; }
+            if (reset) {
+                linger l{1, 0};
+                setsockopt(
+                    it->second->fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+            }
+            ::close(it->second->fd);
+            _connections.erase(it);
+        }
+
+
+        /**
+         * @brief      Sends as much of the output buffer as possible. Returns
+         * false iff the connection was closed.
+         */
+        auto flush(uint64_t id, connection &c) -> bool {
+            while (!c.out.empty()) {
+                auto n{::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL)};
+                if (n > 0) {
+                    c.out.erase(0, static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) { continue; }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                close(id, false);
+                return false;
+            }
+            auto writable{c.out.empty()};
+            if (writable != c.writable) {
+                epoll_event ev{};
+                ev.events = EPOLLIN | (writable ? 0u : EPOLLOUT);
+                ev.data.u64 = id;
+                epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+                c.writable = writable;
+            }
+            return true;
+        }
+
+
+        /**
+         * @brief      Appends a response to the output buffer of a
+         * connection.
+         */
+        static auto respond(connection &c, uint32_t stream, int status) {
+            if (c.proto == protocol::http1) {
+                c.out += std::format(
+                    "HTTP/1.1 {} {}\r\nContent-Length: 2\r\n\r\nok",
+                    status,
+                    status == 200 ? "OK" : "Service Unavailable");
+                return;
+            }
+            /*:status 200 is entry 8 of the static table, others are literals
+             * with its name*/
+            auto block{status == 200
+                           ? std::string{"\x88"}
+                           : std::format("\x08\x03{}", status)};
+            frame(c.out, headers, end_headers, stream, block);
+            frame(c.out, data, end_stream, stream, "ok");
+        }
+
+
+        /**
+         * @brief      Answers a complete request now or after the delay.
+         * Returns false iff the connection was reset.
+         */
+        auto complete(uint64_t id, connection &c, uint32_t stream) -> bool {
+            auto status{outcome()};
+            if (status == 0) {
+                close(id, true);
+                return false;
+            }
+            if (_options.delay.count() > 0) {
+                _delayed.push(
+                    {clock_type::now() + _options.delay, id, stream, status});
+                return true;
+            }
+            respond(c, stream, status);
+            return true;
+        }
+
+
+        /**
+         * @brief      Parses http/1.1 requests in the input buffer. Returns
+         * false iff the connection was closed.
+         */
+        auto parse_http1(uint64_t id, connection &c) -> bool {
+            while (true) {
+                auto end{c.in.find("\r\n\r\n")};
+                if (end == std::string::npos) { return true; }
+                std::string head{c.in.substr(0, end)};
+                std::ranges::transform(head, head.begin(), [](char ch) {
+                    return static_cast<char>(std::tolower(ch));
+                });
+                size_t length{0};
+                if (auto at{head.find("content-length:")};
+                    at != std::string::npos) {
+                    length = std::stoul(head.substr(at + 15));
+                }
+                auto size{end + 4 + length};
+                if (c.in.size() < size) {
+                    auto expects{head.find("expect: 100-continue") !=
+                                 std::string::npos};
+                    if (expects && !c.continued) {
+                        c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                        c.continued = true;
+                    }
+                    return true;
+                }
+                c.in.erase(0, size);
+                c.continued = false;
+                if (!complete(id, c, 0)) { return false; }
+            }
+        }
+
+
+        /**
+         * @brief      Parses http/2 frames in the input buffer. Returns false
+         * iff the connection was closed.
+         */
+        auto parse_http2(uint64_t id, connection &c) -> bool {
+            size_t at{0};
+            while (c.in.size() - at >= frame_header_size) {
+                std::string_view f{c.in.data() + at, c.in.size() - at};
+                auto length{(static_cast<uint32_t>(static_cast<uint8_t>(f[0]))
+                             << 16) |
+                            (static_cast<uint32_t>(static_cast<uint8_t>(f[1]))
+                             << 8) |
+                            static_cast<uint32_t>(static_cast<uint8_t>(f[2]))};
+                if (f.size() < frame_header_size + length) { break; }
+                auto type{static_cast<uint8_t>(f[3])};
+                auto flags{static_cast<uint8_t>(f[4])};
+                auto stream{get32(f.substr(5)) & max_window};
+                auto payload{f.substr(frame_header_size, length)};
+                at += frame_header_size + length;
+                switch (type) {
+                    case data: {
+                        /*keep the connection window open (it starts at its
+                         * maximum, see detect)*/
+                        c.consumed += length;
+                        if (c.consumed >= max_window / 2) {
+                            std::string increment{};
+                            put32(increment, c.consumed);
+                            frame(c.out, window_update, 0, 0, increment);
+                            c.consumed = 0;
+                        }
+                        if ((flags & end_stream) && !complete(id, c, stream)) {
+                            return false;
+                        }
+                        break;
+                    }
+                    case headers:
+                        if ((flags & end_stream) && !complete(id, c, stream)) {
+                            return false;
+                        }
+                        break;
+                    case settings:
+                        if (!(flags & ack)) { frame(c.out, settings, ack, 0); }
+                        break;
+                    case ping:
+                        if (!(flags & ack)) {
+                            frame(c.out, ping, ack, 0, payload);
+                        }
+                        break;
+                    case goaway:
+                        close(id, false);
+                        return false;
+                    default:
+                        break;
+                }
+            }
+            c.in.erase(0, at);
+            return true;
+        }
+
+
+        /**
+         * @brief      Detects the protocol of a new connection.
+         */
+        auto detect(connection &c) -> bool {
+            if (c.in.size() < http2_preface.size() &&
+                http2_preface.starts_with(c.in)) {
+                return false;
+            }
+            if (!c.in.starts_with(http2_preface)) {
+                c.proto = protocol::http1;
+                return true;
+            }
+            c.proto = protocol::http2;
+            c.in.erase(0, http2_preface.size());
+            /*many streams with large windows, so that the client is never
+             * throttled by the server*/
+            std::string s{};
+            s += std::string{"\x00\x03", 2};
+            put32(s, 100000);
+            s += std::string{"\x00\x04", 2};
+            put32(s, max_window);
+            frame(c.out, settings, 0, 0, s);
+            std::string increment{};
+            put32(increment, max_window - 65535);
+            frame(c.out, window_update, 0, 0, increment);
+            return true;
+        }
+
+
+        auto on_readable(uint64_t id) {
+            auto it{_connections.find(id)};
+            if (it == _connections.end()) { return; }
+            auto &c{*it->second};
+            char buffer[64 * 1024];
+            while (true) {
+                auto n{::recv(c.fd, buffer, sizeof(buffer), 0)};
+                if (n > 0) {
+                    c.in.append(buffer, static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR) { continue; }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                close(id, false);
+                return;
+            }
+            if (c.proto == protocol::unknown && !detect(c)) { return; }
+            auto open{c.proto == protocol::http1 ? parse_http1(id, c)
+                                                 : parse_http2(id, c)};
+            if (open) { flush(id, c); }
+        }
+
+
+        auto on_acceptable() {
+            while (true) {
+                auto fd{::accept4(_listen_fd,
+                                  nullptr,
+                                  nullptr,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC)};
+                if (fd == -1) { return; }
+                int one{1};
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                auto id{_next_id++};
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.u64 = id;
+                epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+                auto c{std::make_unique<connection>()};
+                c->fd = fd;
+                _connections.emplace(id, std::move(c));
+            }
+        }
+
+
+        /**
+         * @brief      Sends delayed responses which are due.
+         *
+         * @return     Milliseconds until the next one (-1 if none)
+         */
+        auto send_due() -> int {
+            std::vector<uint64_t> touched{};
+            auto now{clock_type::now()};
+            while (!_delayed.empty() && _delayed.top().due <= now) {
+                auto r{_delayed.top()};
+                _delayed.pop();
+                auto it{_connections.find(r.connection)};
+                if (it == _connections.end()) { continue; }
+                respond(*it->second, r.stream, r.status);
+                touched.push_back(r.connection);
+            }
+            for (auto id : touched) {
+                if (auto it{_connections.find(id)}; it != _connections.end()) {
+                    flush(id, *it->second);
+                }
+            }
+            if (_delayed.empty()) { return -1; }
+            return static_cast<int>(
+                std::chrono::ceil<std::chrono::milliseconds>(
+                    _delayed.top().due - now)
+                    .count());
+        }
+
+
+        auto run() {
+            std::array<epoll_event, max_events> events{};
+            auto timeout{-1};
+            while (true) {
+                auto n{epoll_wait(
+                    _epoll_fd, events.data(), max_events, timeout)};
+                for (int i{0}; i < n; ++i) {
+                    auto id{events[i].data.u64};
+                    if (id == stop_id) { return; }
+                    if (id == listen_id) {
+                        on_acceptable();
+                        continue;
+                    }
+                    if (events[i].events & EPOLLIN) { on_readable(id); }
+                    if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                        if (auto it{_connections.find(id)};
+                            it != _connections.end()) {
+                            flush(id, *it->second);
+                        }
+                    }
+                }
+                timeout = send_due();
+            }
+        }
+
+      public:
+        /**
+         * @brief      Starts the server on an ephemeral port of 127.0.0.1.
+         *
+         * @param[in]  options  The behaviour
+         */
+        explicit loopback_server(server_options options = {})
+            : _options{options} {
+            _listen_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t size{sizeof(address)};
+            if (_listen_fd == -1 ||
+                ::bind(_listen_fd,
+                       reinterpret_cast<sockaddr *>(&address),
+                       sizeof(address)) == -1 ||
+                ::listen(_listen_fd, SOMAXCONN) == -1 ||
+                getsockname(_listen_fd,
+                            reinterpret_cast<sockaddr *>(&address),
+                            &size) == -1) {
+                throw std::runtime_error{std::format(
+                    "loopback server could not listen: {}",
+                    std::strerror(errno))};
+            }
+            _port = ntohs(address.sin_port);
+            _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            _stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = stop_id;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _stop_fd, &ev);
+            ev.data.u64 = listen_id;
+            epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _listen_fd, &ev);
+            _thread = std::thread{[this] { run(); }};
+        }
+
+
+        loopback_server(const loopback_server &) = delete;
+        loopback_server &operator=(const loopback_server &) = delete;
+
+
+        /**
+         * @brief      Stops the server.
+         */
+        ~loopback_server() {
+            uint64_t one{1};
+            [[maybe_unused]] auto _{::write(_stop_fd, &one, sizeof(one))};
+            _thread.join();
+            for (auto &[id, c] : _connections) { ::close(c->fd); }
+            ::close(_listen_fd);
+            ::close(_epoll_fd);
+            ::close(_stop_fd);
+        }
+
+      public:
+        /**
+         * @brief      Url of the server.
+         */
+        auto url() const { return std::format("http://127.0.0.1:{}/", _port); }
+    };
+
+
+}  // namespace bench
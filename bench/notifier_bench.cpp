@@ -0,0 +1,326 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cxxopts.hpp>
+#include <metrics.hpp>
+#include <notifier.hpp>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "loopback_server.hpp"
+
+/*
+ * Drives cppurl::notifier against an in-process loopback server (HTTP/1.1 or
+ * HTTP/2) and reports throughput, transfer latency, CPU time of the notifier
+ * thread and peak RSS. Every configuration of the sweep (protocol, pool size,
+ * payload size and poll wait time) runs in a process of its own, so that
+ * peak RSS and the global stop flag of one run do not leak into the next.
+ */
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct configuration {
+        bool http2{false};
+        size_t pool_size{};
+        size_t payload_size{};
+        int poll_wait_time{};
+    };
+
+
+    struct result {
+        double requests_per_second{};
+        double p50_ms{};
+        double p99_ms{};
+        double p999_ms{};
+        double cpu_ms{};
+        double peak_rss_mib{};
+        size_t failed{};
+    };
+
+
+    auto thread_cpu_time() -> std::chrono::microseconds {
+        rusage usage{};
+        getrusage(RUSAGE_THREAD, &usage);
+        return std::chrono::seconds{usage.ru_utime.tv_sec +
+                                    usage.ru_stime.tv_sec} +
+               std::chrono::microseconds{usage.ru_utime.tv_usec +
+                                         usage.ru_stime.tv_usec};
+    }
+
+
+    auto raise_file_limit() {
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+
+    auto parse_list(const std::string &list) -> std::vector<size_t> {
+        std::vector<size_t> values{};
+        std::istringstream in{list};
+        for (std::string item{}; std::getline(in, item, ',');) {
+            values.push_back(std::stoul(item));
+        }
+        return values;
+    }
+
+
+    /**
+     * @brief      Writes total requests of a given size to fd.
+     */
+    auto feed(int fd, size_t total, size_t payload_size) {
+        std::string line{};
+        for (size_t i{0}; i < total; ++i) {
+            line = std::format("{{\"id\":{},\"pad\":\"", i);
+            line.resize(std::max(payload_size, line.size() + 2), 'x');
+            line.replace(line.size() - 2, 2, "\"}");
+            line.push_back('\n');
+            std::string_view left{line};
+            while (!left.empty()) {
+                auto n{::write(fd, left.data(), left.size())};
+                if (n <= 0) { return; }
+                left.remove_prefix(static_cast<size_t>(n));
+            }
+        }
+    }
+
+
+    /**
+     * @brief      Runs a single configuration (in a child process). Requests
+     * are fed to the notifier through a pipe replacing stdin.
+     */
+    auto run(const configuration &c,
+             const bench::server_options &server_options,
+             cppurl::engine engine,
+             size_t total) -> std::expected<result, cppurl::notifier::status> {
+        cppurl::curl_global global{};
+        bench::loopback_server server{server_options};
+        auto url{server.url()};
+        int fds[2];
+        if (::pipe(fds) == -1 || ::dup2(fds[0], STDIN_FILENO) == -1) {
+            throw std::runtime_error{"could not replace stdin"};
+        }
+        ::close(fds[0]);
+        std::thread writer{[&] {
+            feed(fds[1], total, c.payload_size);
+            ::close(fds[1]);
+        }};
+
+        cppurl::metrics metrics{};
+        cppurl::notifier n{
+            url,
+            std::chrono::seconds{1},
+            cppurl::notifier_options{
+                .engine = engine,
+                .poll_wait_time = std::chrono::milliseconds{c.poll_wait_time},
+                .max_connections = c.pool_size,
+                .http2 = {.enabled = c.http2, .prior_knowledge = c.http2},
+                /*responses are captured, so that they are not printed*/
+                .max_response_size = 64,
+                .metrics = &metrics}};
+        size_t done{0};
+        size_t failed{0};
+        auto count{[&](bool ok) {
+            failed += ok ? 0 : 1;
+            if (++done == total) { ::should_stop = true; }
+            return cppurl::status_ok;
+        }};
+
+        auto cpu_start{thread_cpu_time()};
+        auto wall_start{clock_type::now()};
+        auto status{n.run(
+            [&](cppurl::handle_info info) -> cppurl::notifier::status {
+                auto code{info.response_code()};
+                FORWARD_UNEXPECTED(code);
+                return count(*code == 200);
+            },
+            [&](cppurl::handle_info) -> cppurl::notifier::status {
+                return count(false);
+            })};
+        auto wall{
+            std::chrono::duration<double>{clock_type::now() - wall_start}};
+        auto cpu{thread_cpu_time() - cpu_start};
+        writer.join();
+        if (!status) { return std::unexpected{status}; }
+
+        auto ms{[&](double q) {
+            return std::chrono::duration<double, std::milli>{
+                metrics.transfer_time().quantile(q)}
+                .count();
+        }};
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return result{static_cast<double>(done) / wall.count(),
+                      ms(0.5),
+                      ms(0.99),
+                      ms(0.999),
+                      std::chrono::duration<double, std::milli>{cpu}.count(),
+                      static_cast<double>(usage.ru_maxrss) / 1024.0,
+                      failed};
+    }
+
+
+    /**
+     * @brief      Runs a single configuration in a child process.
+     *
+     * @return     The result (std::nullopt if the child failed)
+     */
+    auto run_isolated(const configuration &c,
+                      const bench::server_options &server_options,
+                      cppurl::engine engine,
+                      size_t total) -> std::optional<result> {
+        int fds[2];
+        if (::pipe(fds) == -1) { return std::nullopt; }
+        auto pid{::fork()};
+        if (pid == 0) {
+            ::close(fds[0]);
+            auto code{1};
+            try {
+                if (auto r{run(c, server_options, engine, total)}) {
+                    code = ::write(fds[1], &*r, sizeof(*r)) == sizeof(*r) ? 0
+                                                                          : 1;
+                } else {
+                    std::cerr << r.error().what() << std::endl;
+                }
+            } catch (const std::exception &e) {
+                std::cerr << e.what() << std::endl;
+            }
+            ::_exit(code);
+        }
+        ::close(fds[1]);
+        result r{};
+        auto read{pid > 0 ? ::read(fds[0], &r, sizeof(r)) : -1};
+        ::close(fds[0]);
+        int status{};
+        if (pid > 0) { ::waitpid(pid, &status, 0); }
+        if (read != sizeof(r) || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            return std::nullopt;
+        }
+        return r;
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options(
+        "notifier_bench",
+        "Sweeps the notifier against a loopback HTTP/1.1 and HTTP/2 "
+        "server\n\n");
+    options.add_options()(
+        "n,requests",
+        "number of requests of every configuration",
+        cxxopts::value<int>()->default_value("10000"))(
+        "protocols",
+        "comma separated list of http1 and http2",
+        cxxopts::value<std::string>()->default_value("http1,http2"))(
+        "pool-sizes",
+        "comma separated list of --max-connections",
+        cxxopts::value<std::string>()->default_value("10,100,1000"))(
+        "payload-sizes",
+        "comma separated list of request sizes in bytes",
+        cxxopts::value<std::string>()->default_value("64,1024,16384"))(
+        "poll-wait-times",
+        "comma separated list of maximal sleeps of the poll engine in "
+        "milliseconds",
+        cxxopts::value<std::string>()->default_value("1,10,100"))(
+        "e,engine",
+        "transfer engine: poll or socket_action",
+        cxxopts::value<std::string>()->default_value("poll"))(
+        "delay",
+        "delay of every response in microseconds",
+        cxxopts::value<int>()->default_value("0"))(
+        "error-rate",
+        "fraction of requests answered with 503",
+        cxxopts::value<double>()->default_value("0"))(
+        "reset-rate",
+        "fraction of requests answered by resetting the connection",
+        cxxopts::value<double>()->default_value("0")) /**/ ("h,help",
+                                                          "Usage");
+    auto result{options.parse(argc, argv)};
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    raise_file_limit();
+    auto total{static_cast<size_t>(std::max(result["requests"].as<int>(), 1))};
+    auto engine_name{result["engine"].as<std::string>()};
+    auto engine{engine_name == "socket_action" ? cppurl::engine::socket_action
+                                               : cppurl::engine::poll};
+    bench::server_options server_options{
+        .delay = std::chrono::microseconds{
+            std::max(result["delay"].as<int>(), 0)},
+        .error_rate = result["error-rate"].as<double>(),
+        .reset_rate = result["reset-rate"].as<double>()};
+    std::vector<bool> protocols{};
+    for (std::istringstream in{result["protocols"].as<std::string>()};
+         !in.eof();) {
+        std::string p{};
+        std::getline(in, p, ',');
+        protocols.push_back(p == "http2");
+    }
+    auto wait_times{parse_list(result["poll-wait-times"].as<std::string>())};
+    if (engine == cppurl::engine::socket_action) {
+        /*the socket action engine does not sleep for a fixed time*/
+        wait_times = {wait_times.front()};
+    }
+
+    std::cout << std::format("{:>6} {:>6} {:>8} {:>6} {:>10} {:>8} {:>8} "
+                             "{:>8} {:>9} {:>8} {:>7}\n",
+                             "proto",
+                             "pool",
+                             "payload",
+                             "wait",
+                             "req/s",
+                             "p50 ms",
+                             "p99 ms",
+                             "p999 ms",
+                             "cpu ms",
+                             "rss MiB",
+                             "failed");
+    for (auto http2 : protocols) {
+        for (auto pool : parse_list(result["pool-sizes"].as<std::string>())) {
+            for (auto payload :
+                 parse_list(result["payload-sizes"].as<std::string>())) {
+                for (auto wait : wait_times) {
+                    configuration c{
+                        http2, pool, payload, static_cast<int>(wait)};
+                    auto r{run_isolated(c, server_options, engine, total)};
+                    auto prefix{std::format("{:>6} {:>6} {:>8} {:>6}",
+                                            http2 ? "http2" : "http1",
+                                            pool,
+                                            payload,
+                                            wait)};
+                    if (!r) {
+                        std::cout << prefix << " failed\n";
+                        continue;
+                    }
+                    std::cout << std::format(
+                        "{} {:>10.0f} {:>8.2f} {:>8.2f} {:>8.2f} {:>9.1f} "
+                        "{:>8.1f} {:>7}\n",
+                        prefix,
+                        r->requests_per_second,
+                        r->p50_ms,
+                        r->p99_ms,
+                        r->p999_ms,
+                        r->cpu_ms,
+                        r->peak_rss_mib,
+                        r->failed);
+                    std::cout.flush();
+                }
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <chrono>
+#include <cxxopts.hpp>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <line_scanner.hpp>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Compares ways of splitting a buffer of newline separated requests: the
+ * std::views::split pipeline formerly used to read stdin, a loop of
+ * std::string_view::find and line_scanner with every instruction set this
+ * cpu supports. Buffers are generated with lines of fixed and of log-normally
+ * distributed lengths.
+ */
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct distribution {
+        std::string name{};
+        std::function<size_t(std::mt19937_64 &)> length{};
+    };
+
+
+    /**
+     * @brief      Generates lines until the buffer has at least size bytes.
+     */
+    auto generate(const distribution &d, size_t size) -> std::string {
+        std::mt19937_64 random{42};
+        std::string buffer{};
+        buffer.reserve(size + 64 * 1024);
+        while (buffer.size() < size) {
+            auto length{std::max(d.length(random), size_t{1})};
+            buffer.append(length - 1, 'x');
+            buffer.push_back('\n');
+        }
+        return buffer;
+    }
+
+
+    auto split_ranges(const std::string &buffer) -> size_t {
+        size_t bytes{0};
+        for (auto &&line : std::views::split(std::views::all(buffer),
+                                             std::string_view{"\n"})) {
+            bytes += std::string_view{line.begin(), line.end()}.size();
+        }
+        return bytes;
+    }
+
+
+    auto split_find(std::string_view data) -> size_t {
+        size_t bytes{0};
+        for (auto end{data.find('\n')}; end != std::string_view::npos;
+             end = data.find('\n')) {
+            bytes += end;
+            data.remove_prefix(end + 1);
+        }
+        return bytes;
+    }
+
+
+    auto split_scanner(std::string_view data, cppurl::simd s) -> size_t {
+        size_t bytes{0};
+        cppurl::line_scanner::split(
+            data, [&](std::string_view line) { bytes += line.size(); }, s);
+        return bytes;
+    }
+
+
+    /**
+     * @brief      Runs split repeatedly and returns the best throughput in
+     * GB/s. The sum of line lengths is checked against expected, so that
+     * nothing is optimised away.
+     */
+    auto measure(auto &&split, size_t size, size_t expected, int repeats)
+        -> double {
+        auto best{0.0};
+        for (int i{0}; i < repeats; ++i) {
+            auto start{clock_type::now()};
+            auto bytes{split()};
+            auto seconds{std::chrono::duration<double>{clock_type::now() -
+                                                       start}
+                             .count()};
+            if (bytes != expected) {
+                throw std::runtime_error{"splits do not agree"};
+            }
+            best = std::max(best, static_cast<double>(size) / seconds / 1e9);
+        }
+        return best;
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options("split_bench",
+                             "Compares line splitting implementations\n\n");
+    options.add_options()(
+        "s,size",
+        "size of every generated buffer in MiB",
+        cxxopts::value<int>()->default_value("256"))(
+        "r,repeats",
+        "number of runs of every implementation (the best one counts)",
+        cxxopts::value<int>()->default_value("5"))("h,help", "Usage");
+    auto result{options.parse(argc, argv)};
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    auto size{static_cast<size_t>(std::max(result["size"].as<int>(), 1)) *
+              1024 * 1024};
+    auto repeats{std::max(result["repeats"].as<int>(), 1)};
+
+    auto fixed{[](size_t length) {
+        return [length](std::mt19937_64 &) { return length; };
+    }};
+    auto log_normal{[](double median, double sigma) {
+        return [d = std::lognormal_distribution<double>{std::log(median),
+                                                        sigma}](
+                   std::mt19937_64 &random) mutable {
+            return static_cast<size_t>(d(random));
+        };
+    }};
+    std::vector<distribution> distributions{
+        {"fixed 16", fixed(16)},
+        {"fixed 128", fixed(128)},
+        {"fixed 4096", fixed(4096)},
+        {"lognormal 100", log_normal(100, 1)},
+        {"lognormal 1000", log_normal(1000, 1.5)}};
+    std::vector<cppurl::simd> instruction_sets{cppurl::simd::scalar};
+    if (cppurl::line_scanner::best() != cppurl::simd::scalar) {
+        instruction_sets.push_back(cppurl::simd::sse2);
+    }
+    if (cppurl::line_scanner::best() == cppurl::simd::avx2) {
+        instruction_sets.push_back(cppurl::simd::avx2);
+    }
+
+    std::cout << std::format("{:>16} {:>10} {:>10} {:>10}\n",
+                             "lines",
+                             "mean size",
+                             "split",
+                             "GB/s");
+    for (const auto &d : distributions) {
+        auto buffer{generate(d, size)};
+        auto lines{static_cast<size_t>(
+            std::ranges::count(buffer, '\n'))};
+        auto expected{buffer.size() - lines};
+        auto report{[&](std::string_view name, double gbps) {
+            std::cout << std::format(
+                "{:>16} {:>10.1f} {:>10} {:>10.2f}\n",
+                d.name,
+                static_cast<double>(buffer.size()) /
+                    static_cast<double>(lines),
+                name,
+                gbps);
+        }};
+        report("ranges",
+               measure([&] { return split_ranges(buffer); },
+                       buffer.size(),
+                       expected,
+                       repeats));
+        report("find",
+               measure([&] { return split_find(buffer); },
+                       buffer.size(),
+                       expected,
+                       repeats));
+        for (auto s : instruction_sets) {
+            report(cppurl::line_scanner::name(s),
+                   measure([&] { return split_scanner(buffer, s); },
+                           buffer.size(),
+                           expected,
+                           repeats));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <batcher.hpp>
+#include <cxxopts.hpp>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <spool.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+ * Measures ingest throughput of the notifier with and without the spool.
+ * Lines are copied to the arena and queued (as read_requests does), with the
+ * spool they are also appended to it and committed every sync interval.
+ * Every queued request is then taken and acknowledged, so that segments are
+ * recycled as in a steady state.
+ */
+
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+
+    struct result {
+        double lines_per_second{};
+        double megabytes_per_second{};
+    };
+
+
+    auto run(std::optional<cppurl::spool_options> options,
+             size_t lines,
+             size_t size) -> result {
+        std::optional<cppurl::spool> spool{};
+        if (options) { spool.emplace(*options); }
+        cppurl::request_arena arena{};
+        cppurl::batcher requests{};
+        std::string line(size, 'x');
+        /*acknowledge in batches, as completed transfers do*/
+        constexpr size_t in_flight{100};
+        std::vector<cppurl::spool::ticket> tickets{};
+
+        auto start{clock_type::now()};
+        for (size_t i{0}; i < lines; ++i) {
+            line[i % size] = static_cast<char>('a' + i % 26);
+            requests.push(arena.append(line),
+                          spool ? spool->append(line)
+                                : cppurl::spool::no_ticket);
+            if (spool && !spool->maybe_commit()) {
+                throw std::runtime_error{"could not commit the spool"};
+            }
+            if (requests.size() < in_flight) { continue; }
+            while (!requests.empty()) {
+                auto batch{requests.next(arena)};
+                tickets.insert(
+                    tickets.end(), batch.tickets.begin(), batch.tickets.end());
+            }
+            if (spool) { spool->acknowledge(tickets); }
+            tickets.clear();
+        }
+        if (spool && !spool->commit()) {
+            throw std::runtime_error{"could not commit the spool"};
+        }
+        auto seconds{
+            std::chrono::duration<double>{clock_type::now() - start}.count()};
+        return {static_cast<double>(lines) / seconds,
+                static_cast<double>(lines * size) / seconds / 1e6};
+    }
+
+}  // namespace
+
+
+int main(int argc, char const *argv[]) {
+    cxxopts::Options options("spool_bench",
+                             "Compares ingest with and without the spool\n\n");
+    options.add_options()(
+        "d,directory",
+        "spool directory (removed afterwards)",
+        cxxopts::value<std::string>()->default_value("spool_bench.d"))(
+        "l,lines",
+        "number of ingested lines",
+        cxxopts::value<int>()->default_value("1000000"))(
+        "sync-interval",
+        "interval in milliseconds of flushing the spool to disk",
+        cxxopts::value<int>()->default_value("10")) /**/ ("h,help", "Usage");
+    auto result{options.parse(argc, argv)};
+    if (result.count("help")) {
+        std::cout << options.help() << std::endl;
+        return 0;
+    }
+    auto directory{result["directory"].as<std::string>()};
+    auto lines{static_cast<size_t>(std::max(result["lines"].as<int>(), 1))};
+    auto sync_interval{std::chrono::milliseconds{
+        std::max(result["sync-interval"].as<int>(), 0)}};
+
+    std::cout << std::format(
+        "{:>8} {:>10} {:>14} {:>10}\n", "spool", "line size", "lines/s", "MB/s");
+    for (auto size : {size_t{64}, size_t{256}, size_t{1024}}) {
+        for (auto spooled : {false, true}) {
+            std::optional<cppurl::spool_options> spool_options{};
+            if (spooled) {
+                std::filesystem::remove_all(directory);
+                spool_options = cppurl::spool_options{
+                    .directory = directory, .sync_interval = sync_interval};
+            }
+            auto r{run(spool_options, lines, size)};
+            std::cout << std::format("{:>8} {:>10} {:>14.0f} {:>10.1f}\n",
+                                     spooled ? "on" : "off",
+                                     size,
+                                     r.lines_per_second,
+                                     r.megabytes_per_second);
+        }
+    }
+    std::filesystem::remove_all(directory);
+    return 0;
+}
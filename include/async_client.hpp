@@ -0,0 +1,504 @@
+#pragma once
+
+#include <coroutine>
+#include <cppurl.hpp>
+#include <exception>
+#include <frame_pool.hpp>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Base of promises whose frames come from
+     * frame_pool::local().
+     */
+    struct pooled_frame {
+        static auto operator new(size_t size) -> void * {
+            return frame_pool::local().allocate(size);
+        }
+
+
+        static auto operator delete(void *p, size_t size) -> void {
+            frame_pool::local().deallocate(p, size);
+        }
+    };
+
+
+    template <typename T>
+    class task;
+
+
+    /**
+     * @brief      Promise of task<T> without its result.
+     */
+    struct task_promise_base : pooled_frame {
+        /*resumed once the task is finished*/
+        std::coroutine_handle<> continuation{std::noop_coroutine()};
+        std::exception_ptr exception{};
+
+
+        /**
+         * @brief      Resumes the continuation by symmetric transfer (thus
+         * chains of tasks do not grow the stack).
+         */
+        struct final_awaiter {
+            auto await_ready() noexcept { return false; }
+
+
+            template <typename P>
+            auto await_suspend(std::coroutine_handle<P> h) noexcept
+                -> std::coroutine_handle<> {
+                return h.promise().continuation;
+            }
+
+
+            auto await_resume() noexcept {}
+        };
+
+
+        auto initial_suspend() noexcept { return std::suspend_always{}; }
+        auto final_suspend() noexcept { return final_awaiter{}; }
+        auto unhandled_exception() { exception = std::current_exception(); }
+    };
+
+
+    template <typename T>
+    struct task_promise : task_promise_base {
+        std::optional<T> value{};
+
+        auto get_return_object() -> task<T>;
+        auto return_value(T v) { value.emplace(std::move(v)); }
+    };
+
+
+    template <>
+    struct task_promise<void> : task_promise_base {
+        auto get_return_object() -> task<void>;
+        auto return_void() {}
+    };
+
+
+    /**
+     * @brief      Lazily started coroutine returning T. It starts when it is
+     * awaited and resumes its awaiter when it finishes. Exceptions are
+     * rethrown to the awaiter.
+     *
+     * @tparam     T     The result
+     */
+    template <typename T = void>
+    class task {
+      public:
+        using promise_type = task_promise<T>;
+
+      private:
+        std::coroutine_handle<promise_type> _handle{};
+
+      public:
+        explicit task(std::coroutine_handle<promise_type> h) : _handle{h} {}
+
+
+        task(task &&other) noexcept
+            : _handle{std::exchange(other._handle, {})} {}
+
+
+        task &operator=(task &&other) noexcept {
+            if (this != &other) {
+                if (_handle) { _handle.destroy(); }
+                _handle = std::exchange(other._handle, {});
+            }
+            return *this;
+        }
+
+
+        ~task() {
+            if (_handle) { _handle.destroy(); }
+        }
+
+      public:
+        auto await_ready() const noexcept { return false; }
+
+
+        auto await_suspend(std::coroutine_handle<> awaiter) noexcept
+            -> std::coroutine_handle<> {
+            _handle.promise().continuation = awaiter;
+            return _handle;
+        }
+
+
+        auto await_resume() -> T {
+            auto &p{_handle.promise()};
+            if (p.exception) { std::rethrow_exception(p.exception); }
+            if constexpr (!std::is_void_v<T>) { return std::move(*p.value); }
+        }
+    };
+
+
+    template <typename T>
+    auto task_promise<T>::get_return_object() -> task<T> {
+        return task<T>{std::coroutine_handle<task_promise<T>>::from_promise(
+            *this)};
+    }
+
+
+    inline auto task_promise<void>::get_return_object() -> task<void> {
+        return task<void>{
+            std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+    }
+
+
+    /**
+     * @brief      Outcome of a single post.
+     */
+    struct post_result {
+        b_status status{};
+        /*0 if no response was received*/
+        long response_code{0};
+        transfer_timings timings{};
+    };
+
+
+    /**
+     * @brief      Settings of async_client.
+     */
+    struct async_client_options {
+        /*maximal number of simultaneous transfers, further posts wait for a
+         * free handle in order of arrival*/
+        size_t max_connections{100};
+        /*use http/2 (negotiated via ALPN) and multiplex transfers*/
+        bool http2{false};
+        /*speak http/2 to http urls without upgrade*/
+        bool http2_prior_knowledge{false};
+        /*maximal sleep of run() in curl_multi_wait*/
+        std::chrono::milliseconds poll_wait_time{100};
+    };
+
+
+    /**
+     * @brief      Coroutine interface of notifications. Every
+     * co_await post(url, body) becomes a transfer of a single multi handle.
+     * Completions read by curl_multi_info_read resume their coroutines
+     * directly on the thread calling run(), thus many thousands of
+     * notifications can be in flight without threads or callbacks. Frames of
+     * task and spawned coroutines come from frame_pool. Not thread safe, all
+     * coroutines must run on the thread calling run().
+     *
+     * Example:
+     *
+     *     cppurl::async_client client{};
+     *     client.spawn([](cppurl::async_client &c) -> cppurl::task<> {
+     *         auto r{co_await c.post("http://localhost/", "{}")};
+     *         ...
+     *     }(client));
+     *     client.run();
+     */
+    class async_client {
+      public:
+        class post_awaiter;
+
+      private:
+        /**
+         * @brief      Coroutine started by spawn(), it destroys itself when
+         * it finishes.
+         */
+        struct detached {
+            struct promise_type : pooled_frame {
+                auto get_return_object() { return detached{}; }
+                auto initial_suspend() noexcept { return std::suspend_never{}; }
+                auto final_suspend() noexcept { return std::suspend_never{}; }
+                auto return_void() {}
+                auto unhandled_exception() { std::terminate(); }
+            };
+        };
+
+      private:
+        curl_global _global{};
+        async_client_options _options{};
+        nb_handle _multi{};
+        handle_pool<> _handles;
+        /*posts waiting for a free handle (intrusive fifo)*/
+        post_awaiter *_first_waiting{nullptr};
+        post_awaiter *_last_waiting{nullptr};
+        size_t _in_flight{0};
+        size_t _spawned{0};
+        std::exception_ptr _exception{};
+
+      public:
+        /**
+         * @brief      Awaitable transfer of a single post.
+         */
+        class post_awaiter {
+          private:
+            friend class async_client;
+
+          private:
+            async_client &_client;
+            std::string_view _url{};
+            std::string_view _body{};
+            std::coroutine_handle<> _waiter{};
+            post_result _result{};
+            post_awaiter *_next{nullptr};
+
+          public:
+            post_awaiter(async_client &client,
+                         std::string_view url,
+                         std::string_view body)
+                : _client{client}, _url{url}, _body{body} {}
+
+          public:
+            auto await_ready() const noexcept { return false; }
+
+
+            /**
+             * @brief      Starts the transfer (or queues it if all handles are
+             * busy). Does not suspend if it could not be started.
+             */
+            auto await_suspend(std::coroutine_handle<> waiter) -> bool {
+                _waiter = waiter;
+                if (_client._first_waiting || _client._handles.size() == 0) {
+                    _client.wait_for_handle(*this);
+                    return true;
+                }
+                return _client.launch(*this);
+            }
+
+
+            auto await_resume() -> post_result { return std::move(_result); }
+        };
+
+      private:
+        /**
+         * @brief      Curl writing function which discards responses.
+         */
+        static auto discard(char *, size_t n, size_t l, void *) -> size_t {
+            return n * l;
+        }
+
+
+        /**
+         * @brief      Configures a new simple handle.
+         *
+         * @param      h     The handle
+         *
+         * @return     The status
+         */
+        auto configure(b_handle &h) -> b_status {
+            FORWARD_ERROR(h.write(discard));
+            if (!_options.http2) { return b_status{CURLE_OK}; }
+            auto version{_options.http2_prior_knowledge
+                             ? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE
+                             : CURL_HTTP_VERSION_2TLS};
+            FORWARD_ERROR(h.http_version(version));
+            return h.pipewait(true);
+        }
+
+
+        /**
+         * @brief      Appends a post to the queue of posts waiting for a
+         * handle.
+         */
+        auto wait_for_handle(post_awaiter &a) -> void {
+            a._next = nullptr;
+            if (_last_waiting) {
+                _last_waiting->_next = &a;
+            } else {
+                _first_waiting = &a;
+            }
+            _last_waiting = &a;
+        }
+
+
+        /**
+         * @brief      Starts the transfer of a post.
+         *
+         * @return     True iff it was started (otherwise its result holds the
+         * error)
+         */
+        auto launch(post_awaiter &a) -> bool {
+            auto handle{_handles.get()};
+            if (!handle) {
+                a._result = {.status = handle.error()};
+                return false;
+            }
+            auto &h{**handle};
+            b_status s{CURLE_OK};
+            if (!h.url(a._url)) {
+                s = b_status{CURLE_URL_MALFORMAT};
+            } else if (!h.post<false>(a._body) || !_multi.add(h)) {
+                s = b_status{CURLE_FAILED_INIT};
+            }
+            if (!s) {
+                _handles.add(h);
+                a._result = {.status = s};
+                return false;
+            }
+            h.owner(&a);
+            ++_in_flight;
+            return true;
+        }
+
+
+        /**
+         * @brief      Starts waiting posts while there are free handles.
+         * Posts which could not be started are resumed with their error.
+         *
+         * @return     void
+         */
+        auto launch_waiting() {
+            while (_first_waiting && _handles.size() > 0) {
+                auto &a{*_first_waiting};
+                _first_waiting = a._next;
+                if (!_first_waiting) { _last_waiting = nullptr; }
+                if (!launch(a)) { a._waiter.resume(); }
+            }
+        }
+
+
+        /**
+         * @brief      Resumes coroutines of completed transfers.
+         *
+         * @return     Number of completed transfers
+         */
+        auto complete() -> size_t {
+            size_t completed{0};
+            for (auto [info, left]{_multi.info()}; info;
+                 std::tie(info, left) = _multi.info()) {
+                if (!info.completed()) { continue; }
+                auto h{info.handle()};
+                if (!h) { continue; }
+                auto &handle{**h};
+                auto &a{*static_cast<post_awaiter *>(handle.owner())};
+                a._result.status = info.status();
+                a._result.response_code = handle.response_code().value_or(0);
+                a._result.timings =
+                    handle.timings().value_or(transfer_timings{});
+                _multi.remove(handle);
+                handle.owner(nullptr);
+                _handles.add(handle);
+                --_in_flight;
+                ++completed;
+                /*the coroutine runs until its next suspension, it may post
+                 * again (the freed handle is already back in the pool)*/
+                a._waiter.resume();
+            }
+            return completed;
+        }
+
+
+        /**
+         * @brief      Runs t and keeps track of it.
+         */
+        auto start(task<void> t) -> detached {
+            try {
+                co_await t;
+            } catch (...) {
+                if (!_exception) { _exception = std::current_exception(); }
+            }
+            --_spawned;
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The options
+         */
+        explicit async_client(async_client_options options = {})
+            : _options{options},
+              _handles{0,
+                       std::max(options.max_connections, size_t{1}),
+                       [this](b_handle &h) { return configure(h); }} {
+            if (!_multi.maximal_number_of_connections(
+                    static_cast<int64_t>(_options.max_connections)) ||
+                !_multi.multiplexing(_options.http2)) {
+                throw std::runtime_error{
+                    "async client could not configure multi handle"};
+            }
+        }
+
+
+        async_client(const async_client &) = delete;
+        async_client &operator=(const async_client &) = delete;
+
+      public:
+        /**
+         * @brief      Posts body to url. Both must stay valid until the
+         * returned awaiter is resumed (i.e. for the whole co_await).
+         *
+         * @param[in]  url   The url
+         * @param[in]  body  The body
+         *
+         * @return     Awaiter resumed with post_result
+         */
+        auto post(std::string_view url, std::string_view body)
+            -> post_awaiter {
+            return post_awaiter{*this, url, body};
+        }
+
+
+        /**
+         * @brief      Starts a coroutine now, run() returns once it (and all
+         * other spawned coroutines) finished.
+         *
+         * @param[in]  t     The coroutine
+         *
+         * @return     void
+         */
+        auto spawn(task<void> t) {
+            ++_spawned;
+            start(std::move(t));
+        }
+
+
+        /**
+         * @brief      Drives transfers once: performs them, waits for
+         * activity at most timeout and resumes coroutines of completed ones.
+         * Use it to embed the client into another loop.
+         *
+         * @param[in]  timeout  The timeout
+         *
+         * @return     Number of completed transfers or error
+         */
+        auto run_once(std::chrono::milliseconds timeout)
+            -> std::expected<size_t, nb_status> {
+            UNEXP_FORWARD_UNEXPECTED(_multi.perform());
+            auto completed{complete()};
+            launch_waiting();
+            if (completed == 0 && _in_flight > 0) {
+                UNEXP_FORWARD_UNEXPECTED(
+                    _multi.wait(static_cast<int>(timeout.count())));
+            }
+            return completed;
+        }
+
+
+        /**
+         * @brief      Drives transfers until all spawned coroutines
+         * finished. The first exception which escaped a spawned coroutine is
+         * rethrown.
+         *
+         * @return     status
+         */
+        auto run() -> nb_status {
+            while (_spawned > 0) {
+                auto done{run_once(_options.poll_wait_time)};
+                if (!done) { return done.error(); }
+            }
+            if (_exception) {
+                std::rethrow_exception(std::exchange(_exception, {}));
+            }
+            return nb_status{CURLM_OK};
+        }
+
+
+        /**
+         * @brief      Number of transfers in flight.
+         */
+        auto in_flight() const { return _in_flight; }
+    };
+
+
+}  // namespace cppurl
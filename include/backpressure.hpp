@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      What to do with new requests when the queue is full.
+     */
+    enum class overflow_policy {
+        /*stop reading input until the queue falls below the low watermark
+         * (the producer is blocked by the full pipe)*/
+        block,
+        /*keep reading and drop the oldest queued requests*/
+        drop_oldest,
+        /*keep reading and drop new requests*/
+        drop_newest
+    };
+
+
+    /**
+     * @brief      Limits of queued requests. The queue is full once it reaches
+     * a high watermark (in items or in bytes) and is drained enough once it
+     * falls to both low watermarks. A high watermark of 0 means no limit, a
+     * low watermark of 0 means half of the high one.
+     */
+    struct backpressure_options {
+        size_t high_items{0};
+        size_t low_items{0};
+        size_t high_bytes{0};
+        size_t low_bytes{0};
+        overflow_policy overflow{overflow_policy::block};
+    };
+
+
+    /**
+     * @brief      High and low watermarks with hysteresis.
+     */
+    class watermarks {
+      private:
+        backpressure_options _options{};
+        bool _full{false};
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The limits
+         */
+        explicit watermarks(backpressure_options options = {})
+            : _options{options} {
+            if (_options.low_items == 0 ||
+                _options.low_items > _options.high_items) {
+                _options.low_items = _options.high_items / 2;
+            }
+            if (_options.low_bytes == 0 ||
+                _options.low_bytes > _options.high_bytes) {
+                _options.low_bytes = _options.high_bytes / 2;
+            }
+        }
+
+      public:
+        /**
+         * @brief      True iff a queue of the given size reached a high
+         * watermark.
+         *
+         * @param[in]  items  Number of queued requests
+         * @param[in]  bytes  Their size in bytes
+         */
+        auto above_high(size_t items, size_t bytes) const -> bool {
+            return (_options.high_items > 0 && items >= _options.high_items) ||
+                   (_options.high_bytes > 0 && bytes >= _options.high_bytes);
+        }
+
+
+        /**
+         * @brief      Updates the state of the queue. It becomes full at a
+         * high watermark and stays full until it falls to both low ones.
+         *
+         * @param[in]  items  Number of queued requests
+         * @param[in]  bytes  Their size in bytes
+         *
+         * @return     True iff the queue has just become full
+         */
+        auto update(size_t items, size_t bytes) -> bool {
+            if (_full) {
+                _full = (_options.high_items > 0 &&
+                         items > _options.low_items) ||
+                        (_options.high_bytes > 0 &&
+                         bytes > _options.low_bytes);
+                return false;
+            }
+            _full = above_high(items, bytes);
+            return _full;
+        }
+
+
+        /**
+         * @brief      True iff the queue is full (see update).
+         */
+        auto full() const { return _full; }
+
+
+        /**
+         * @brief      The overflow policy.
+         */
+        auto overflow() const { return _options.overflow; }
+    };
+
+
+}  // namespace cppurl
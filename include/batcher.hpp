@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <priority_lanes.hpp>
+#include <request_arena.hpp>
+#include <span>
+#include <string_view>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Framing of requests packed into one post body.
+     */
+    enum class framing {
+        /*one request per post (no batching)*/
+        none,
+        /*newline delimited JSON, every request followed by '\n'*/
+        ndjson,
+        /*JSON array of requests*/
+        json_array
+    };
+
+
+    /**
+     * @brief      Limits of a single batch. A batch is sent when it is full
+     * (max_items or max_bytes) or when its oldest request waits for linger.
+     */
+    struct batch_options {
+        cppurl::framing framing{framing::none};
+        size_t max_items{100};
+        size_t max_bytes{1024 * 1024};
+        std::chrono::milliseconds linger{10};
+    };
+
+
+    /**
+     * @brief      Queue of pending requests which packs them into batches.
+     * Without framing every request is a batch of its own and is posted
+     * without copying. Requests wait in priority lanes, and those which
+     * expired are dropped when their turn comes.
+     */
+    class batcher {
+      public:
+        using clock_type = std::chrono::steady_clock;
+
+
+        /**
+         * @brief      Body of a single post, number of packed requests, their
+         * tickets and tickets of requests which expired meanwhile (both valid
+         * until the next call of next()) and the time the oldest packed
+         * request was enqueued. If every request expired, items is 0.
+         */
+        struct batch {
+            request_arena::ref body{};
+            size_t items{0};
+            std::span<const uint64_t> tickets{};
+            clock_type::time_point enqueued{};
+            std::span<const uint64_t> expired{};
+        };
+
+      private:
+        /**
+         * @brief      Pending request, its ticket (e.g. spool::ticket, 0 if
+         * none), the time it was enqueued and its deadline.
+         */
+        struct pending_request {
+            request_arena::ref body{};
+            uint64_t ticket{0};
+            clock_type::time_point enqueued{};
+            clock_type::time_point deadline{clock_type::time_point::max()};
+        };
+
+      private:
+        batch_options _options{};
+        priority_lanes<pending_request> _pending;
+        size_t _bytes{0};
+        /*requests of the batch being packed*/
+        std::vector<request_arena::ref> _packed{};
+        std::vector<uint64_t> _tickets{};
+        std::vector<uint64_t> _expired{};
+
+      private:
+        /**
+         * @brief      Pops the next request and collects its ticket.
+         *
+         * @param[out] enqueued  Updated to the time the request was enqueued
+         * if it is older
+         *
+         * @return     The request
+         */
+        auto pop(clock_type::time_point &enqueued) -> request_arena::ref {
+            auto req{_pending.pop()};
+            _bytes -= req.body.body().size();
+            if (req.ticket != 0) { _tickets.push_back(req.ticket); }
+            enqueued = std::min(enqueued, req.enqueued);
+            return std::move(req.body);
+        }
+
+
+        /**
+         * @brief      Drops expired requests from the front of the lanes and
+         * collects their tickets.
+         *
+         * @param[in]  now   The current time
+         *
+         * @return     True iff some request is left
+         */
+        auto skip_expired(clock_type::time_point now) -> bool {
+            while (!_pending.empty() && _pending.expired(now)) {
+                auto req{_pending.expire()};
+                _bytes -= req.body.body().size();
+                if (req.ticket != 0) { _expired.push_back(req.ticket); }
+            }
+            return !_pending.empty();
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  Limits of a single batch
+         * @param[in]  lanes    Number of priority lanes
+         */
+        explicit batcher(batch_options options = {}, size_t lanes = 1)
+            : _options{options},
+              _pending{lanes} {
+            _options.max_items = std::max(_options.max_items, size_t{1});
+        }
+
+      public:
+        /**
+         * @brief      Adds a request.
+         *
+         * @param      req       The request
+         * @param[in]  ticket    Ticket returned with the batch of the request
+         * (0 if none)
+         * @param[in]  enqueued  Time the request was enqueued (linger is
+         * counted from it)
+         * @param[in]  p         Its lane and deadline
+         *
+         * @return     void
+         */
+        auto push(request_arena::ref req,
+                  uint64_t ticket = 0,
+                  clock_type::time_point enqueued = clock_type::now(),
+                  priority p = {}) {
+            _bytes += req.body().size();
+            _pending.push(p.lane,
+                          {std::move(req), ticket, enqueued, p.deadline});
+        }
+
+
+        /**
+         * @brief      True iff a batch should be sent now.
+         */
+        auto ready() const -> bool {
+            if (_pending.empty()) { return false; }
+            if (_options.framing == framing::none) { return true; }
+            return _pending.size() >= _options.max_items ||
+                   _bytes >= _options.max_bytes ||
+                   clock_type::now() - _pending.oldest() >= _options.linger;
+        }
+
+
+        /**
+         * @brief      Time left until the oldest request waits for linger.
+         *
+         * @return     Milliseconds to wait (-1 if there is nothing to wait
+         * for)
+         */
+        auto wait_time() const -> int {
+            if (_pending.empty()) { return -1; }
+            if (ready()) { return 0; }
+            auto left{std::chrono::ceil<std::chrono::milliseconds>(
+                _options.linger - (clock_type::now() - _pending.oldest()))};
+            return std::max(static_cast<int>(left.count()), 0);
+        }
+
+
+        /**
+         * @brief      Packs the next requests (in order of lanes) into one
+         * body. Requests which expired are dropped on the way. The size of
+         * the body is known once its requests are taken, so it is written
+         * straight into the arena. There must be some pending request.
+         *
+         * @param      arena  Arena storing packed bodies
+         *
+         * @return     The batch
+         */
+        auto next(request_arena &arena) -> batch {
+            _tickets.clear();
+            _expired.clear();
+            auto now{clock_type::now()};
+            auto enqueued{clock_type::time_point::max()};
+            if (!skip_expired(now)) { return {.expired = _expired}; }
+            if (_options.framing == framing::none) {
+                auto body{pop(enqueued)};
+                return {std::move(body), 1, _tickets, enqueued, _expired};
+            }
+            auto array{_options.framing == framing::json_array};
+            /*brackets of an array, a separator (',' or '\n') per request*/
+            size_t size{array ? size_t{1} : size_t{0}};
+            _packed.clear();
+            while (skip_expired(now) && _packed.size() < _options.max_items) {
+                auto next{_pending.front().body.body().size()};
+                if (!_packed.empty() && size + next + 1 > _options.max_bytes) {
+                    break;
+                }
+                size += next + 1;
+                _packed.push_back(pop(enqueued));
+            }
+            auto body{arena.append(size, [&](char *data) {
+                if (array) { *data++ = '['; }
+                for (size_t i{0}; i < _packed.size(); ++i) {
+                    auto req{_packed[i].body()};
+                    if (array && i > 0) { *data++ = ','; }
+                    data = std::ranges::copy(req, data).out;
+                    if (!array) { *data++ = '\n'; }
+                }
+                if (array) { *data = ']'; }
+            })};
+            auto items{_packed.size()};
+            _packed.clear();
+            return {std::move(body), items, _tickets, enqueued, _expired};
+        }
+
+
+        /**
+         * @brief      Content type of packed bodies (empty without framing).
+         */
+        auto content_type() const -> std::string_view {
+            switch (_options.framing) {
+                case framing::ndjson:
+                    return "Content-Type: application/x-ndjson";
+                case framing::json_array:
+                    return "Content-Type: application/json";
+                default:
+                    return {};
+            }
+        }
+
+
+        /**
+         * @brief      Maximal number of requests in one batch.
+         */
+        auto max_items() const {
+            return _options.framing == framing::none ? size_t{1}
+                                                     : _options.max_items;
+        }
+
+
+        /**
+         * @brief      Drops the oldest pending request of the last non-empty
+         * lane. There must be some.
+         *
+         * @return     Its ticket (0 if none)
+         */
+        auto drop() -> uint64_t {
+            auto req{_pending.drop()};
+            _bytes -= req.body.body().size();
+            return req.ticket;
+        }
+
+
+        /**
+         * @brief      Counters of every priority lane.
+         */
+        auto lane_counters() const { return _pending.stats(); }
+
+
+        /**
+         * @brief      Number of pending requests.
+         */
+        auto size() const { return _pending.size(); }
+
+
+        /**
+         * @brief      Size of pending requests in bytes.
+         */
+        auto bytes() const { return _bytes; }
+
+
+        /**
+         * @brief      True iff there is no pending request.
+         */
+        auto empty() const { return _pending.empty(); }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <zlib.h>
+
+#ifdef CPPURL_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Content encoding of posted bodies.
+     */
+    enum class compression : uint8_t { none, gzip, zstd };
+
+
+    /**
+     * @brief      Settings of request body compression.
+     */
+    struct compression_options {
+        compression method{compression::none};
+        /*bodies smaller than this are sent as they are (the headers and
+         * the cpu time are not worth it)*/
+        size_t min_size{1024};
+        /*0 means the default level of the method*/
+        int level{0};
+    };
+
+
+    /**
+     * @brief      Compressor of request bodies of a single handle. The state
+     * of the method (a deflate stream or a zstd context) and the output
+     * buffer are created once and reset for every body, so that compressing
+     * does not allocate once the buffer fits the largest body. Zstd is
+     * available only if compiled with CPPURL_WITH_ZSTD.
+     */
+    class compressor {
+      private:
+        compression_options _options{};
+        z_stream _deflate{};
+        bool _deflate_initialized{false};
+#ifdef CPPURL_WITH_ZSTD
+        ZSTD_CCtx *_zstd{nullptr};
+#endif
+        std::unique_ptr<char[]> _output{};
+        size_t _capacity{0};
+
+      private:
+        /**
+         * @brief      Grows the output buffer to at least size bytes.
+         *
+         * @return     The buffer
+         */
+        auto output(size_t size) -> char * {
+            if (size > _capacity) {
+                _capacity = std::max(size, _capacity * 2);
+                _output = std::make_unique_for_overwrite<char[]>(_capacity);
+            }
+            return _output.get();
+        }
+
+
+        auto gzip(std::string_view body) -> std::optional<std::string_view> {
+            if (deflateReset(&_deflate) != Z_OK) { return std::nullopt; }
+            auto bound{deflateBound(&_deflate, body.size())};
+            _deflate.next_in = reinterpret_cast<Bytef *>(
+                const_cast<char *>(body.data()));
+            _deflate.avail_in = static_cast<uInt>(body.size());
+            _deflate.next_out = reinterpret_cast<Bytef *>(output(bound));
+            _deflate.avail_out = static_cast<uInt>(bound);
+            if (deflate(&_deflate, Z_FINISH) != Z_STREAM_END) {
+                return std::nullopt;
+            }
+            return std::string_view{_output.get(), _deflate.total_out};
+        }
+
+
+#ifdef CPPURL_WITH_ZSTD
+        auto zstd(std::string_view body) -> std::optional<std::string_view> {
+            auto bound{ZSTD_compressBound(body.size())};
+            auto size{ZSTD_compress2(
+                _zstd, output(bound), bound, body.data(), body.size())};
+            if (ZSTD_isError(size)) { return std::nullopt; }
+            return std::string_view{_output.get(), size};
+        }
+#endif
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The options
+         */
+        explicit compressor(compression_options options) : _options{options} {
+            switch (_options.method) {
+                case compression::gzip:
+                    /*15 bits of window + 16 for a gzip header and trailer*/
+                    if (deflateInit2(&_deflate,
+                                     _options.level == 0
+                                         ? Z_DEFAULT_COMPRESSION
+                                         : _options.level,
+                                     Z_DEFLATED,
+                                     15 + 16,
+                                     8,
+                                     Z_DEFAULT_STRATEGY) != Z_OK) {
+                        throw std::runtime_error{
+                            "could not initialize gzip compression"};
+                    }
+                    _deflate_initialized = true;
+                    break;
+                case compression::zstd:
+#ifdef CPPURL_WITH_ZSTD
+                    _zstd = ZSTD_createCCtx();
+                    if (!_zstd ||
+                        ZSTD_isError(ZSTD_CCtx_setParameter(
+                            _zstd,
+                            ZSTD_c_compressionLevel,
+                            _options.level == 0 ? ZSTD_CLEVEL_DEFAULT
+                                                : _options.level))) {
+                        ZSTD_freeCCtx(_zstd);
+                        throw std::runtime_error{
+                            "could not initialize zstd compression"};
+                    }
+                    break;
+#else
+                    throw std::runtime_error{
+                        "zstd compression is not available (compile with "
+                        "CPPURL_WITH_ZSTD)"};
+#endif
+                default:
+                    break;
+            }
+        }
+
+
+        compressor(const compressor &) = delete;
+        compressor &operator=(const compressor &) = delete;
+
+
+        /**
+         * @brief      Destroys the object.
+         */
+        ~compressor() noexcept {
+            if (_deflate_initialized) { deflateEnd(&_deflate); }
+#ifdef CPPURL_WITH_ZSTD
+            ZSTD_freeCCtx(_zstd);
+#endif
+        }
+
+      public:
+        /**
+         * @brief      True iff zstd was compiled in.
+         */
+        static constexpr auto has_zstd() {
+#ifdef CPPURL_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+        }
+
+
+        /**
+         * @brief      Name of a method as used in Content-Encoding.
+         */
+        static auto name(compression method) -> std::string_view {
+            switch (method) {
+                case compression::gzip:
+                    return "gzip";
+                case compression::zstd:
+                    return "zstd";
+                default:
+                    return "identity";
+            }
+        }
+
+
+        /**
+         * @brief      The Content-Encoding header of compressed bodies.
+         */
+        auto header() const -> std::string_view {
+            switch (_options.method) {
+                case compression::gzip:
+                    return "Content-Encoding: gzip";
+                case compression::zstd:
+                    return "Content-Encoding: zstd";
+                default:
+                    return {};
+            }
+        }
+
+
+        /**
+         * @brief      Compresses a body.
+         *
+         * @param[in]  body  The body
+         *
+         * @return     The compressed body, valid until the next call, or
+         * nullopt if the body should be sent as it is (it is below the
+         * minimal size, it did not shrink or compression failed)
+         */
+        auto compress(std::string_view body)
+            -> std::optional<std::string_view> {
+            if (body.size() < _options.min_size) { return std::nullopt; }
+            std::optional<std::string_view> compressed{};
+            switch (_options.method) {
+                case compression::gzip:
+                    compressed = gzip(body);
+                    break;
+#ifdef CPPURL_WITH_ZSTD
+                case compression::zstd:
+                    compressed = zstd(body);
+                    break;
+#endif
+                default:
+                    return std::nullopt;
+            }
+            if (compressed && compressed->size() >= body.size()) {
+                return std::nullopt;
+            }
+            return compressed;
+        }
+    };
+
+
+}  // namespace cppurl
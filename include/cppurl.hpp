@@ -2,15 +2,28 @@
 
 #include <curl/curl.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <compressor.hpp>
 #include <exception>
 #include <expected>
 #include <format>
+#include <functional>
+#include <initializer_list>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <ranges>
+#include <request_arena.hpp>
+#include <response_pool.hpp>
 #include <span>
-#include <stack>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 /*
  * WARNING! THIS HEADER IS A SIMPLE CPP WRAPPER AROUND CURL BASIC STRUCTURES
@@ -79,9 +92,10 @@ namespace cppurl {
 
 
     /**
-     * @brief      Used to distinguish between curl simple, multi and url types
+     * @brief      Used to distinguish between curl simple, multi, url and
+     * share types
      */
-    enum class ffor { single, multi, url };
+    enum class ffor { single, multi, url, share };
 
     /**
      * @brief      Wrapper for curl status
@@ -93,7 +107,10 @@ namespace cppurl {
         using code_type = std::conditional_t<
             m == ffor::single,
             CURLcode,
-            std::conditional_t<m == ffor::multi, CURLMcode, CURLUcode>>;
+            std::conditional_t<
+                m == ffor::multi,
+                CURLMcode,
+                std::conditional_t<m == ffor::url, CURLUcode, CURLSHcode>>>;
 
       public:
         code_type code{};
@@ -107,8 +124,10 @@ namespace cppurl {
                 return (code == CURLE_OK);
             } else if constexpr (m == ffor::multi) {
                 return (code == CURLM_OK) || (code == CURLM_CALL_MULTI_PERFORM);
-            } else {
+            } else if constexpr (m == ffor::url) {
                 return (code == CURLUE_OK);
+            } else {
+                return (code == CURLSHE_OK);
             }
         }
 
@@ -123,8 +142,10 @@ namespace cppurl {
                 return std::string_view{curl_easy_strerror(code)};
             } else if constexpr (m == ffor::multi) {
                 return std::string_view{curl_multi_strerror(code)};
-            } else {
+            } else if constexpr (m == ffor::url) {
                 return std::string_view{curl_url_strerror(code)};
+            } else {
+                return std::string_view{curl_share_strerror(code)};
             }
         }
     };
@@ -207,6 +228,205 @@ namespace cppurl {
     };
 
 
+    /**
+     * @brief      A wrapper for curl list of http headers.
+     */
+    class header_list {
+      private:
+        curl_slist *_list{nullptr};
+
+      public:
+        header_list() = default;
+
+
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  headers  Headers of the form "Name: value"
+         */
+        explicit header_list(std::initializer_list<std::string_view> headers) {
+            for (auto h : headers) {
+                if (!append(h)) {
+                    throw std::runtime_error{"could not append http header"};
+                }
+            }
+        }
+
+
+        header_list(const header_list &) = delete;
+        header_list &operator=(const header_list &) = delete;
+
+
+        header_list(header_list &&other) noexcept
+            : _list{std::exchange(other._list, nullptr)} {}
+
+
+        header_list &operator=(header_list &&other) noexcept {
+            if (this != &other) {
+                curl_slist_free_all(_list);
+                _list = std::exchange(other._list, nullptr);
+            }
+            return *this;
+        }
+
+
+        /**
+         * @brief      Destroys the object.
+         */
+        ~header_list() noexcept { curl_slist_free_all(_list); }
+
+      public:
+        /**
+         * @brief      Appends a header.
+         *
+         * @param[in]  header  The header of the form "Name: value"
+         *
+         * @return     True iff the header was appended
+         */
+        auto append(std::string_view header) -> bool {
+            auto list{curl_slist_append(_list, std::string{header}.c_str())};
+            if (!list) { return false; }
+            _list = list;
+            return true;
+        }
+
+
+        /**
+         * @brief      Appends all headers of other.
+         *
+         * @param[in]  other  The headers
+         *
+         * @return     True iff all headers were appended
+         */
+        auto append(const header_list &other) -> bool {
+            for (auto h{other._list}; h; h = h->next) {
+                if (!append(h->data)) { return false; }
+            }
+            return true;
+        }
+
+
+        /**
+         * @brief      Returns an underlying curl representation of the object.
+         *
+         * @return     Underlying representation of the object.
+         */
+        auto to_underlying() const { return _list; }
+    };
+
+
+    /**
+     * @brief      A wrapper for curl share handle. Simple handles using it
+     * share chosen data (e.g. DNS cache, TLS sessions, connection cache), also
+     * when they belong to different multi handles or threads (every kind of
+     * data is guarded by its own mutex).
+     */
+    template <>
+    class handle<ffor::share> {
+      private:
+        using handle_type = CURLSH *;
+        using error = status<ffor::share>;
+
+      private:
+        handle_type _handle{curl_share_init()};
+        std::array<std::mutex, CURL_LOCK_DATA_LAST> _mutexes{};
+
+      private:
+        /**
+         * @brief      Curl lock function.
+         */
+        static void _lock(CURL *,
+                          curl_lock_data data,
+                          curl_lock_access,
+                          void *userp) {
+            static_cast<handle *>(userp)->_mutexes[data].lock();
+        }
+
+
+        /**
+         * @brief      Curl unlock function.
+         */
+        static void _unlock(CURL *, curl_lock_data data, void *userp) {
+            static_cast<handle *>(userp)->_mutexes[data].unlock();
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  data  Kinds of data to be shared
+         */
+        explicit handle(std::initializer_list<curl_lock_data> data = {
+                            CURL_LOCK_DATA_DNS, CURL_LOCK_DATA_SSL_SESSION}) {
+            if (!_handle) {
+                throw std::runtime_error{
+                    "share handle could not be initialized"};
+            }
+            if (!error{curl_share_setopt(_handle, CURLSHOPT_USERDATA, this)} ||
+                !error{curl_share_setopt(_handle, CURLSHOPT_LOCKFUNC, _lock)} ||
+                !error{curl_share_setopt(
+                    _handle, CURLSHOPT_UNLOCKFUNC, _unlock)}) {
+                throw std::runtime_error{"could not set share handle locks"};
+            }
+            for (auto d : data) {
+                if (!share(d)) {
+                    throw std::runtime_error{
+                        "share handle could not share requested data"};
+                }
+            }
+        }
+
+
+        handle(const handle &) = delete;
+        handle &operator=(const handle &) = delete;
+
+
+        /**
+         * @brief      Destroys the object. All simple handles using it must be
+         * destroyed before.
+         */
+        ~handle() {
+            if (_handle) { curl_share_cleanup(_handle); }
+        }
+
+      public:
+        /**
+         * @brief      Starts sharing given kind of data.
+         *
+         * @param[in]  data  Kind of data
+         *
+         * @return     status
+         */
+        auto share(curl_lock_data data) -> error {
+            return error{curl_share_setopt(_handle, CURLSHOPT_SHARE, data)};
+        }
+
+
+        /**
+         * @brief      Returns an underlying curl representation of the object.
+         *
+         * @return     Underlying representation of the object.
+         */
+        auto to_underlying() { return _handle; }
+    };
+
+
+    using share_handle = class handle<ffor::share>;
+
+
+    /**
+     * @brief      Phases of a transfer, each measured from its start (see
+     * CURLINFO_*_TIME_T).
+     */
+    struct transfer_timings {
+        std::chrono::microseconds namelookup{};
+        std::chrono::microseconds connect{};
+        std::chrono::microseconds appconnect{};
+        std::chrono::microseconds starttransfer{};
+        std::chrono::microseconds total{};
+    };
+
+
     /**
      * @brief      A wrapper for curl simple handle.
      */
@@ -237,9 +457,77 @@ namespace cppurl {
         };
 
 
+        /**
+         * @brief      Curl writing function which captures the response into
+         * a buffer taken from the response pool of the handle.
+         *
+         * @param      data   The response data
+         * @param[in]  n      number of bytes
+         * @param[in]  l      always 1
+         * @param      userp  The handle
+         *
+         * @return     n * l (the whole response is always accepted)
+         */
+        static auto _capture(char *data, size_t n, size_t l, void *userp)
+            -> size_t {
+            auto &h{*static_cast<handle *>(userp)};
+            if (!h._response_acquired) {
+                h._response = h._responses->acquire();
+                h._response_acquired = true;
+            }
+            h._responses->append(h._response, {data, n * l});
+            return n * l;
+        }
+
+
+        /**
+         * @brief      Builds the headers of compressed bodies (the headers set
+         * by headers() followed by Content-Encoding).
+         *
+         * @return     status
+         */
+        auto encode_headers() -> error {
+            _encoded_headers = header_list{};
+            if ((_headers && !_encoded_headers.append(*_headers)) ||
+                !_encoded_headers.append(_compressor->header())) {
+                return error{CURLE_OUT_OF_MEMORY};
+            }
+            return error{CURLE_OK};
+        }
+
+
       private:
         handle_type _handle{curl_easy_init()};
         url_type _url{};
+        /*body posted without copying (see post(request_arena::ref))*/
+        request_arena::ref _body{};
+        size_t _items{0};
+        size_t _attempt{0};
+        /*tickets of the packed requests (e.g. spool::ticket)*/
+        std::vector<uint64_t> _tickets{};
+        /*time the oldest packed request was enqueued (owner defined)*/
+        std::chrono::steady_clock::time_point _enqueued{};
+        /*index of the destination the url was set for (owner defined)*/
+        size_t _destination{0};
+        /*opaque pointer of the owner (e.g. the awaiter of the transfer)*/
+        void *_owner{nullptr};
+        /*compressor of bodies set by post(request_arena::ref) (null if they
+         * are sent as they are)*/
+        std::unique_ptr<compressor> _compressor{};
+        /*headers set by headers() and the same with Content-Encoding*/
+        const header_list *_headers{nullptr};
+        header_list _encoded_headers{};
+        /*headers of the next post only (see request_header), their buffers
+         * and nodes are kept for later posts*/
+        std::vector<std::string> _request_headers{};
+        std::vector<curl_slist> _request_nodes{};
+        size_t _request_count{0};
+        /*body as posted (compressed or not)*/
+        std::string_view _posted{};
+        /*pool of response buffers (null if responses are not captured)*/
+        response_pool *_responses{nullptr};
+        std::string _response{};
+        bool _response_acquired{false};
 
 
       public:
@@ -317,6 +605,370 @@ namespace cppurl {
         }
 
 
+        /**
+         * @brief      Sets this handle to post mode and sets post fields
+         * without copying them. The handle keeps the body (and thus its arena
+         * chunk) alive until release_body() is called.
+         *
+         * @param[in]  body     Post fields stored in request_arena
+         * @param[in]  items    Number of requests packed into body
+         * @param[in]  attempt  Number of previous attempts to post body
+         * @param[in]  tickets   Tickets of the packed requests (copied)
+         * @param[in]  enqueued  Time the oldest packed request was enqueued
+         *
+         * @return     status
+         */
+        auto post(request_arena::ref body,
+                  size_t items = 1,
+                  size_t attempt = 0,
+                  std::span<const uint64_t> tickets = {},
+                  std::chrono::steady_clock::time_point enqueued = {})
+            -> error {
+            _body = std::move(body);
+            _items = items;
+            _attempt = attempt;
+            _tickets.assign(tickets.begin(), tickets.end());
+            _enqueued = enqueued;
+            _posted = _body.body();
+            auto headers{_headers};
+            if (_compressor) {
+                if (auto compressed{_compressor->compress(_posted)}) {
+                    _posted = *compressed;
+                    headers = &_encoded_headers;
+                }
+            }
+            auto list{headers ? headers->to_underlying() : nullptr};
+            /*own nodes are linked in front of the shared list (curl only
+             * reads the list)*/
+            for (auto i{_request_count}; i-- > 0;) {
+                _request_nodes[i] = {_request_headers[i].data(), list};
+                list = &_request_nodes[i];
+            }
+            if (_compressor || _request_count > 0) {
+                FORWARD_ERROR(
+                    error{curl_easy_setopt(_handle, CURLOPT_HTTPHEADER, list)});
+            }
+            return post<false>(_posted);
+        }
+
+
+        /**
+         * @brief      Body set by post(request_arena::ref).
+         */
+        auto body() const -> std::string_view { return _body.body(); }
+
+
+        /**
+         * @brief      Body set by post(request_arena::ref) as it is sent, i.e.
+         * compressed if it was worth it (valid until the next post).
+         */
+        auto posted() const -> std::string_view { return _posted; }
+
+
+        /**
+         * @brief      Number of requests packed into body().
+         */
+        auto items() const { return _items; }
+
+
+        /**
+         * @brief      Number of previous attempts to post body().
+         */
+        auto attempt() const { return _attempt; }
+
+
+        /**
+         * @brief      Tickets of the requests packed into body().
+         */
+        auto tickets() const -> std::span<const uint64_t> { return _tickets; }
+
+
+        /**
+         * @brief      Time the oldest request packed into body() was enqueued.
+         */
+        auto enqueued() const { return _enqueued; }
+
+
+        /**
+         * @brief      Index of the destination this handle is set up for.
+         */
+        auto destination() const { return _destination; }
+
+
+        /**
+         * @brief      Sets url of the destination and remembers its index, so
+         * that the url is set again only when the destination changes.
+         *
+         * @param[in]  index  Index of the destination
+         * @param[in]  path   Url of the destination
+         *
+         * @return     status of setting new url
+         */
+        auto destination(size_t index, std::string_view path)
+            -> status<ffor::url> {
+            _destination = index;
+            return url(path);
+        }
+
+
+        /**
+         * @brief      Opaque pointer set by owner(void *).
+         */
+        auto owner() const { return _owner; }
+
+
+        /**
+         * @brief      Sets an opaque pointer of the owner of the transfer.
+         *
+         * @param      p     The pointer
+         *
+         * @return     void
+         */
+        auto owner(void *p) { _owner = p; }
+
+
+        /**
+         * @brief      Takes the body set by post(request_arena::ref) out of
+         * this handle (e.g. to post it again later). Its items, attempt and
+         * tickets are kept until release_body().
+         *
+         * @return     The body
+         */
+        auto take_body() -> request_arena::ref { return std::move(_body); }
+
+
+        /**
+         * @brief      Releases the body set by post(request_arena::ref). Call
+         * it once the transfer is completed.
+         *
+         * @return     void
+         */
+        auto release_body() {
+            _body.reset();
+            if (std::exchange(_request_count, 0) > 0) {
+                /*back to the shared list for posts without own headers*/
+                curl_easy_setopt(
+                    _handle,
+                    CURLOPT_HTTPHEADER,
+                    _headers ? _headers->to_underlying() : nullptr);
+            }
+            _posted = {};
+            _items = 0;
+            _attempt = 0;
+            _tickets.clear();
+            _enqueued = {};
+        }
+
+
+        /**
+         * @brief      Captures response bodies into buffers of the pool (up to
+         * its maximal size) instead of passing them to the default writing
+         * function of curl. The pool must outlive this handle.
+         *
+         * @param      pool  The pool
+         *
+         * @return     status
+         */
+        auto capture(response_pool &pool) -> error {
+            _responses = &pool;
+            FORWARD_ERROR(error{
+                curl_easy_setopt(_handle, CURLOPT_WRITEFUNCTION, _capture)});
+            return error{curl_easy_setopt(_handle, CURLOPT_WRITEDATA, this)};
+        }
+
+
+        /**
+         * @brief      Response body of the last transfer captured so far
+         * (empty if responses are not captured). Valid until
+         * release_response().
+         */
+        auto response() const -> std::string_view {
+            return _response_acquired ? std::string_view{_response}
+                                      : std::string_view{};
+        }
+
+
+        /**
+         * @brief      Gives the buffer of the captured response back to the
+         * pool. Call it once the transfer is reported.
+         *
+         * @return     void
+         */
+        auto release_response() {
+            if (!_response_acquired) { return; }
+            _responses->release(std::move(_response));
+            _response.clear();
+            _response_acquired = false;
+        }
+
+
+        /**
+         * @brief      Http headers setter. The list must outlive transfers of
+         * this handle.
+         *
+         * @param[in]  headers  The headers
+         *
+         * @return     status
+         */
+        auto headers(const header_list &headers) -> error {
+            _headers = &headers;
+            if (_compressor) { FORWARD_ERROR(encode_headers()); }
+            return error{curl_easy_setopt(
+                _handle, CURLOPT_HTTPHEADER, headers.to_underlying())};
+        }
+
+
+        /**
+         * @brief      Adds a header of the next post(request_arena::ref) only
+         * (e.g. an idempotency key), until release_body(). Such headers are
+         * sent before the headers set by headers() (and Content-Encoding),
+         * which are shared by all handles and not copied: the nodes of own
+         * headers are linked in front of the shared list. The header is
+         * copied into a buffer of the handle which keeps its capacity, so
+         * own headers do not allocate once the buffers fit them.
+         *
+         * @param[in]  header  The header of the form "Name: value" (it must
+         * not contain CR or LF)
+         *
+         * @return     void
+         */
+        auto request_header(std::string_view header) {
+            if (_request_count == _request_headers.size()) {
+                _request_headers.emplace_back();
+                _request_nodes.emplace_back();
+            }
+            _request_headers[_request_count++].assign(header);
+        }
+
+
+        /**
+         * @brief      Compresses bodies set by post(request_arena::ref) of at
+         * least options.min_size bytes and sends them with Content-Encoding
+         * (added to the headers set by headers()). The compressor and its
+         * buffer are kept for all transfers of this handle.
+         *
+         * @param[in]  options  The options (std::runtime_error is thrown if
+         * the method is not available)
+         *
+         * @return     status
+         */
+        auto compress(compression_options options) -> error {
+            if (options.method == compression::none) {
+                _compressor.reset();
+                return error{CURLE_OK};
+            }
+            _compressor = std::make_unique<compressor>(options);
+            return encode_headers();
+        }
+
+
+        /**
+         * @brief      Share handle setter. The share handle must outlive this
+         * handle.
+         *
+         * @param      share  The share handle
+         *
+         * @return     status
+         */
+        auto share(handle<ffor::share> &share) -> error {
+            return error{curl_easy_setopt(
+                _handle, CURLOPT_SHARE, share.to_underlying())};
+        }
+
+
+        /**
+         * @brief      Http version setter
+         *
+         * @param[in]  version  One of CURL_HTTP_VERSION_* values
+         *
+         * @return     status
+         */
+        auto http_version(long version) -> error {
+            return error{
+                curl_easy_setopt(_handle, CURLOPT_HTTP_VERSION, version)};
+        }
+
+
+        /**
+         * @brief      If set, the transfer rather waits for a connection which
+         * can be multiplexed than opens a new one.
+         *
+         * @param[in]  wait  True iff the transfer should wait
+         *
+         * @return     status
+         */
+        auto pipewait(bool wait) -> error {
+            return error{curl_easy_setopt(
+                _handle, CURLOPT_PIPEWAIT, static_cast<long>(wait))};
+        }
+
+
+        /**
+         * @brief      Http response code of the last transfer.
+         *
+         * @return     The response code (0 if no response was received) or
+         * error
+         */
+        auto response_code() -> std::expected<long, error> {
+            long code{0};
+            error e{curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &code)};
+            if (!e) { return std::unexpected{e}; }
+            return code;
+        }
+
+
+        /**
+         * @brief      Delay requested by Retry-After header of the last
+         * response.
+         *
+         * @return     The delay (0 if there was no such header) or error
+         */
+        auto retry_after() -> std::expected<std::chrono::seconds, error> {
+            curl_off_t seconds{0};
+            error e{
+                curl_easy_getinfo(_handle, CURLINFO_RETRY_AFTER, &seconds)};
+            if (!e) { return std::unexpected{e}; }
+            return std::chrono::seconds{seconds};
+        }
+
+
+        /**
+         * @brief      Number of new connections the last transfer had to
+         * create (0 if it reused or multiplexed an existing one).
+         *
+         * @return     Number of new connections or error
+         */
+        auto new_connections() -> std::expected<long, error> {
+            long connections{0};
+            error e{curl_easy_getinfo(
+                _handle, CURLINFO_NUM_CONNECTS, &connections)};
+            if (!e) { return std::unexpected{e}; }
+            return connections;
+        }
+
+
+        /**
+         * @brief      Timings of the phases of the last transfer.
+         *
+         * @return     The timings or error
+         */
+        auto timings() -> std::expected<transfer_timings, error> {
+            transfer_timings t{};
+            for (auto [info, phase] :
+                 {std::pair{CURLINFO_NAMELOOKUP_TIME_T, &t.namelookup},
+                  std::pair{CURLINFO_CONNECT_TIME_T, &t.connect},
+                  std::pair{CURLINFO_APPCONNECT_TIME_T, &t.appconnect},
+                  std::pair{CURLINFO_STARTTRANSFER_TIME_T, &t.starttransfer},
+                  std::pair{CURLINFO_TOTAL_TIME_T, &t.total}}) {
+                curl_off_t us{0};
+                error e{curl_easy_getinfo(_handle, info, &us)};
+                if (!e) { return std::unexpected{e}; }
+                *phase = std::chrono::microseconds{us};
+            }
+            return t;
+        }
+
+
         /**
          * @brief      Perform wrapper
          *
@@ -401,6 +1053,36 @@ namespace cppurl {
         }
 
 
+        /**
+         * @brief      Http response code of the transfer.
+         *
+         * @return     The response code (0 if no response was received) or
+         * error
+         */
+        auto response_code()
+            -> std::expected<long, cppurl::status<ffor::single>> {
+            auto h{handle()};
+            if (!h) { return std::unexpected{h.error()}; }
+            return (*h)->response_code();
+        }
+
+
+        /**
+         * @brief      Captured response body of the transfer (see
+         * handle<ffor::single>::capture). The view is valid only until the
+         * transfer callback returns.
+         *
+         * @return     The response body (empty if it was not captured) or
+         * error
+         */
+        auto response()
+            -> std::expected<std::string_view, cppurl::status<ffor::single>> {
+            auto h{handle()};
+            if (!h) { return std::unexpected{h.error()}; }
+            return (*h)->response();
+        }
+
+
         /**
          * @brief      True iff there is some message
          */
@@ -485,6 +1167,74 @@ namespace cppurl {
         }
 
 
+        /**
+         * @brief      Wrapper for multi socket action
+         *
+         * @param[in]  s           socket on which action happened (or
+         * CURL_SOCKET_TIMEOUT if timer expired)
+         * @param[in]  ev_bitmask  bitmask of CURL_CSELECT_* flags
+         *
+         * @return     Still running handles if succeded. Otherwise, error.
+         */
+        auto socket_action(curl_socket_t s, int ev_bitmask)
+            -> std::expected<int, error> {
+            int still_running_handles{-1};
+            error e{curl_multi_socket_action(
+                _multi_handle, s, ev_bitmask, &still_running_handles)};
+            if (e) {
+                return still_running_handles;
+            } else {
+                return std::unexpected{e};
+            }
+        }
+
+
+        /**
+         * @brief      Socket function setter
+         *
+         * @param      f      new socket function
+         * @param      userp  pointer passed to socket function
+         *
+         * @return     status
+         */
+        auto socket_function(curl_socket_callback f, void *userp) -> error {
+            FORWARD_ERROR(error{
+                curl_multi_setopt(_multi_handle, CURLMOPT_SOCKETDATA, userp)});
+            return error{
+                curl_multi_setopt(_multi_handle, CURLMOPT_SOCKETFUNCTION, f)};
+        }
+
+
+        /**
+         * @brief      Timer function setter
+         *
+         * @param      f      new timer function
+         * @param      userp  pointer passed to timer function
+         *
+         * @return     status
+         */
+        auto timer_function(curl_multi_timer_callback f, void *userp)
+            -> error {
+            FORWARD_ERROR(error{
+                curl_multi_setopt(_multi_handle, CURLMOPT_TIMERDATA, userp)});
+            return error{
+                curl_multi_setopt(_multi_handle, CURLMOPT_TIMERFUNCTION, f)};
+        }
+
+
+        /**
+         * @brief      Wrapper for multi assign
+         *
+         * @param[in]  s      socket
+         * @param      sockp  pointer passed to socket function for s
+         *
+         * @return     status
+         */
+        auto assign(curl_socket_t s, void *sockp) -> error {
+            return error{curl_multi_assign(_multi_handle, s, sockp)};
+        }
+
+
         /**
          * @brief      Wrapper fo info_read
          *
@@ -509,18 +1259,89 @@ namespace cppurl {
                 curl_multi_setopt(_multi_handle, CURLMOPT_MAXCONNECTS, n)};
         }
 
+
+        /**
+         * @brief      Setter of maximal number of connections to a single
+         * host (0 means no limit)
+         *
+         * @param[in]  n     max number of connections per host
+         *
+         * @return     status
+         */
+        auto maximal_number_of_host_connections(long n) -> error {
+            return error{curl_multi_setopt(
+                _multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, n)};
+        }
+
+
+        /**
+         * @brief      Setter of maximal number of concurrent http/2 streams
+         * on a single connection
+         *
+         * @param[in]  n     max number of streams
+         *
+         * @return     status
+         */
+        auto maximal_number_of_concurrent_streams(long n) -> error {
+            return error{curl_multi_setopt(
+                _multi_handle, CURLMOPT_MAX_CONCURRENT_STREAMS, n)};
+        }
+
+
+        /**
+         * @brief      Enables or disables http/2 multiplexing of transfers
+         *
+         * @param[in]  enabled  True iff transfers should be multiplexed
+         *
+         * @return     status
+         */
+        auto multiplexing(bool enabled) -> error {
+            return error{curl_multi_setopt(
+                _multi_handle,
+                CURLMOPT_PIPELINING,
+                enabled ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING)};
+        }
+
         /**
          * @brief      Wrapper for curl wait
          *
          * @param[in]  timeout_ms  The timeout milliseconds
+         * @param[in]  extra_fds   Additional file descriptors to wait on
          *
          * @return     number of file descriptor events or error
          */
-        auto wait(int timeout_ms) -> std::expected<int, error> {
+        auto wait(int timeout_ms, std::span<curl_waitfd> extra_fds = {})
+            -> std::expected<int, error> {
             int number_of_file_descriptor_events{};
             error e{curl_multi_wait(_multi_handle,
-                                    nullptr,
-                                    0,
+                                    extra_fds.data(),
+                                    static_cast<unsigned>(extra_fds.size()),
+                                    timeout_ms,
+                                    &number_of_file_descriptor_events)};
+            if (!e) {
+                return std::unexpected{e};
+            } else {
+                return number_of_file_descriptor_events;
+            }
+        }
+
+
+        /**
+         * @brief      Wrapper for curl poll. Unlike wait, it sleeps for the
+         * whole timeout even if there is nothing to wait for, and it returns
+         * early when wakeup() is called.
+         *
+         * @param[in]  timeout_ms  The timeout milliseconds
+         * @param[in]  extra_fds   Additional file descriptors to wait on
+         *
+         * @return     number of file descriptor events or error
+         */
+        auto poll(int timeout_ms, std::span<curl_waitfd> extra_fds = {})
+            -> std::expected<int, error> {
+            int number_of_file_descriptor_events{};
+            error e{curl_multi_poll(_multi_handle,
+                                    extra_fds.data(),
+                                    static_cast<unsigned>(extra_fds.size()),
                                     timeout_ms,
                                     &number_of_file_descriptor_events)};
             if (!e) {
@@ -531,6 +1352,17 @@ namespace cppurl {
         }
 
 
+        /**
+         * @brief      Wakes up poll() sleeping in another thread (or the
+         * next call of it). May be called from any thread.
+         *
+         * @return     status
+         */
+        auto wakeup() -> error {
+            return error{curl_multi_wakeup(_multi_handle)};
+        }
+
+
         /**
          * @brief      Returns an underlying  curl multi handle.
          *
@@ -546,79 +1378,267 @@ namespace cppurl {
 
 
     /**
-     * @brief      Static set of simple handles
+     * @brief      Elastic set of simple handles. Handles are created on demand
+     * up to a maximal number and those idle for longer than idle_timeout are
+     * destroyed (but at least minimal number of handles is kept). Free handles
+     * are kept on an intrusive lock-free stack, thus add() may be called from
+     * any thread. get() and trim() must be called from the owning thread only
+     * (single consumer, so the stack is not prone to ABA). Every handle is
+     * configured once, right after creation, thus only per-transfer settings
+     * (e.g. the body) remain to be set on the hot path.
      *
-     * @tparam     N     Number of available handles.
+     * @tparam     Status  Status returned by the configuring function
      */
-    template <size_t N>
+    template <typename Status = status<ffor::single>>
     class handle_pool {
+      public:
+        using configure_type = std::function<Status(b_handle &)>;
+
+      public:
+        static constexpr std::chrono::seconds default_idle_timeout{30};
+
       private:
-        std::array<b_handle, N> _handles{};
-        std::stack<b_handle *> _available_handles{};
+        using clock_type = std::chrono::steady_clock;
+
+
+        /**
+         * @brief      Simple handle together with its free list link.
+         */
+        struct node : b_handle {
+            node *next{nullptr};
+            clock_type::time_point idle_since{};
+            bool trimmed{false};
+        };
+
+      private:
+        size_t _min{};
+        size_t _max{};
+        clock_type::duration _idle_timeout{};
+        clock_type::time_point _last_trim{clock_type::now()};
+        std::vector<std::unique_ptr<node>> _handles{};
+        std::atomic<node *> _free{nullptr};
+        std::atomic<size_t> _available{0};
+        configure_type _configure{};
+
+      private:
+        /**
+         * @brief      Pushes a handle onto the free list.
+         *
+         * @param      n     The handle
+         *
+         * @return     void
+         */
+        auto push(node *n) {
+            n->next = _free.load(std::memory_order_relaxed);
+            while (!_free.compare_exchange_weak(n->next,
+                                                n,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {}
+            _available.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Pops a handle from the free list (owning thread only).
+         *
+         * @return     The handle or nullptr if the list is empty.
+         */
+        auto pop() -> node * {
+            auto n{_free.load(std::memory_order_acquire)};
+            while (n && !_free.compare_exchange_weak(
+                            n, n->next, std::memory_order_acquire)) {}
+            if (n) { _available.fetch_sub(1, std::memory_order_relaxed); }
+            return n;
+        }
+
+
+        /**
+         * @brief      Creates and configures a new handle.
+         *
+         * @return     The handle or the status of the failed configuration
+         */
+        auto create() -> std::expected<node *, Status> {
+            auto n{std::make_unique<node>()};
+            if (_configure) { UNEXP_FORWARD_ERROR(_configure(*n)); }
+            _handles.push_back(std::move(n));
+            return _handles.back().get();
+        }
 
       public:
         /**
          * @brief      Constructs a new instance.
+         *
+         * @param[in]  min           Number of handles created up front and
+         * never trimmed
+         * @param[in]  max           Maximal number of handles
+         * @param[in]  configure     Function called for every new handle
+         * (std::runtime_error is thrown if a handle created up front cannot be
+         * configured)
+         * @param[in]  idle_timeout  Free handles idle for longer are destroyed
          */
-        handle_pool() {
-            for (auto &h : _handles) { _available_handles.push(&h); }
+        handle_pool(size_t min,
+                    size_t max,
+                    configure_type configure = {},
+                    std::chrono::seconds idle_timeout = default_idle_timeout)
+            : _min{std::min(min, max)},
+              _max{max},
+              _idle_timeout{idle_timeout},
+              _configure{std::move(configure)} {
+            _handles.reserve(_max);
+            for (size_t i{0}; i < _min; ++i) {
+                auto n{create()};
+                if (!n) {
+                    throw std::runtime_error{
+                        std::format("could not configure single handle: {}",
+                                    n.error().what())};
+                }
+                push(*n);
+            }
         }
 
+
+        handle_pool(const handle_pool &) = delete;
+        handle_pool &operator=(const handle_pool &) = delete;
+
       public:
         /**
-         * @brief      Gets a free simple handle
+         * @brief      Gets a free simple handle (creates one if none is free).
+         * There must be size() > 0.
          *
-         * @return     Simple handle
+         * @return     Simple handle or the status of the failed configuration
+         * of a new one
          */
-        auto get() -> b_handle & {
-            auto h{_available_handles.top()};
-            _available_handles.pop();
-            return *h;
+        auto get() -> std::expected<b_handle *, Status> {
+            if (auto n{pop()}) { return n; }
+            assert(_handles.size() < _max);
+            UNEXP_FORWARD_UNEXPECTED(create());
+            return _handles.back().get();
         }
 
 
         /**
-         * @brief      Adds new simple handle to pool.
+         * @brief      Returns simple handle to the pool. It must come from
+         * get() of this pool.
          *
          * @param      h     simple handle
          *
          * @return     void
          */
-        auto add(b_handle &h) { _available_handles.push(std::addressof(h)); }
+        auto add(b_handle &h) {
+            auto &n{static_cast<node &>(h)};
+            n.idle_since = clock_type::now();
+            push(std::addressof(n));
+        }
 
 
         /**
-         * @brief      Size of currently available handles.
+         * @brief      Destroys handles idle for longer than idle timeout, but
+         * keeps at least minimal number of handles. Scans free handles at most
+         * once per idle timeout.
          *
-         * @return     Size of currently available handles.
+         * @return     Number of destroyed handles
+         */
+        auto trim() -> size_t {
+            auto now{clock_type::now()};
+            if (now - _last_trim < _idle_timeout || _handles.size() <= _min) {
+                return 0;
+            }
+            _last_trim = now;
+            auto n{_free.exchange(nullptr, std::memory_order_acquire)};
+            auto removable{_handles.size() - _min};
+            size_t trimmed{0};
+            while (n) {
+                auto next{n->next};
+                _available.fetch_sub(1, std::memory_order_relaxed);
+                if (trimmed < removable &&
+                    now - n->idle_since >= _idle_timeout) {
+                    n->trimmed = true;
+                    ++trimmed;
+                } else {
+                    push(n);
+                }
+                n = next;
+            }
+            std::erase_if(_handles, [](auto &h) { return h->trimmed; });
+            return trimmed;
+        }
+
+
+        /**
+         * @brief      Number of handles which can be acquired right now (free
+         * ones and those which can still be created).
+         *
+         * @return     Number of available handles.
+         */
+        auto size() const {
+            return _available.load(std::memory_order_relaxed) + _max -
+                   _handles.size();
+        }
+
+
+        /**
+         * @brief      Number of existing handles (free and in use).
+         */
+        auto allocated() const { return _handles.size(); }
+
+
+        /**
+         * @brief      Number of handles taken by get() and not added back.
          */
-        auto size() const { return _available_handles.size(); }
+        auto in_use() const {
+            return _handles.size() - _available.load(std::memory_order_relaxed);
+        }
     };
 
 
     /**
-     * @brief      This is a simple app which initializes curl. IMPORTANT!
-     * THERE CAN BE ONLY ONE INSTANCE OF THIS CLASS IN A PROGRAM.
-     *
-     * @tparam     CRTP  The underlying application.
+     * @brief      Reference counted curl global initialization. The first
+     * instance initializes curl, the last one cleans it up. Instances can be
+     * created and destroyed from many threads (e.g. notifier shards).
      */
-    template <typename CRTP>
-    class app {
+    class curl_global {
+      private:
+        static inline std::mutex _mutex{};
+        static inline size_t _instances{0};
+
       public:
         /**
          * @brief      Constructs a new instance.
          */
-        app() {
-            if (!status<ffor::single>{curl_global_init(CURL_GLOBAL_ALL)}) {
+        curl_global() {
+            std::scoped_lock lock{_mutex};
+            if (_instances == 0 &&
+                !status<ffor::single>{curl_global_init(CURL_GLOBAL_ALL)}) {
                 throw std::runtime_error("app could not initialize curl");
-            };
+            }
+            ++_instances;
         }
 
 
+        curl_global(const curl_global &) = delete;
+        curl_global &operator=(const curl_global &) = delete;
+
+
         /**
          * @brief      Destroys the object.
          */
-        ~app() noexcept { curl_global_cleanup(); }
+        ~curl_global() noexcept {
+            std::scoped_lock lock{_mutex};
+            if (--_instances == 0) { curl_global_cleanup(); }
+        }
+    };
+
+
+    /**
+     * @brief      This is a simple app which initializes curl. Many instances
+     * (also in different threads) may exist, curl is initialized once.
+     *
+     * @tparam     CRTP  The underlying application.
+     */
+    template <typename CRTP>
+    class app {
+      private:
+        curl_global _global{};
 
       public:
         /**
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <json_fields.hpp>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Suppression of repeated requests. A request is suppressed
+     * if an equal one (or one with an equal key) was accepted less than
+     * window ago. The window is counted from the accepted request, thus a
+     * request repeated without pause is sent once per window.
+     */
+    struct dedup_options {
+        /*0 means requests are never suppressed*/
+        std::chrono::milliseconds window{0};
+        /*number of remembered requests (rounded up to a power of 2)*/
+        size_t capacity{64 * 1024};
+        /*name of the JSON field compared instead of the whole request (empty
+         * means the whole request)*/
+        std::string key{};
+    };
+
+
+    /**
+     * @brief      Remembers hashes of recently accepted requests in a fixed
+     * open addressing table. A hash is looked up in a short run of adjacent
+     * slots (a few cache lines), and a slot whose window ended is reused.
+     * If every slot of the run is still in its window, the one closest to
+     * its end is evicted, so the table never grows (and an evicted request
+     * may pass again). Hashes are not verified against the requests, two
+     * requests with a colliding 64 bit hash count as equal.
+     */
+    class deduplicator {
+      public:
+        using clock_type = std::chrono::steady_clock;
+
+      private:
+        /*slots searched for a single hash (4 slots per cache line)*/
+        static constexpr size_t probe_length{8};
+
+        /**
+         * @brief      Remembered request (hash 0 means the slot is empty).
+         */
+        struct slot {
+            uint64_t hash{0};
+            /*end of the window in clock ticks*/
+            int64_t expires{0};
+        };
+
+      private:
+        std::chrono::nanoseconds _window{};
+        std::string _key{};
+        size_t _mask{0};
+        std::unique_ptr<slot[]> _slots{};
+
+      private:
+        /**
+         * @brief      Folds the 128 bit product of a and b into 64 bits.
+         */
+        static auto mix(uint64_t a, uint64_t b) -> uint64_t {
+            auto product{static_cast<unsigned __int128>(a) * b};
+            return static_cast<uint64_t>(product) ^
+                   static_cast<uint64_t>(product >> 64);
+        }
+
+
+        /**
+         * @brief      Reads 8 bytes (little endian order is not required,
+         * the hash is only compared within the process).
+         */
+        static auto read64(const char *p) -> uint64_t {
+            uint64_t v{};
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+      public:
+        /**
+         * @brief      Fast non-cryptographic hash, 16 bytes per multiplication
+         * (in the style of wyhash).
+         *
+         * @param[in]  data  The data
+         *
+         * @return     The hash
+         */
+        static auto hash(std::string_view data) -> uint64_t {
+            constexpr uint64_t s0{0xa0761d6478bd642f};
+            constexpr uint64_t s1{0xe7037ed1a0b428db};
+            constexpr uint64_t s2{0x8ebc6af09c88c6e3};
+            auto p{data.data()};
+            auto n{data.size()};
+            uint64_t seed{mix(s0 ^ n, s1)};
+            for (; n > 16; n -= 16, p += 16) {
+                seed = mix(read64(p) ^ s1, read64(p + 8) ^ seed);
+            }
+            uint64_t a{0};
+            uint64_t b{0};
+            if (n >= 8) {
+                a = read64(p);
+                b = read64(p + n - 8);
+            } else if (n > 0) {
+                /*short tails are read byte by byte (and by 4 bytes)*/
+                a = (uint64_t{static_cast<uint8_t>(p[0])} << 16) |
+                    (uint64_t{static_cast<uint8_t>(p[n / 2])} << 8) |
+                    uint64_t{static_cast<uint8_t>(p[n - 1])};
+                if (n >= 4) {
+                    uint32_t head{};
+                    uint32_t tail{};
+                    std::memcpy(&head, p, sizeof(head));
+                    std::memcpy(&tail, p + n - 4, sizeof(tail));
+                    b = (uint64_t{head} << 32) | tail;
+                }
+            }
+            return mix(s2 ^ data.size(), mix(a ^ s1, b ^ seed));
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The options
+         */
+        explicit deduplicator(const dedup_options &options)
+            : _window{options.window},
+              _key{options.key},
+              _mask{std::bit_ceil(std::max(options.capacity, probe_length)) -
+                    1},
+              _slots{std::make_unique<slot[]>(_mask + 1)} {}
+
+      public:
+        /**
+         * @brief      Remembers a request unless an equal one was accepted
+         * within the window. Requests without the key field are never
+         * suppressed.
+         *
+         * @param[in]  req   The request
+         * @param[in]  now   The current time
+         *
+         * @return     True iff the request should be suppressed
+         */
+        auto duplicate(std::string_view req,
+                       clock_type::time_point now = clock_type::now())
+            -> bool {
+            if (!_key.empty()) {
+                req = json_fields::find(req, _key);
+                if (req.empty()) { return false; }
+            }
+            auto h{std::max(hash(req), uint64_t{1})};
+            auto ticks{now.time_since_epoch().count()};
+            /*slots whose window ended (or empty ones) expire first*/
+            auto victim{&_slots[h & _mask]};
+            for (size_t i{0}; i < probe_length; ++i) {
+                auto &s{_slots[(h + i) & _mask]};
+                if (s.hash == h && s.expires > ticks) { return true; }
+                if (s.expires < victim->expires) { victim = &s; }
+            }
+            victim->hash = h;
+            victim->expires =
+                ticks + std::chrono::duration_cast<clock_type::duration>(
+                            _window)
+                            .count();
+            return false;
+        }
+    };
+
+
+}  // namespace cppurl
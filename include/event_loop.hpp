@@ -0,0 +1,236 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cppurl.hpp>
+#include <cstdint>
+#include <expected>
+#include <system_error>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Event driven engine for handle<ffor::multi>. Sockets reported
+     * by curl are watched with epoll and curl timeouts are armed on a
+     * timerfd, thus curl_multi_socket_action is called only when something
+     * actually happened (no fixed polling interval).
+     */
+    class event_loop {
+      private:
+        using error = status<ffor::multi>;
+
+      private:
+        static constexpr int max_events{256};
+
+      private:
+        nb_handle &_mhandle;
+        int _epoll_fd{epoll_create1(EPOLL_CLOEXEC)};
+        int _timer_fd{timerfd_create(CLOCK_MONOTONIC,
+                                     TFD_NONBLOCK | TFD_CLOEXEC)};
+        std::vector<int> _extra_fds{};
+        std::array<epoll_event, max_events> _events{};
+        int _running_handles{0};
+
+      private:
+        /**
+         * @brief      Curl socket function. Registers, modifies or removes
+         * socket from epoll.
+         *
+         * @param      easy     The easy handle (unused)
+         * @param[in]  s        The socket
+         * @param[in]  what     CURL_POLL_* flags
+         * @param      userp    This event loop
+         * @param      socketp  Non null iff socket is already registered
+         *
+         * @return     0 on success, -1 otherwise
+         */
+        static int _socket(
+            CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
+            auto &self{*static_cast<event_loop *>(userp)};
+            if (what == CURL_POLL_REMOVE) {
+                epoll_ctl(self._epoll_fd, EPOLL_CTL_DEL, s, nullptr);
+                return 0;
+            }
+            epoll_event ev{};
+            ev.events = ((what & CURL_POLL_IN) ? EPOLLIN : 0u) |
+                        ((what & CURL_POLL_OUT) ? EPOLLOUT : 0u);
+            ev.data.fd = s;
+            auto op{socketp ? EPOLL_CTL_MOD : EPOLL_CTL_ADD};
+            if (epoll_ctl(self._epoll_fd, op, s, &ev) == -1) { return -1; }
+            if (!socketp && !self._mhandle.assign(s, &self)) { return -1; }
+            return 0;
+        }
+
+
+        /**
+         * @brief      Curl timer function. Arms (or disarms) the timerfd.
+         *
+         * @param      multi       The multi handle (unused)
+         * @param[in]  timeout_ms  The timeout in milliseconds, -1 disarms
+         * @param      userp       This event loop
+         *
+         * @return     0 on success, -1 otherwise
+         */
+        static int _timer(CURLM *multi, long timeout_ms, void *userp) {
+            auto &self{*static_cast<event_loop *>(userp)};
+            itimerspec spec{};
+            if (timeout_ms > 0) {
+                spec.it_value.tv_sec = timeout_ms / 1000;
+                spec.it_value.tv_nsec = (timeout_ms % 1000) * 1'000'000;
+            } else if (timeout_ms == 0) {
+                /*zero would disarm the timer, so expire as soon as possible*/
+                spec.it_value.tv_nsec = 1;
+            }
+            return timerfd_settime(self._timer_fd, 0, &spec, nullptr) == -1
+                       ? -1
+                       : 0;
+        }
+
+
+        /**
+         * @brief      Translates epoll events into curl event bitmask.
+         *
+         * @param[in]  events  epoll events
+         *
+         * @return     CURL_CSELECT_* bitmask
+         */
+        static int _to_curl_events(uint32_t events) {
+            return ((events & EPOLLIN) ? CURL_CSELECT_IN : 0) |
+                   ((events & EPOLLOUT) ? CURL_CSELECT_OUT : 0) |
+                   ((events & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0);
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance and installs socket and timer
+         * functions on the multi handle.
+         *
+         * @param      mhandle  The multi handle driven by this loop
+         */
+        explicit event_loop(nb_handle &mhandle) : _mhandle{mhandle} {
+            if (_epoll_fd == -1 || _timer_fd == -1) {
+                throw std::system_error{
+                    errno,
+                    std::generic_category(),
+                    "event loop could not create epoll or timer descriptor"};
+            }
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = _timer_fd;
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _timer_fd, &ev) == -1) {
+                throw std::system_error{errno,
+                                        std::generic_category(),
+                                        "event loop could not watch timer"};
+            }
+            if (!_mhandle.socket_function(_socket, this) ||
+                !_mhandle.timer_function(_timer, this)) {
+                throw std::runtime_error(
+                    "event loop could not set socket or timer function");
+            }
+        }
+
+
+        event_loop(const event_loop &) = delete;
+        event_loop &operator=(const event_loop &) = delete;
+
+
+        /**
+         * @brief      Destroys the object. Callbacks are uninstalled first,
+         * since the multi handle may outlive this loop.
+         */
+        ~event_loop() noexcept {
+            _mhandle.socket_function(nullptr, nullptr);
+            _mhandle.timer_function(nullptr, nullptr);
+            if (_timer_fd != -1) { close(_timer_fd); }
+            if (_epoll_fd != -1) { close(_epoll_fd); }
+        }
+
+      public:
+        /**
+         * @brief      Starts watching an additional file descriptor for
+         * readability (e.g. stdin). Its readiness only wakes the loop up.
+         *
+         * @param[in]  fd    The file descriptor
+         *
+         * @return     True if fd is watched, false if it does not support
+         * polling (e.g. regular files), CURLM_INTERNAL_ERROR if epoll failed
+         */
+        auto watch(int fd) -> std::expected<bool, error> {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+                if (errno == EPERM) { return false; }
+                return std::unexpected{error{CURLM_INTERNAL_ERROR}};
+            }
+            _extra_fds.push_back(fd);
+            return true;
+        }
+
+
+        /**
+         * @brief      Stops watching an additional file descriptor.
+         *
+         * @param[in]  fd    The file descriptor
+         *
+         * @return     void
+         */
+        auto unwatch(int fd) {
+            epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+            std::erase(_extra_fds, fd);
+        }
+
+
+        /**
+         * @brief      Waits for socket, timer or additional fd events and
+         * performs corresponding socket actions.
+         *
+         * @param[in]  timeout_ms  The timeout milliseconds (-1 is infinity)
+         *
+         * @return     number of events or error (CURLM_INTERNAL_ERROR if epoll
+         * failed)
+         */
+        auto wait(int timeout_ms) -> std::expected<int, error> {
+            auto n{epoll_wait(
+                _epoll_fd, _events.data(), max_events, timeout_ms)};
+            if (n == -1) {
+                if (errno == EINTR) { return 0; }
+                return std::unexpected{error{CURLM_INTERNAL_ERROR}};
+            }
+            for (auto &ev : std::span{_events.data(), static_cast<size_t>(n)}) {
+                std::expected<int, error> running{_running_handles};
+                if (ev.data.fd == _timer_fd) {
+                    uint64_t expirations{};
+                    [[maybe_unused]] auto _{
+                        ::read(_timer_fd, &expirations, sizeof(expirations))};
+                    running = _mhandle.socket_action(CURL_SOCKET_TIMEOUT, 0);
+                } else if (std::ranges::find(_extra_fds, ev.data.fd) ==
+                           _extra_fds.end()) {
+                    running = _mhandle.socket_action(
+                        ev.data.fd, _to_curl_events(ev.events));
+                }
+                UNEXP_FORWARD_UNEXPECTED(running);
+                _running_handles = *running;
+            }
+            return n;
+        }
+
+
+        /**
+         * @brief      Number of still running transfers after last action.
+         *
+         * @return     Number of still running transfers
+         */
+        auto running_handles() const { return _running_handles; }
+    };
+
+
+}  // namespace cppurl
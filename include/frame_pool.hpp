@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Allocator of coroutine frames. Frames are rounded up to
+     * size classes of 64 bytes and kept on a free list of their class once
+     * destroyed, so that a steady stream of coroutines of the same few types
+     * does not allocate. Memory is carved from chunks and never given back
+     * before the pool is destroyed. Frames larger than the largest class go
+     * to operator new. Not thread safe, use local() of the thread running
+     * the coroutines.
+     */
+    class frame_pool {
+      private:
+        static constexpr size_t granularity{64};
+        static constexpr size_t max_pooled_size{4096};
+        static constexpr size_t chunk_size{64 * 1024};
+
+
+        struct free_block {
+            free_block *next{nullptr};
+        };
+
+      private:
+        std::array<free_block *, max_pooled_size / granularity> _free{};
+        std::vector<std::unique_ptr<std::byte[]>> _chunks{};
+        std::byte *_cursor{nullptr};
+        size_t _left{0};
+
+      private:
+        static constexpr auto size_class(size_t size) -> size_t {
+            return (size + granularity - 1) / granularity - 1;
+        }
+
+      public:
+        frame_pool() = default;
+        frame_pool(const frame_pool &) = delete;
+        frame_pool &operator=(const frame_pool &) = delete;
+
+      public:
+        /**
+         * @brief      Allocates a frame.
+         *
+         * @param[in]  size  The size
+         *
+         * @return     The memory
+         */
+        auto allocate(size_t size) -> void * {
+            if (size > max_pooled_size) { return ::operator new(size); }
+            auto &head{_free[size_class(size)]};
+            if (head) {
+                auto block{head};
+                head = block->next;
+                return block;
+            }
+            auto rounded{(size_class(size) + 1) * granularity};
+            if (_left < rounded) {
+                _chunks.push_back(std::make_unique<std::byte[]>(chunk_size));
+                _cursor = _chunks.back().get();
+                _left = chunk_size;
+            }
+            auto block{_cursor};
+            _cursor += rounded;
+            _left -= rounded;
+            return block;
+        }
+
+
+        /**
+         * @brief      Gives a frame back to the pool.
+         *
+         * @param      p     The memory returned by allocate(size)
+         * @param[in]  size  The size
+         *
+         * @return     void
+         */
+        auto deallocate(void *p, size_t size) {
+            if (size > max_pooled_size) {
+                ::operator delete(p);
+                return;
+            }
+            auto block{::new (p) free_block{_free[size_class(size)]}};
+            _free[size_class(size)] = block;
+        }
+
+
+        /**
+         * @brief      Pool of the calling thread. Frames must be destroyed
+         * by the thread which created them, before it exits.
+         */
+        static auto local() -> frame_pool & {
+            thread_local frame_pool pool{};
+            return pool;
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Values of named JSON fields of a request, e.g. the key of
+     * the deduplicator or the placeholders of header templates. A field is
+     * found by its quoted name followed by ':' without parsing the body, so
+     * the first occurrence is taken whether it is top-level or nested. The
+     * values of all names are extracted at once and are views into the body
+     * (valid until the next extract).
+     */
+    class json_fields {
+      private:
+        std::vector<std::string> _names{};
+        std::vector<std::string_view> _values{};
+
+      public:
+        /**
+         * @brief      Value of a top-level or nested JSON field "name" (the
+         * first occurrence). A string value is returned without quotes,
+         * other values up to the next ',', '}' or ']'.
+         *
+         * @param[in]  body  The request
+         * @param[in]  name  Name of the field
+         *
+         * @return     The value (std::string_view{} if the field is missing)
+         */
+        static auto find(std::string_view body, std::string_view name)
+            -> std::string_view {
+            for (size_t at{body.find(name)}; at != body.npos;
+                 at = body.find(name, at + 1)) {
+                auto end{at + name.size()};
+                if (at == 0 || body[at - 1] != '"' || end >= body.size() ||
+                    body[end] != '"') {
+                    continue;
+                }
+                auto colon{body.find_first_not_of(" \t", end + 1)};
+                if (colon == body.npos || body[colon] != ':') { continue; }
+                auto value{body.find_first_not_of(" \t", colon + 1)};
+                if (value == body.npos) { return {}; }
+                if (body[value] == '"') {
+                    auto close{value + 1};
+                    while (close < body.size() && body[close] != '"') {
+                        close += body[close] == '\\' ? 2 : 1;
+                    }
+                    return body.substr(value + 1,
+                                       std::min(close, body.size()) - value -
+                                           1);
+                }
+                auto close{body.find_first_of(",}] \t", value)};
+                return body.substr(value,
+                                   close == body.npos ? body.npos
+                                                      : close - value);
+            }
+            return {};
+        }
+
+      public:
+        /**
+         * @brief      Adds a field to extract (names already added are
+         * ignored).
+         *
+         * @param[in]  name  Name of the field
+         *
+         * @return     void
+         */
+        auto add(std::string_view name) {
+            if (std::ranges::find(_names, name) == _names.end()) {
+                _names.emplace_back(name);
+            }
+        }
+
+
+        /**
+         * @brief      Extracts the values of all added fields of a body. The
+         * body must outlive them.
+         *
+         * @param[in]  body  The body
+         *
+         * @return     void
+         */
+        auto extract(std::string_view body) {
+            _values.clear();
+            for (auto &name : _names) { _values.push_back(find(body, name)); }
+        }
+
+
+        /**
+         * @brief      Extracted value of a field (empty if it is missing or
+         * was not added).
+         */
+        auto value(std::string_view name) const -> std::string_view {
+            auto found{std::ranges::find(_names, name)};
+            auto i{static_cast<size_t>(found - _names.begin())};
+            return i < _values.size() ? _values[i] : std::string_view{};
+        }
+
+
+        /**
+         * @brief      True iff some extracted value contains one of chars,
+         * e.g. CR or LF which would end a rendered header.
+         */
+        auto contain(std::string_view chars) const -> bool {
+            return std::ranges::any_of(_values, [&](auto v) {
+                return v.find_first_of(chars) != std::string_view::npos;
+            });
+        }
+
+
+        /**
+         * @brief      True iff no field was added.
+         */
+        auto empty() const -> bool { return _names.empty(); }
+    };
+
+
+}  // namespace cppurl
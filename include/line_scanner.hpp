@@ -0,0 +1,243 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPPURL_X86 1
+#endif
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Instruction set used to look for newlines.
+     */
+    enum class simd { scalar, sse2, avx2 };
+
+
+    /**
+     * @brief      Splits a buffer into newline terminated lines without
+     * copying. Blocks of 64 bytes are compared with '\n' by 16 (SSE2) or 32
+     * (AVX2) bytes at once and every newline of a block is taken from the
+     * resulting bit mask, so short lines cost a few instructions each, while
+     * the ends of long lines are found by memchr. The instruction set is
+     * chosen once at runtime, a scalar loop is used where neither is
+     * available.
+     */
+    class line_scanner {
+      private:
+        /*bytes compared per iteration (with a single bit mask)*/
+        static constexpr size_t block_size{64};
+        /*consecutive blocks without newline after which the rest of a line
+         * is left to memchr*/
+        static constexpr size_t long_line_blocks{4};
+
+      private:
+        /**
+         * @brief      Reports the lines ending in a block.
+         *
+         * @param[in]  mask     Bit i is set iff byte offset + i is '\n'
+         * @param[in]  offset   Offset of the block
+         * @param[in]  data     The buffer
+         * @param      start    Start of the current line
+         * @param      on_line  Function called for every line
+         *
+         * @return     void
+         */
+        static auto emit(uint64_t mask,
+                         size_t offset,
+                         std::string_view data,
+                         size_t &start,
+                         auto &&on_line) {
+            while (mask != 0) {
+                auto end{offset + static_cast<size_t>(std::countr_zero(mask))};
+                on_line(data.substr(start, end - start));
+                start = end + 1;
+                mask &= mask - 1;
+            }
+        }
+
+
+        /**
+         * @brief      Reports the lines ending in data[from..], byte by byte.
+         *
+         * @return     Start of the unterminated tail
+         */
+        static auto split_scalar(std::string_view data,
+                                 size_t from,
+                                 size_t start,
+                                 auto &&on_line) -> size_t {
+            for (auto i{from}; i < data.size(); ++i) {
+                if (data[i] == '\n') {
+                    on_line(data.substr(start, i - start));
+                    start = i + 1;
+                }
+            }
+            return start;
+        }
+
+        /**
+         * @brief      Finds the end of a long line (memchr is faster than
+         * masks over blocks without newlines).
+         *
+         * @param[in]  data  The buffer
+         * @param[in]  at    Offset of a block without newline
+         *
+         * @return     Offset of the next newline (data.size() if none)
+         */
+        static auto skip(std::string_view data, size_t at) -> size_t {
+            return std::min(data.find('\n', at + block_size), data.size());
+        }
+
+#ifdef CPPURL_X86
+        /**
+         * @brief      Bit mask of the newlines among 64 bytes at p.
+         */
+        [[gnu::target("sse2")]] static auto mask_sse2(const char *p)
+            -> uint64_t {
+            auto newline{_mm_set1_epi8('\n')};
+            uint64_t mask{0};
+            for (size_t i{0}; i < block_size; i += 16) {
+                auto block{
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i))};
+                mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                            _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline))))
+                        << i;
+            }
+            return mask;
+        }
+
+
+        /**
+         * @brief      Bit mask of the newlines among 64 bytes at p.
+         */
+        [[gnu::target("avx2")]] static auto mask_avx2(const char *p)
+            -> uint64_t {
+            auto newline{_mm256_set1_epi8('\n')};
+            uint64_t mask{0};
+            for (size_t i{0}; i < block_size; i += 32) {
+                auto block{_mm256_loadu_si256(
+                    reinterpret_cast<const __m256i *>(p + i))};
+                auto found{_mm256_cmpeq_epi8(block, newline)};
+                mask |= static_cast<uint64_t>(static_cast<uint32_t>(
+                            _mm256_movemask_epi8(found)))
+                        << i;
+            }
+            return mask;
+        }
+
+
+        [[gnu::target("sse2")]] static auto split_sse2(std::string_view data,
+                                                       auto &&on_line)
+            -> size_t {
+            size_t start{0};
+            size_t i{0};
+            size_t empty{0};
+            while (i + block_size <= data.size()) {
+                auto mask{mask_sse2(data.data() + i)};
+                if (mask == 0 && ++empty == long_line_blocks) {
+                    i = skip(data, i);
+                    empty = 0;
+                    continue;
+                }
+                if (mask != 0) {
+                    emit(mask, i, data, start, on_line);
+                    empty = 0;
+                }
+                i += block_size;
+            }
+            return split_scalar(data, i, start, on_line);
+        }
+
+
+        [[gnu::target("avx2")]] static auto split_avx2(std::string_view data,
+                                                       auto &&on_line)
+            -> size_t {
+            size_t start{0};
+            size_t i{0};
+            size_t empty{0};
+            while (i + block_size <= data.size()) {
+                auto mask{mask_avx2(data.data() + i)};
+                if (mask == 0 && ++empty == long_line_blocks) {
+                    i = skip(data, i);
+                    empty = 0;
+                    continue;
+                }
+                if (mask != 0) {
+                    emit(mask, i, data, start, on_line);
+                    empty = 0;
+                }
+                i += block_size;
+            }
+            return split_scalar(data, i, start, on_line);
+        }
+#endif
+
+      public:
+        /**
+         * @brief      The best instruction set supported by this cpu.
+         */
+        static auto best() -> simd {
+#ifdef CPPURL_X86
+            static const auto chosen{__builtin_cpu_supports("avx2") ? simd::avx2
+                                     : __builtin_cpu_supports("sse2")
+                                         ? simd::sse2
+                                         : simd::scalar};
+            return chosen;
+#else
+            return simd::scalar;
+#endif
+        }
+
+
+        /**
+         * @brief      Name of an instruction set.
+         */
+        static auto name(simd s) -> std::string_view {
+            switch (s) {
+                case simd::avx2:
+                    return "avx2";
+                case simd::sse2:
+                    return "sse2";
+                default:
+                    return "scalar";
+            }
+        }
+
+
+        /**
+         * @brief      Calls on_line for every complete line of data (without
+         * its '\n').
+         *
+         * @param[in]  data     The buffer
+         * @param      on_line  Function of the form [](std::string_view line)
+         * called for every complete line, the view points into data
+         * @param[in]  s        The instruction set (it must be supported)
+         *
+         * @return     Offset of the unterminated tail of data (data.size() if
+         * data ends with '\n')
+         */
+        static auto split(std::string_view data,
+                          auto &&on_line,
+                          simd s = best()) -> size_t {
+#ifdef CPPURL_X86
+            switch (s) {
+                case simd::avx2:
+                    return split_avx2(data, on_line);
+                case simd::sse2:
+                    return split_sse2(data, on_line);
+                default:
+                    break;
+            }
+#endif
+            return split_scalar(data, 0, 0, on_line);
+        }
+    };
+
+
+}  // namespace cppurl
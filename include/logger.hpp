@@ -0,0 +1,353 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Severity of log records (records below the configured level
+     * are discarded).
+     */
+    enum class log_level : uint8_t { debug, info, warning, error, off };
+
+
+    /**
+     * @brief      Settings of the logger.
+     */
+    struct logger_options {
+        log_level level{log_level::info};
+        /*entries below warning are sampled, 1 of every sample_every entries
+         * of a thread is kept (see logger::sample)*/
+        size_t sample_every{1};
+        /*records per thread (rounded up to a power of two), once the ring of
+         * a thread is full its new records are dropped and counted*/
+        size_t ring_capacity{4096};
+        std::chrono::milliseconds flush_interval{100};
+        int fd{STDOUT_FILENO};
+    };
+
+
+    /**
+     * @brief      Asynchronous logger. Producers copy fixed-size binary
+     * records into a ring of their own (single producer, single consumer, no
+     * locks after the first record of a thread), a background thread formats
+     * the records of all rings and writes them with a single write every
+     * flush interval. Thus terminal or disk I/O never blocks a transfer loop,
+     * at worst records are dropped.
+     */
+    class logger {
+      public:
+        /**
+         * @brief      Kinds of records, formatted by the background thread.
+         */
+        enum class event : uint8_t {
+            /*first: the text*/
+            message,
+            /*first: url, number: items*/
+            transfer_succeeded,
+            /*first: url, second: reason, number: items*/
+            transfer_failed,
+            /*first: body, number: http code*/
+            response
+        };
+
+      private:
+        struct record {
+            static constexpr size_t text_capacity{480};
+            event kind{};
+            uint16_t first_size{};
+            uint16_t second_size{};
+            int64_t number{};
+            char text[text_capacity];
+        };
+
+
+        /**
+         * @brief      Ring of records of a single thread.
+         */
+        struct ring {
+            std::thread::id owner{};
+            std::unique_ptr<record[]> records{};
+            size_t mask{};
+            /*producer only, counts entries subject to sampling*/
+            size_t sampled{0};
+            alignas(64) std::atomic<size_t> head{0};
+            alignas(64) std::atomic<size_t> tail{0};
+
+            ring(std::thread::id owner, size_t capacity)
+                : owner{owner},
+                  records{std::make_unique<record[]>(capacity)},
+                  mask{capacity - 1} {}
+        };
+
+      private:
+        static inline std::atomic<uint64_t> next_id{0};
+
+      private:
+        logger_options _options{};
+        const uint64_t _id{next_id.fetch_add(1, std::memory_order_relaxed)};
+        std::mutex _rings_mutex{};
+        std::vector<std::unique_ptr<ring>> _rings{};
+        std::atomic<uint64_t> _dropped{0};
+        uint64_t _reported_dropped{0};
+        /*serializes consumers (the thread and flush())*/
+        std::mutex _drain_mutex{};
+        std::string _buffer{};
+        std::mutex _wait_mutex{};
+        std::condition_variable _wake{};
+        bool _stop{false};
+        std::thread _thread{};
+
+      private:
+        /**
+         * @brief      Ring of the calling thread (registered on its first
+         * record).
+         */
+        auto local_ring() -> ring & {
+            thread_local struct {
+                uint64_t owner{UINT64_MAX};
+                ring *r{nullptr};
+            } cache{};
+            if (cache.owner == _id) { return *cache.r; }
+            std::scoped_lock lock{_rings_mutex};
+            auto id{std::this_thread::get_id()};
+            auto it{std::ranges::find_if(
+                _rings, [&](const auto &r) { return r->owner == id; })};
+            if (it == _rings.end()) {
+                _rings.push_back(
+                    std::make_unique<ring>(id, _options.ring_capacity));
+                it = std::prev(_rings.end());
+            }
+            cache = {_id, it->get()};
+            return **it;
+        }
+
+
+        /**
+         * @brief      Appends a formatted record to the output buffer.
+         */
+        auto format(const record &r) {
+            std::string_view first{r.text, r.first_size};
+            std::string_view second{r.text + r.first_size, r.second_size};
+            auto out{std::back_inserter(_buffer)};
+            switch (r.kind) {
+                case event::transfer_succeeded:
+                    std::format_to(out,
+                                   "\n///\nHandle for {} ({} requests) has "
+                                   "completed successfully\n///\n",
+                                   first,
+                                   r.number);
+                    break;
+                case event::transfer_failed:
+                    std::format_to(out,
+                                   "\n///\nHandle for {} ({} requests) has "
+                                   "failed. Reason: {}\n///\n",
+                                   first,
+                                   r.number,
+                                   second);
+                    break;
+                case event::response:
+                    std::format_to(out, "Response {}: {}\n", r.number, first);
+                    break;
+                default:
+                    _buffer.append(first);
+                    break;
+            }
+        }
+
+
+        /**
+         * @brief      Formats the records of all rings and writes them.
+         *
+         * @return     void
+         */
+        auto drain() {
+            std::scoped_lock drain_lock{_drain_mutex};
+            {
+                std::scoped_lock lock{_rings_mutex};
+                for (auto &r : _rings) {
+                    auto tail{r->tail.load(std::memory_order_relaxed)};
+                    auto head{r->head.load(std::memory_order_acquire)};
+                    for (; tail != head; ++tail) {
+                        format(r->records[tail & r->mask]);
+                    }
+                    r->tail.store(tail, std::memory_order_release);
+                }
+            }
+            auto dropped{_dropped.load(std::memory_order_relaxed)};
+            if (dropped != _reported_dropped) {
+                std::format_to(std::back_inserter(_buffer),
+                               "{} log records were dropped (ring full)\n",
+                               dropped - _reported_dropped);
+                _reported_dropped = dropped;
+            }
+            std::string_view left{_buffer};
+            while (!left.empty()) {
+                auto n{::write(_options.fd, left.data(), left.size())};
+                if (n < 0 && errno == EINTR) { continue; }
+                if (n <= 0) { break; }
+                left.remove_prefix(static_cast<size_t>(n));
+            }
+            _buffer.clear();
+        }
+
+
+        /**
+         * @brief      Drains the rings every flush interval until stopped.
+         *
+         * @return     void
+         */
+        auto run() {
+            while (true) {
+                std::unique_lock lock{_wait_mutex};
+                auto stop{_wake.wait_for(
+                    lock, _options.flush_interval, [this] { return _stop; })};
+                lock.unlock();
+                drain();
+                if (stop) { break; }
+            }
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance and starts its thread.
+         *
+         * @param[in]  options  The options
+         */
+        explicit logger(logger_options options = {})
+            : _options{std::move(options)} {
+            _options.ring_capacity =
+                std::bit_ceil(std::max(_options.ring_capacity, size_t{1}));
+            _options.sample_every = std::max(_options.sample_every, size_t{1});
+            _thread = std::thread{[this] { run(); }};
+        }
+
+
+        logger(const logger &) = delete;
+        logger &operator=(const logger &) = delete;
+
+
+        /**
+         * @brief      Stops the thread after writing all pending records.
+         */
+        ~logger() noexcept {
+            {
+                std::scoped_lock lock{_wait_mutex};
+                _stop = true;
+            }
+            _wake.notify_one();
+            _thread.join();
+        }
+
+      public:
+        /**
+         * @brief      True iff records of the level are kept.
+         */
+        auto enabled(log_level level) const {
+            return level >= _options.level && level != log_level::off;
+        }
+
+
+        /**
+         * @brief      Decides whether the next entry (one or more related
+         * records) of the calling thread is logged. Levels below warning
+         * are sampled.
+         *
+         * @param[in]  level  The level of the entry
+         *
+         * @return     True iff the entry should be logged
+         */
+        auto sample(log_level level) -> bool {
+            if (!enabled(level)) { return false; }
+            if (level >= log_level::warning || _options.sample_every == 1) {
+                return true;
+            }
+            return local_ring().sampled++ % _options.sample_every == 0;
+        }
+
+
+        /**
+         * @brief      Copies a record to the ring of the calling thread (not
+         * sampled, see sample()). The text is truncated to the capacity of a
+         * record.
+         *
+         * @param[in]  level   The level
+         * @param[in]  kind    The kind
+         * @param[in]  number  Its number
+         * @param[in]  first   Its first text
+         * @param[in]  second  Its second text
+         *
+         * @return     void
+         */
+        auto log(log_level level,
+                 event kind,
+                 int64_t number,
+                 std::string_view first,
+                 std::string_view second = {}) {
+            if (!enabled(level)) { return; }
+            auto &r{local_ring()};
+            auto head{r.head.load(std::memory_order_relaxed)};
+            if (head - r.tail.load(std::memory_order_acquire) > r.mask) {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            auto &rec{r.records[head & r.mask]};
+            first = first.substr(0, record::text_capacity);
+            second = second.substr(0, record::text_capacity - first.size());
+            rec.kind = kind;
+            rec.number = number;
+            rec.first_size = static_cast<uint16_t>(first.size());
+            rec.second_size = static_cast<uint16_t>(second.size());
+            std::memcpy(rec.text, first.data(), first.size());
+            std::memcpy(rec.text + first.size(), second.data(), second.size());
+            r.head.store(head + 1, std::memory_order_release);
+        }
+
+
+        /**
+         * @brief      Logs a plain text.
+         *
+         * @return     void
+         */
+        auto message(log_level level, std::string_view text) {
+            log(level, event::message, 0, text);
+        }
+
+
+        /**
+         * @brief      Writes pending records now (on the calling thread).
+         *
+         * @return     void
+         */
+        auto flush() { drain(); }
+
+
+        /**
+         * @brief      Number of records dropped since a ring was full.
+         */
+        auto dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <string_view>
+#include <system_error>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Framing of requests in an input file.
+     */
+    enum class record_framing {
+        /*newline separated requests (empty lines are skipped)*/
+        lines,
+        /*every request is preceded by its size as a 32 bit little endian
+         * unsigned integer, so requests may contain newlines*/
+        length_prefixed
+    };
+
+
+    /**
+     * @brief      Requests read from a memory mapped file. The whole file is
+     * mapped read-only once (with sequential readahead), and requests are
+     * handed out as views into the mapping, so they are never copied. Views
+     * stay valid until the object is destroyed. Data appended to the file
+     * after it was mapped is not read.
+     */
+    class mapped_input {
+      private:
+        const char *_data{nullptr};
+        size_t _size{0};
+        /*offset of the next request*/
+        size_t _offset{0};
+        record_framing _framing{record_framing::lines};
+        /*the file ends in the middle of a length prefixed request*/
+        bool _truncated{false};
+
+      private:
+        /**
+         * @brief      Reads a 32 bit little endian size at p.
+         */
+        static auto read_size(const char *p) -> uint32_t {
+            uint32_t size{};
+            std::memcpy(&size, p, sizeof(size));
+            if constexpr (std::endian::native == std::endian::big) {
+                size = std::byteswap(size);
+            }
+            return size;
+        }
+
+
+        /**
+         * @brief      Takes the next request.
+         *
+         * @return     The request (empty one for an empty line) or
+         * std::string_view{} with eof() set
+         */
+        auto next() -> std::string_view {
+            auto rest{std::string_view{_data, _size}.substr(_offset)};
+            if (_framing == record_framing::lines) {
+                auto end{std::min(rest.find('\n'), rest.size())};
+                _offset += std::min(end + 1, rest.size());
+                return rest.substr(0, end);
+            }
+            if (rest.size() < sizeof(uint32_t) ||
+                rest.size() - sizeof(uint32_t) < read_size(rest.data())) {
+                _truncated = !rest.empty();
+                _offset = _size;
+                return {};
+            }
+            auto size{read_size(rest.data())};
+            _offset += sizeof(uint32_t) + size;
+            return rest.substr(sizeof(uint32_t), size);
+        }
+
+      public:
+        /**
+         * @brief      Maps a file.
+         *
+         * @param[in]  path     The file
+         * @param[in]  framing  The framing of its requests
+         */
+        explicit mapped_input(const std::filesystem::path &path,
+                              record_framing framing = record_framing::lines)
+            : _framing{framing} {
+            auto fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+            struct stat st{};
+            if (fd == -1 || ::fstat(fd, &st) == -1) {
+                auto e{errno};
+                if (fd != -1) { ::close(fd); }
+                throw std::system_error{
+                    e,
+                    std::generic_category(),
+                    std::format("could not open input {}", path.string())};
+            }
+            _size = static_cast<size_t>(st.st_size);
+            if (_size > 0) {
+                auto data{
+                    ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0)};
+                if (data == MAP_FAILED) {
+                    auto e{errno};
+                    ::close(fd);
+                    throw std::system_error{
+                        e,
+                        std::generic_category(),
+                        std::format("could not map input {}", path.string())};
+                }
+                /*pages are read ahead aggressively and may be dropped soon
+                 * after they were read*/
+                ::madvise(data, _size, MADV_SEQUENTIAL);
+                _data = static_cast<const char *>(data);
+            }
+            /*the mapping keeps the file*/
+            ::close(fd);
+        }
+
+
+        mapped_input(const mapped_input &) = delete;
+        mapped_input &operator=(const mapped_input &) = delete;
+
+
+        /**
+         * @brief      Destroys the object and unmaps the file.
+         */
+        ~mapped_input() noexcept {
+            if (_data) { ::munmap(const_cast<char *>(_data), _size); }
+        }
+
+      public:
+        /**
+         * @brief      Reads at most max requests. Empty requests are skipped.
+         * The end of every line is found by memchr (instead of
+         * line_scanner), so that reading stops exactly after max requests.
+         *
+         * @param[in]  max         Maximal number of requests
+         * @param      on_request  Function of the form [](std::string_view
+         * req) called for every request. The view points into the mapping.
+         *
+         * @return     Number of read requests
+         */
+        auto read(size_t max, auto &&on_request) -> size_t {
+            size_t read{0};
+            while (read < max && !eof()) {
+                auto req{next()};
+                if (req.empty()) { continue; }
+                on_request(req);
+                ++read;
+            }
+            return read;
+        }
+
+
+        /**
+         * @brief      True iff every request was read.
+         */
+        auto eof() const { return _offset >= _size; }
+
+
+        /**
+         * @brief      True iff the file ends in the middle of a length
+         * prefixed request (which is not read).
+         */
+        auto truncated() const { return _truncated; }
+
+
+        /**
+         * @brief      Size of the file.
+         */
+        auto size() const { return _size; }
+
+
+        /**
+         * @brief      Number of bytes read so far.
+         */
+        auto offset() const { return _offset; }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cppurl.hpp>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Histogram of durations with buckets of bounded relative
+     * width (as in HdrHistogram): values below 2^sub_bits microseconds are
+     * exact, every next power of two is split into 2^sub_bits buckets, so the
+     * error is below 1/2^sub_bits (~6%). Recording is lock free, thus many
+     * threads may record and read concurrently.
+     */
+    class latency_histogram {
+      private:
+        static constexpr unsigned sub_bits{4};
+        static constexpr uint64_t sub_count{uint64_t{1} << sub_bits};
+        /*values are capped at 2^magnitudes - 1 microseconds (~12 days)*/
+        static constexpr unsigned magnitudes{40};
+        static constexpr size_t bucket_count{
+            (magnitudes - sub_bits + 1) * sub_count};
+        static constexpr uint64_t max_value{(uint64_t{1} << magnitudes) - 1};
+
+      private:
+        std::array<std::atomic<uint64_t>, bucket_count> _buckets{};
+        std::atomic<uint64_t> _count{0};
+        std::atomic<uint64_t> _sum{0};
+
+      private:
+        /**
+         * @brief      Index of the bucket of a value.
+         */
+        static auto index(uint64_t value) -> size_t {
+            if (value < sub_count) { return value; }
+            auto shift{static_cast<unsigned>(std::bit_width(value)) - 1 -
+                       sub_bits};
+            return (shift + 1) * sub_count + (value >> shift) - sub_count;
+        }
+
+
+        /**
+         * @brief      Highest value of a bucket.
+         */
+        static auto highest(size_t index) -> uint64_t {
+            if (index < 2 * sub_count) { return index; }
+            auto shift{index / sub_count - 1};
+            return ((index % sub_count + sub_count + 1) << shift) - 1;
+        }
+
+      public:
+        /**
+         * @brief      Records a duration (negative ones count as 0).
+         *
+         * @param[in]  duration  The duration
+         *
+         * @return     void
+         */
+        auto record(std::chrono::microseconds duration) {
+            auto value{std::min(
+                static_cast<uint64_t>(std::max(duration.count(), int64_t{0})),
+                max_value)};
+            _buckets[index(value)].fetch_add(1, std::memory_order_relaxed);
+            _count.fetch_add(1, std::memory_order_relaxed);
+            _sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Value below which lies the given fraction of recorded
+         * durations (rounded up to the end of its bucket).
+         *
+         * @param[in]  q     The fraction (from 0 to 1)
+         *
+         * @return     The duration (0 if nothing was recorded)
+         */
+        auto quantile(double q) const -> std::chrono::microseconds {
+            auto count{_count.load(std::memory_order_relaxed)};
+            if (count == 0) { return {}; }
+            auto rank{std::max(
+                static_cast<uint64_t>(q * static_cast<double>(count) + 0.5),
+                uint64_t{1})};
+            uint64_t seen{0};
+            for (size_t i{0}; i < bucket_count; ++i) {
+                seen += _buckets[i].load(std::memory_order_relaxed);
+                if (seen >= rank) {
+                    return std::chrono::microseconds{highest(i)};
+                }
+            }
+            return std::chrono::microseconds{max_value};
+        }
+
+
+        /**
+         * @brief      Number of recorded durations.
+         */
+        auto count() const { return _count.load(std::memory_order_relaxed); }
+
+
+        /**
+         * @brief      Sum of recorded durations.
+         */
+        auto sum() const {
+            return std::chrono::microseconds{
+                _sum.load(std::memory_order_relaxed)};
+        }
+    };
+
+
+    /**
+     * @brief      Metrics of transfers shared by all notifiers of a process
+     * (every member is updated lock free). Rendered in Prometheus text format
+     * by prometheus().
+     */
+    class metrics {
+      private:
+        /*http codes are counted up to this one (greater ones count as 0)*/
+        static constexpr size_t max_http_code{599};
+        static constexpr std::array quantiles{0.5, 0.9, 0.99, 0.999};
+
+      private:
+        latency_histogram _end_to_end{};
+        latency_histogram _namelookup{};
+        latency_histogram _connect{};
+        latency_histogram _appconnect{};
+        latency_histogram _starttransfer{};
+        latency_histogram _total{};
+        std::atomic<uint64_t> _successes{0};
+        std::atomic<uint64_t> _failures{0};
+        std::atomic<uint64_t> _retries{0};
+        std::atomic<uint64_t> _bytes_sent{0};
+        std::atomic<uint64_t> _suppressed{0};
+        std::array<std::atomic<uint64_t>, max_http_code + 1> _http_codes{};
+        std::array<std::atomic<uint64_t>, CURL_LAST> _curl_codes{};
+        std::atomic<int64_t> _queued{0};
+        std::atomic<int64_t> _in_flight{0};
+
+      private:
+        /**
+         * @brief      Appends a histogram as a Prometheus summary (in
+         * seconds).
+         */
+        static auto summary(std::string &out,
+                            std::string_view name,
+                            std::string_view labels,
+                            const latency_histogram &h) {
+            auto seconds{[](std::chrono::microseconds d) {
+                return std::chrono::duration<double>{d}.count();
+            }};
+            auto separator{labels.empty() ? "" : ","};
+            for (auto q : quantiles) {
+                std::format_to(std::back_inserter(out),
+                               "{}{{{}{}quantile=\"{}\"}} {}\n",
+                               name,
+                               labels,
+                               separator,
+                               q,
+                               seconds(h.quantile(q)));
+            }
+            auto braces{labels.empty() ? std::string{}
+                                       : std::format("{{{}}}", labels)};
+            std::format_to(std::back_inserter(out),
+                           "{}_sum{} {}\n{}_count{} {}\n",
+                           name,
+                           braces,
+                           seconds(h.sum()),
+                           name,
+                           braces,
+                           h.count());
+        }
+
+      public:
+        /**
+         * @brief      Records a completed attempt of a transfer.
+         *
+         * @param[in]  timings  Its timings
+         * @param[in]  bytes    Size of its body
+         *
+         * @return     void
+         */
+        auto record_attempt(const transfer_timings &timings, size_t bytes) {
+            _namelookup.record(timings.namelookup);
+            _connect.record(timings.connect);
+            _appconnect.record(timings.appconnect);
+            _starttransfer.record(timings.starttransfer);
+            _total.record(timings.total);
+            _bytes_sent.fetch_add(bytes, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Records an attempt which is going to be retried.
+         *
+         * @return     void
+         */
+        auto record_retry() {
+            _retries.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Records a request suppressed as a repeated one.
+         *
+         * @return     void
+         */
+        auto record_suppressed() {
+            _suppressed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Records the outcome of a transfer after its last
+         * attempt.
+         *
+         * @param[in]  code           The curl result
+         * @param[in]  response_code  The http response code (0 if none)
+         * @param[in]  end_to_end     Time from enqueueing of the oldest
+         * packed request to completion
+         *
+         * @return     void
+         */
+        auto record_outcome(CURLcode code,
+                            long response_code,
+                            std::chrono::microseconds end_to_end) {
+            _end_to_end.record(end_to_end);
+            if (code == CURLE_OK) {
+                _successes.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                _failures.fetch_add(1, std::memory_order_relaxed);
+                _curl_codes[std::clamp<int>(code, 0, CURL_LAST - 1)].fetch_add(
+                    1, std::memory_order_relaxed);
+            }
+            auto http{response_code < 0 ||
+                              static_cast<size_t>(response_code) > max_http_code
+                          ? size_t{0}
+                          : static_cast<size_t>(response_code)};
+            _http_codes[http].fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Changes the number of queued requests.
+         *
+         * @param[in]  delta  The change
+         *
+         * @return     void
+         */
+        auto add_queued(int64_t delta) {
+            _queued.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Changes the number of transfers in flight.
+         *
+         * @param[in]  delta  The change
+         *
+         * @return     void
+         */
+        auto add_in_flight(int64_t delta) {
+            _in_flight.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Histogram of end-to-end latencies.
+         */
+        auto end_to_end() const -> const latency_histogram & {
+            return _end_to_end;
+        }
+
+
+        /**
+         * @brief      Histogram of total times of transfer attempts.
+         */
+        auto transfer_time() const -> const latency_histogram & {
+            return _total;
+        }
+
+
+        /**
+         * @brief      Renders all metrics in Prometheus text format.
+         *
+         * @return     The text
+         */
+        auto prometheus() const -> std::string {
+            std::string out{};
+            auto it{std::back_inserter(out)};
+            out += "# HELP notifier_end_to_end_seconds Time from reading of a "
+                   "request to completion of its transfer (retries "
+                   "included)\n# TYPE notifier_end_to_end_seconds summary\n";
+            summary(out, "notifier_end_to_end_seconds", "", _end_to_end);
+            out += "# HELP notifier_transfer_phase_seconds Time from start of "
+                   "a transfer attempt to the end of its phase\n# TYPE "
+                   "notifier_transfer_phase_seconds summary\n";
+            for (auto [phase, h] :
+                 {std::pair{"namelookup", &_namelookup},
+                  std::pair{"connect", &_connect},
+                  std::pair{"appconnect", &_appconnect},
+                  std::pair{"starttransfer", &_starttransfer},
+                  std::pair{"total", &_total}}) {
+                summary(out,
+                        "notifier_transfer_phase_seconds",
+                        std::format("phase=\"{}\"", phase),
+                        *h);
+            }
+            std::format_to(
+                it,
+                "# HELP notifier_transfers_total Transfers after their last "
+                "attempt\n# TYPE notifier_transfers_total counter\n"
+                "notifier_transfers_total{{result=\"success\"}} {}\n"
+                "notifier_transfers_total{{result=\"failure\"}} {}\n",
+                _successes.load(std::memory_order_relaxed),
+                _failures.load(std::memory_order_relaxed));
+            out += "# HELP notifier_responses_total Transfers after their last "
+                   "attempt by http code (0 means no response)\n# TYPE "
+                   "notifier_responses_total counter\n";
+            for (size_t i{0}; i < _http_codes.size(); ++i) {
+                if (auto n{_http_codes[i].load(std::memory_order_relaxed)}) {
+                    std::format_to(
+                        it,
+                        "notifier_responses_total{{code=\"{}\"}} {}\n",
+                        i,
+                        n);
+                }
+            }
+            out += "# HELP notifier_failures_total Failed transfers by curl "
+                   "error code\n# TYPE notifier_failures_total counter\n";
+            for (size_t i{0}; i < _curl_codes.size(); ++i) {
+                if (auto n{_curl_codes[i].load(std::memory_order_relaxed)}) {
+                    std::format_to(
+                        it,
+                        "notifier_failures_total{{curl_code=\"{}\"}} {}\n",
+                        i,
+                        n);
+                }
+            }
+            std::format_to(
+                it,
+                "# HELP notifier_retries_total Attempts scheduled for a retry\n"
+                "# TYPE notifier_retries_total counter\n"
+                "notifier_retries_total {}\n"
+                "# HELP notifier_sent_bytes_total Posted bytes (retries "
+                "included)\n# TYPE notifier_sent_bytes_total counter\n"
+                "notifier_sent_bytes_total {}\n"
+                "# HELP notifier_suppressed_duplicates_total Repeated "
+                "requests suppressed within the dedup window\n"
+                "# TYPE notifier_suppressed_duplicates_total counter\n"
+                "notifier_suppressed_duplicates_total {}\n"
+                "# HELP notifier_queued_requests Requests waiting for a "
+                "transfer\n# TYPE notifier_queued_requests gauge\n"
+                "notifier_queued_requests {}\n"
+                "# HELP notifier_in_flight_transfers Transfers in flight\n"
+                "# TYPE notifier_in_flight_transfers gauge\n"
+                "notifier_in_flight_transfers {}\n",
+                _retries.load(std::memory_order_relaxed),
+                _bytes_sent.load(std::memory_order_relaxed),
+                _suppressed.load(std::memory_order_relaxed),
+                _queued.load(std::memory_order_relaxed),
+                _in_flight.load(std::memory_order_relaxed));
+            return out;
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <metrics.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Destination of exported metrics.
+     */
+    struct metrics_export_options {
+        /*file rewritten every interval (e.g. for node_exporter's textfile
+         * collector) or "unix:PATH" of a socket answering every connection
+         * with the current metrics as an http/1.0 response*/
+        std::string path{};
+        std::chrono::milliseconds interval{10000};
+    };
+
+
+    /**
+     * @brief      Background thread exporting metrics in Prometheus text
+     * format. A file is replaced atomically (written aside and renamed), so
+     * readers never see a partial dump.
+     */
+    class metrics_exporter {
+      private:
+        static constexpr std::string_view unix_prefix{"unix:"};
+        /*time given to a client to send its request*/
+        static constexpr int request_wait_time{100};
+
+      private:
+        const metrics &_metrics;
+        metrics_export_options _options{};
+        std::string _socket_path{};
+        int _stop_fd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+        int _listen_fd{-1};
+        std::thread _thread{};
+
+      private:
+        /**
+         * @brief      Writes the metrics to the file.
+         *
+         * @return     void
+         */
+        auto dump() const {
+            auto tmp{_options.path + ".tmp"};
+            {
+                std::ofstream file{tmp, std::ios::trunc};
+                file << _metrics.prometheus();
+                if (!file) { return; }
+            }
+            std::error_code ignored{};
+            std::filesystem::rename(tmp, _options.path, ignored);
+        }
+
+
+        /**
+         * @brief      Answers a connected client with the metrics.
+         *
+         * @param[in]  fd    The connection
+         *
+         * @return     void
+         */
+        auto serve(int fd) const {
+            /*the request itself is not interpreted, it is only consumed so
+             * that the client does not get a reset*/
+            pollfd request{fd, POLLIN, 0};
+            if (::poll(&request, 1, request_wait_time) > 0) {
+                char buffer[4096];
+                [[maybe_unused]] auto _{::read(fd, buffer, sizeof(buffer))};
+            }
+            auto body{_metrics.prometheus()};
+            auto response{std::format(
+                "HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+                "version=0.0.4\r\nContent-Length: {}\r\n\r\n{}",
+                body.size(),
+                body)};
+            std::string_view left{response};
+            while (!left.empty()) {
+                auto n{::send(fd, left.data(), left.size(), MSG_NOSIGNAL)};
+                if (n <= 0) { break; }
+                left.remove_prefix(static_cast<size_t>(n));
+            }
+        }
+
+
+        /**
+         * @brief      Exports metrics until stop is signalled.
+         *
+         * @return     void
+         */
+        auto run() {
+            pollfd fds[2]{{_stop_fd, POLLIN, 0}, {_listen_fd, POLLIN, 0}};
+            auto listening{_listen_fd != -1};
+            auto timeout{
+                listening ? -1 : static_cast<int>(_options.interval.count())};
+            while (true) {
+                auto ready{::poll(fds, listening ? 2 : 1, timeout)};
+                if (ready < 0 && errno == EINTR) { continue; }
+                if (ready < 0 || fds[0].revents) { break; }
+                if (!listening) {
+                    dump();
+                } else if (fds[1].revents & POLLIN) {
+                    auto fd{::accept4(
+                        _listen_fd, nullptr, nullptr, SOCK_CLOEXEC)};
+                    if (fd != -1) {
+                        serve(fd);
+                        ::close(fd);
+                    }
+                }
+            }
+        }
+
+
+        /**
+         * @brief      Creates the listening socket.
+         *
+         * @return     void
+         */
+        auto listen() {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (_socket_path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error{std::format(
+                    "metrics socket path {} is too long", _socket_path)};
+            }
+            std::memcpy(
+                address.sun_path, _socket_path.data(), _socket_path.size());
+            _listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            ::unlink(_socket_path.c_str());
+            if (_listen_fd == -1 ||
+                ::bind(_listen_fd,
+                       reinterpret_cast<sockaddr *>(&address),
+                       sizeof(address)) == -1 ||
+                ::listen(_listen_fd, SOMAXCONN) == -1) {
+                throw std::runtime_error{std::format(
+                    "could not listen for metrics on {}: {}",
+                    _socket_path,
+                    std::strerror(errno))};
+            }
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance and starts its thread.
+         *
+         * @param[in]  m        The metrics (must outlive this exporter)
+         * @param[in]  options  The destination
+         */
+        metrics_exporter(const metrics &m, metrics_export_options options)
+            : _metrics{m}, _options{std::move(options)} {
+            if (_stop_fd == -1) {
+                throw std::runtime_error{
+                    "metrics exporter could not create eventfd"};
+            }
+            if (_options.path.starts_with(unix_prefix)) {
+                _socket_path = _options.path.substr(unix_prefix.size());
+                try {
+                    listen();
+                } catch (...) {
+                    if (_listen_fd != -1) { ::close(_listen_fd); }
+                    ::close(_stop_fd);
+                    throw;
+                }
+            }
+            _thread = std::thread{[this] { run(); }};
+        }
+
+
+        metrics_exporter(const metrics_exporter &) = delete;
+        metrics_exporter &operator=(const metrics_exporter &) = delete;
+
+
+        /**
+         * @brief      Stops the thread. A file gets the final metrics.
+         */
+        ~metrics_exporter() noexcept {
+            uint64_t one{1};
+            [[maybe_unused]] auto _{::write(_stop_fd, &one, sizeof(one))};
+            _thread.join();
+            if (_listen_fd != -1) {
+                ::close(_listen_fd);
+                ::unlink(_socket_path.c_str());
+            } else {
+                dump();
+            }
+            ::close(_stop_fd);
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Bounded multi-producer single-consumer ring. A producer
+     * reserves room with one fetch_add, claims a slot with another one and
+     * publishes the item by storing the sequence number of the slot, so
+     * push() is wait-free (it never retries and never waits for other
+     * producers). The consumer takes items in the order of claimed slots and
+     * stops at a slot which was claimed but is not published yet.
+     *
+     * @tparam     T     Type of items
+     */
+    template <typename T>
+    class mpsc_queue {
+      private:
+        /**
+         * @brief      Single slot. Its sequence is position + 1 once the item
+         * of position is published.
+         */
+        struct alignas(64) slot {
+            std::atomic<uint64_t> sequence{0};
+            T item{};
+        };
+
+      private:
+        size_t _mask{};
+        std::unique_ptr<slot[]> _slots{};
+        /*claimed positions and room reserved by producers*/
+        alignas(64) std::atomic<uint64_t> _tail{0};
+        alignas(64) std::atomic<size_t> _reserved{0};
+        /*next position taken by the consumer*/
+        alignas(64) uint64_t _head{0};
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  capacity  Maximal number of queued items (rounded up to
+         * a power of 2)
+         */
+        explicit mpsc_queue(size_t capacity)
+            : _mask{std::bit_ceil(std::max(capacity, size_t{1})) - 1},
+              _slots{std::make_unique<slot[]>(_mask + 1)} {}
+
+
+        mpsc_queue(const mpsc_queue &) = delete;
+        mpsc_queue &operator=(const mpsc_queue &) = delete;
+
+      public:
+        /**
+         * @brief      Adds an item unless the queue is full. May be called
+         * from any thread.
+         *
+         * @param      item  The item (moved from only if it is added)
+         *
+         * @return     False iff the queue is full
+         */
+        auto push(T &&item) -> bool {
+            if (_reserved.fetch_add(1, std::memory_order_acquire) > _mask) {
+                _reserved.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            auto position{_tail.fetch_add(1, std::memory_order_relaxed)};
+            auto &s{_slots[position & _mask]};
+            s.item = std::move(item);
+            s.sequence.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+
+        /**
+         * @brief      Takes at most n published items. Must be called by a
+         * single thread.
+         *
+         * @param[in]  n     Maximal number of items
+         * @param      out   Function called for every taken item
+         *
+         * @return     Number of taken items
+         */
+        auto pop(size_t n, auto &&out) -> size_t {
+            size_t taken{0};
+            for (; taken < n; ++taken) {
+                auto &s{_slots[_head & _mask]};
+                if (s.sequence.load(std::memory_order_acquire) != _head + 1) {
+                    break;
+                }
+                out(std::move(s.item));
+                ++_head;
+                /*the slot is reused only after the room is given back*/
+                _reserved.fetch_sub(1, std::memory_order_release);
+            }
+            return taken;
+        }
+
+
+        /**
+         * @brief      Number of queued items (approximate while items are
+         * pushed or taken).
+         */
+        auto size() const {
+            return _reserved.load(std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Maximal number of queued items.
+         */
+        auto capacity() const { return _mask + 1; }
+    };
+
+
+}  // namespace cppurl
@@ -1,52 +1,299 @@
 #pragma once
 
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <backpressure.hpp>
+#include <batcher.hpp>
+#include <cctype>
 #include <cppurl.hpp>
 #include <csignal>
+#include <deduplicator.hpp>
+#include <event_loop.hpp>
+#include <metrics.hpp>
 #include <future>
+#include <json_fields.hpp>
+#include <mapped_input.hpp>
+#include <mpsc_queue.hpp>
+#include <optional>
+#include <priority_lanes.hpp>
 #include <queue>
+#include <rate_limiter.hpp>
+#include <request_arena.hpp>
+#include <retry_scheduler.hpp>
+#include <route_table.hpp>
+#include <spool.hpp>
+#include <stdin_reader.hpp>
+#include <text_template.hpp>
 #include <timer.hpp>
+#include <work_stealing_queue.hpp>
 
 /*this global variable is used to handle interuption signal in the notifier
- * class*/
-constinit inline bool should_stop{false};
+ * class (atomic, since it is read by all shards of sharded_notifier)*/
+constinit inline std::atomic<bool> should_stop{false};
 
 
 /**
- * @brief      Handle for interruption signal. Sets should_stop to true.
+ * @brief      Handle for interruption signal. Sets should_stop to true (and
+ * does nothing else, since only lock-free atomics are async-signal-safe).
  *
  * @param[in]  sig   The signal
  *
  * @return     void
  */
 extern "C" auto handle_interuption(int sig) -> void {
-    std::cout << "\n///\nReceived interruption signal\n///\n";
-    should_stop = true;
+    should_stop.store(true, std::memory_order_relaxed);
 };
 
 
-/**
- * @brief      Reads all from std::cin and returns it as a std::string
- *
- * @return     std::string from std::cin
- */
-auto cin_to_string() -> std::string {
-    return {std::istreambuf_iterator<char>{std::cin},
-                std::istreambuf_iterator<char>{}};
-}
+namespace cppurl {
 
 
-namespace cppurl {
+    /**
+     * @brief      Engines which can drive transfers of the notifier.
+     */
+    enum class engine {
+        /*curl_multi_perform + curl_multi_wait with fixed timeout*/
+        poll,
+        /*curl_multi_socket_action driven by epoll and timerfd*/
+        socket_action
+    };
 
 
     /**
-     * @brief      Notifier application.
+     * @brief      Http/2 settings of the notifier.
      */
-    class notifier : public app<notifier> {
+    struct http2_options {
+        /*use http/2 (negotiated via ALPN for https urls)*/
+        bool enabled{false};
+        /*use http/2 for plain http urls without upgrade (h2c)*/
+        bool prior_knowledge{false};
+        /*maximal number of connections to a single host (0 means no limit)*/
+        size_t max_host_connections{0};
+        /*maximal number of concurrent streams on a single connection*/
+        size_t max_concurrent_streams{100};
+    };
 
 
-      private:
-        static constexpr size_t max_num_of_connections{100};
-        static constexpr int poll_wait_time{100};
+    /**
+     * @brief      Number of completed transfers and connections they had to
+     * open.
+     */
+    struct multiplexing_stats {
+        uint64_t transfers{0};
+        uint64_t connections{0};
+
+        /**
+         * @brief      Average number of transfers (http/2 streams) carried by
+         * a single connection.
+         */
+        auto streams_per_connection() const -> double {
+            return connections == 0 ? 0.0
+                                    : static_cast<double>(transfers) /
+                                          static_cast<double>(connections);
+        }
+
+        auto &operator+=(const multiplexing_stats &other) {
+            transfers += other.transfers;
+            connections += other.connections;
+            return *this;
+        }
+    };
+
+
+    /**
+     * @brief      Counters of requests which were read but never queued.
+     */
+    struct request_stats {
+        /*requests which had no destination*/
+        uint64_t unrouted{0};
+        /*repeated requests suppressed by the deduplicator*/
+        uint64_t suppressed{0};
+        /*requests whose rendered headers would contain CR or LF*/
+        uint64_t rejected{0};
+        /*lines of stdin longer than notifier_options::max_line_size*/
+        uint64_t oversized{0};
+
+        auto &operator+=(const request_stats &other) {
+            unrouted += other.unrouted;
+            suppressed += other.suppressed;
+            rejected += other.rejected;
+            oversized += other.oversized;
+            return *this;
+        }
+    };
+
+
+    /**
+     * @brief      Counters of the bounded queue and its priority lanes.
+     */
+    struct queue_stats {
+        /*times reading was paused at a high watermark (block policy)*/
+        uint64_t paused{0};
+        /*requests dropped at a high watermark by drop policies*/
+        uint64_t dropped_oldest{0};
+        uint64_t dropped_newest{0};
+        /*counters of priority lanes (summed over destinations)*/
+        lanes_stats lanes{};
+
+        auto &operator+=(const queue_stats &other) {
+            paused += other.paused;
+            dropped_oldest += other.dropped_oldest;
+            dropped_newest += other.dropped_newest;
+            for (size_t i{0}; i < lanes.size(); ++i) {
+                lanes[i] += other.lanes[i];
+            }
+            return *this;
+        }
+    };
+
+
+    /**
+     * @brief      Failures of the spool (requests are sent anyway).
+     */
+    struct spool_stats {
+        /*requests which could not be written to the spool (they are not
+         * replayed after a crash)*/
+        uint64_t unspooled{0};
+        /*commits of the spool which could not flush it to disk*/
+        uint64_t failed_commits{0};
+
+        auto &operator+=(const spool_stats &other) {
+            unspooled += other.unspooled;
+            failed_commits += other.failed_commits;
+            return *this;
+        }
+    };
+
+
+    /**
+     * @brief      All counters of a notifier, grouped by the part which
+     * updates them.
+     */
+    struct notifier_stats {
+        multiplexing_stats multiplexing{};
+        request_stats requests{};
+        queue_stats queue{};
+        spool_stats spool{};
+
+        auto &operator+=(const notifier_stats &other) {
+            multiplexing += other.multiplexing;
+            requests += other.requests;
+            queue += other.queue;
+            spool += other.spool;
+            return *this;
+        }
+    };
+
+
+    /**
+     * @brief      Optional settings of the notifier.
+     */
+    struct notifier_options {
+        cppurl::engine engine{engine::poll};
+        /*maximal sleep of the poll engine in curl_multi_wait*/
+        std::chrono::milliseconds poll_wait_time{100};
+        /*maximal number of simultaneous transfers (and cached connections)*/
+        size_t max_connections{100};
+        /*number of handles created up front and never trimmed*/
+        size_t min_connections{0};
+        /*maximal number of simultaneous transfers to a single destination (0
+         * means a fair share of max_connections, i.e. max_connections divided
+         * by the number of destinations, rounded up)*/
+        size_t max_destination_connections{0};
+        /*destinations of keyed requests (if null, every request is posted to
+         * the url of the notifier)*/
+        const route_table *routes{nullptr};
+        /*packing of many requests into one post*/
+        batch_options batching{};
+        /*priority lanes and time to live of queued requests*/
+        priority_options priorities{};
+        /*suppression of repeated requests (done by the reading thread in
+         * sharded mode)*/
+        dedup_options dedup{};
+        /*multiplexing of transfers over http/2 connections*/
+        http2_options http2{};
+        /*compression of posted bodies*/
+        compression_options compression{};
+        /*retries of failed transfers*/
+        retry_options retries{};
+        /*limits of posts and posted bytes per second to a single destination
+         * (retries included)*/
+        rate_options rate{};
+        /*limits of queued requests (of the shared queue in sharded mode)*/
+        backpressure_options backpressure{};
+        /*maximal captured size of a response body passed to callbacks
+         * through handle_info::response (0 means responses are not
+         * captured)*/
+        size_t max_response_size{0};
+        /*DNS cache and TLS sessions shared with other notifiers (if null, the
+         * notifier shares them only among its own handles)*/
+        share_handle *share{nullptr};
+        /*on-disk log of queued requests (if null, they are kept only in
+         * memory)*/
+        cppurl::spool *spool{nullptr};
+        /*latency histograms and counters of transfers, may be shared with
+         * other notifiers (if null, nothing is recorded)*/
+        cppurl::metrics *metrics{nullptr};
+        /*read requests from stdin (ignored by shards and if there is an
+         * input file)*/
+        bool read_stdin{true};
+        /*longer lines of stdin are skipped (and counted as oversized)*/
+        size_t max_line_size{stdin_reader::default_max_line_size};
+        /*requests read from a memory mapped file instead of stdin, they are
+         * posted straight from the mapping, so it must outlive the notifier
+         * (read by the calling thread in sharded mode)*/
+        mapped_input *input{nullptr};
+        /*maximal number of requests waiting in the queue of enqueue() (0
+         * means enqueue() is disabled, ignored by shards)*/
+        size_t submission_capacity{0};
+        /*headers of every post ("Name: value"), a header with {field}
+         * placeholders is rendered for every post from the JSON fields of
+         * its body (not allowed with batching)*/
+        std::vector<std::string> headers{};
+        /*body with {field} placeholders, every request supplies only the
+         * values of its fields (see text_template::render_line), empty means
+         * requests are posted as they are*/
+        std::string body_template{};
+    };
+
+
+    /**
+     * @brief      Request passed to shards of a sharded_notifier with its
+     * spool ticket and priority (its prefix is already stripped off the
+     * body).
+     */
+    struct queued_request {
+        request_arena::ref body{};
+        spool::ticket ticket{spool::no_ticket};
+        batcher::clock_type::time_point enqueued{};
+        priority p{};
+    };
+
+
+    /**
+     * @brief      Connects a notifier to the other shards of a
+     * sharded_notifier. Such a notifier takes requests from the shared queue
+     * instead of stdin.
+     */
+    struct shard_link {
+        prioritized_work_queue<queued_request> *queue{nullptr};
+        /*size of bodies in the queue, decremented by shards*/
+        std::atomic<size_t> *queued_bytes{nullptr};
+        size_t index{0};
+        /*eventfd signalled when new requests were pushed to the queue*/
+        int wakeup_fd{-1};
+        /*set by the sharded notifier to stop all shards*/
+        const std::atomic<bool> *stop{nullptr};
+    };
+
+
+    /**
+     * @brief      Notifier application.
+     */
+    class notifier : public app<notifier> {
 
 
       public:
@@ -106,40 +353,698 @@ namespace cppurl {
 
 
       private:
-        handle_pool<max_num_of_connections> pool{};
+        /**
+         * @brief      Requests waiting for a single destination and limits of
+         * its transfers.
+         */
+        struct destination {
+            std::string_view url{};
+            batcher requests;
+            retry_scheduler retries;
+            /*fresh requests and retries take turns when both are ready*/
+            bool retry_turn{false};
+            rate_limiter limiter;
+            size_t in_flight{0};
+
+            destination(std::string_view url, const notifier_options &options)
+                : url{url},
+                  requests{options.batching, options.priorities.lanes},
+                  retries{options.retries},
+                  limiter{options.rate} {}
+
+            /*lets std::vector move destinations (queues are never copied)*/
+            destination(destination &&) noexcept = default;
+        };
+
+      private:
+        share_handle own_share{};
+        /*own_share or the one passed in notifier_options*/
+        share_handle &share;
+        cppurl::spool *spool{nullptr};
+        cppurl::metrics *metrics{nullptr};
+        /*number of queued requests last added to metrics*/
+        int64_t published_queued{0};
+        request_arena arena{};
+        const route_table *routes{nullptr};
+        priority_options priorities{};
+        /*destinations of the route table followed by the url of the notifier
+         * (if not empty)*/
+        std::vector<destination> destinations{};
+        std::optional<size_t> default_destination{};
+        size_t max_in_flight{};
+        /*destination checked first by next_ready (round robin)*/
+        size_t next_destination{0};
+        watermarks queue_limits;
+        /*headers without placeholders, built once and shared by all
+         * handles*/
+        header_list shared_headers;
+        std::vector<text_template> header_templates{};
+        /*fields of the placeholders of all header templates*/
+        json_fields header_fields{};
+        std::optional<text_template> body_template{};
+        http2_options http2{};
+        compression_options compression{};
+        /*buffers of captured responses (must outlive the handles)*/
+        response_pool responses;
+        handle_pool<status> pool;
         nb_handle mhandle{};
-        std::string_view url{};
-        std::queue<std::string> requests{};
+        notifier_stats _stats{};
+        std::optional<stdin_reader> reader{};
+        mapped_input *input{nullptr};
+        std::optional<deduplicator> dedup{};
+        /*requests passed to enqueue() by other threads*/
+        std::unique_ptr<mpsc_queue<std::string>> submissions{};
+        /*true while the loop was woken up but did not take submissions yet*/
+        std::atomic<bool> wakeup_pending{false};
+        /*set by stop()*/
+        std::atomic<bool> stopping{false};
+        /*eventfd of submissions watched by the socket action engine (the
+         * poll engine is woken up by curl_multi_wakeup)*/
+        int submission_fd{-1};
+        std::optional<shard_link> shard{};
+        curl_waitfd wakeup_wait_fd{};
+        std::optional<event_loop> loop{};
+        bool input_watched{false};
         timer<std::chrono::steady_clock> _timer{};
         const std::chrono::seconds time_for_new_data{1};
+        const int poll_wait_time{100};
 
       private:
         /**
-         * @brief      Reads stdin list of post requests.
+         * @brief      Creates destinations of the route table and the default
+         * one (url).
+         *
+         * @param[in]  url      The default url (may be empty)
+         * @param[in]  options  The options
+         *
+         * @return     The destinations
+         */
+        static auto make_destinations(std::string_view url,
+                                      const notifier_options &options)
+            -> std::vector<destination> {
+            std::vector<destination> d{};
+            if (options.routes) {
+                for (size_t i{0}; i < options.routes->size(); ++i) {
+                    d.emplace_back(options.routes->url(i), options);
+                }
+            }
+            if (!url.empty()) { d.emplace_back(url, options); }
+            if (d.empty()) {
+                throw std::runtime_error{"notifier has no destination"};
+            }
+            return d;
+        }
+
+
+        /**
+         * @brief      Builds the headers shared by all handles: those of
+         * options without placeholders and the content type of batches
+         * (unless there is a Content-Type header among options). Throws
+         * std::invalid_argument if a header of options contains CR or LF, or
+         * has placeholders while requests are batched (the values of a single
+         * request would be sent for all of them).
+         *
+         * @param[in]  options       The options
+         * @param[in]  content_type  The content type header of batches (may
+         * be empty)
+         *
+         * @return     The headers
+         */
+        static auto make_shared_headers(const notifier_options &options,
+                                        std::string_view content_type)
+            -> header_list {
+            header_list list{};
+            auto is_content_type{[](std::string_view h) {
+                constexpr std::string_view name{"content-type:"};
+                return h.size() >= name.size() &&
+                       std::ranges::equal(
+                           h.substr(0, name.size()), name, {}, [](char c) {
+                               return static_cast<char>(
+                                   std::tolower(static_cast<unsigned char>(c)));
+                           });
+            }};
+            auto append{[&](std::string_view h) {
+                if (!list.append(h)) {
+                    throw std::runtime_error{"could not append http header"};
+                }
+            }};
+            for (auto &h : options.headers) {
+                if (h.find_first_of("\r\n") != h.npos) {
+                    throw std::invalid_argument{
+                        "http header must not contain CR or LF"};
+                }
+                if (text_template{h}.names().empty()) {
+                    append(h);
+                } else if (options.batching.framing != framing::none) {
+                    throw std::invalid_argument{
+                        "http header with placeholders cannot be used with "
+                        "batches"};
+                }
+            }
+            if (!content_type.empty() &&
+                std::ranges::none_of(options.headers, is_content_type)) {
+                append(content_type);
+            }
+            return list;
+        }
+
+
+        /**
+         * @brief      Extracts the fields of the header templates (see
+         * notifier_options::headers) from the body of a post, once for all
+         * templates.
+         *
+         * @param[in]  body  The body of the post (it must outlive the
+         * rendering of its headers)
+         *
+         * @return     False iff a value contains CR or LF, the post must then
+         * be rejected so that it cannot add headers
+         */
+        auto extract_header_fields(std::string_view body) -> bool {
+            if (header_fields.empty()) { return true; }
+            header_fields.extract(body);
+            return !header_fields.contain("\r\n");
+        }
+
+
+        /**
+         * @brief      Renders the headers of a single post from the fields
+         * extracted last (see extract_header_fields) into own headers of its
+         * handle.
+         *
+         * @param      handle  The handle
+         *
+         * @return     void
+         */
+        auto render_headers(b_handle &handle) {
+            for (auto &t : header_templates) {
+                handle.request_header(t.render_fields(header_fields));
+            }
+        }
+
+
+        /**
+         * @brief      Adds a request without a priority prefix to the queue of
+         * its destination. If it starts with a key of the route table, the
+         * key is stripped off. Otherwise the request goes to the default
+         * destination (or is dropped, and acknowledged in the spool, if there
+         * is none). A full queue is handled according to the overflow policy.
+         * If there is a body template, the rest holds the values of its
+         * fields and the body is rendered straight into the arena and queued
+         * (so the spool and the shared queue of shards keep only the values).
+         *
+         * @param      req       The request
+         * @param[in]  ticket    Its spool ticket
+         * @param[in]  enqueued  Time it was read
+         * @param[in]  p         Its lane and deadline
+         *
+         * @return     void
+         */
+        auto dispatch(request_arena::ref req,
+                      spool::ticket ticket,
+                      batcher::clock_type::time_point enqueued,
+                      priority p) {
+            auto d{default_destination};
+            if (routes) {
+                auto key{route_table::split(req.body()).first};
+                auto found{key.empty() ? std::nullopt : routes->find(key)};
+                if (found) {
+                    req.remove_prefix(key.size() + 1);
+                    d = found;
+                }
+            }
+            if (!d) {
+                ++_stats.requests.unrouted;
+                if (spool) { spool->acknowledge({&ticket, 1}); }
+                return;
+            }
+            if (!make_room()) {
+                ++_stats.queue.dropped_newest;
+                if (spool) { spool->acknowledge({&ticket, 1}); }
+                return;
+            }
+            if (body_template) {
+                auto size{body_template->bind_line(req.body())};
+                req = arena.append(
+                    size, [this](char *data) { body_template->write(data); });
+            }
+            destinations[*d].requests.push(
+                std::move(req), ticket, enqueued, p);
+        }
+
+
+        /**
+         * @brief      Adds a request to the queue of its destination. A
+         * priority prefix (if enabled) is stripped off first and selects the
+         * lane and deadline of the request (see the other overload).
+         *
+         * @param      req       The request
+         * @param[in]  ticket    Its spool ticket
+         * @param[in]  enqueued  Time it was read
+         *
+         * @return     void
+         */
+        auto dispatch(request_arena::ref req,
+                      spool::ticket ticket,
+                      batcher::clock_type::time_point enqueued =
+                          batcher::clock_type::now()) {
+            auto [p, prefix] =
+                priority::parse(req.body(), priorities, enqueued);
+            req.remove_prefix(prefix);
+            dispatch(std::move(req), ticket, enqueued, p);
+        }
+
+
+        /**
+         * @brief      True iff run() should stop: the interruption signal was
+         * received, stop() was called or the sharded notifier stops its
+         * shards.
+         */
+        auto stopped() const -> bool {
+            return ::should_stop.load(std::memory_order_relaxed) ||
+                   stopping.load(std::memory_order_relaxed) ||
+                   (shard && shard->stop &&
+                    shard->stop->load(std::memory_order_relaxed));
+        }
+
+
+        /**
+         * @brief      Number of requests waiting for all destinations.
+         */
+        auto pending() const {
+            size_t n{0};
+            for (auto &d : destinations) { n += d.requests.size(); }
+            return n;
+        }
+
+
+        /**
+         * @brief      Number and size in bytes of requests waiting for all
+         * destinations (including retries).
+         */
+        auto queued() const -> std::pair<size_t, size_t> {
+            size_t items{0};
+            size_t bytes{0};
+            for (auto &d : destinations) {
+                items += d.requests.size() + d.retries.items();
+                bytes += d.requests.bytes() + d.retries.bytes();
+            }
+            return {items, bytes};
+        }
+
+
+        /**
+         * @brief      Makes room for a new request if the queue reached its
+         * high watermark and the policy is to drop requests (a shard leaves it
+         * to the reading thread). Drop oldest takes requests from the longest
+         * queue.
+         *
+         * @return     False iff the new request should be dropped
+         */
+        auto make_room() -> bool {
+            auto policy{queue_limits.overflow()};
+            if (shard || policy == overflow_policy::block) { return true; }
+            while (true) {
+                auto [items, bytes] = queued();
+                if (!queue_limits.above_high(items, bytes)) { return true; }
+                auto longest{std::ranges::max_element(
+                    destinations,
+                    {},
+                    [](auto &d) { return d.requests.size(); })};
+                if (policy == overflow_policy::drop_newest ||
+                    longest->requests.empty()) {
+                    return false;
+                }
+                auto ticket{longest->requests.drop()};
+                ++_stats.queue.dropped_oldest;
+                if (spool) { spool->acknowledge({&ticket, 1}); }
+            }
+        }
+
+
+        /**
+         * @brief      Checks watermarks of the queue if the policy is to block
+         * the input.
+         *
+         * @return     True iff reading of stdin is paused
+         */
+        auto pause_input() -> bool {
+            if (shard || queue_limits.overflow() != overflow_policy::block) {
+                return false;
+            }
+            auto [items, bytes] = queued();
+            if (queue_limits.update(items, bytes)) {
+                ++_stats.queue.paused;
+            }
+            return queue_limits.full();
+        }
+
+
+        /**
+         * @brief      Accepts a request read by this thread: suppresses it if
+         * it is a repeated one, otherwise appends it to the spool (if any),
+         * copies it to the arena (unless it is mapped or only gives values of
+         * the body template, which is rendered into the arena by dispatch)
+         * and dispatches it.
+         *
+         * @param[in]  req     The request
+         * @param[in]  mapped  True iff req points into the mapped input (it
+         * outlives the notifier, so it is not copied)
+         *
+         * @return     void
+         */
+        auto accept(std::string_view req, bool mapped = false) {
+            if (dedup && dedup->duplicate(req)) {
+                ++_stats.requests.suppressed;
+                if (metrics) { metrics->record_suppressed(); }
+                return;
+            }
+            auto ticket{spool ? spool->append(req) : spool::no_ticket};
+            if (spool && ticket == spool::no_ticket) {
+                ++_stats.spool.unspooled;
+            }
+            dispatch(mapped || body_template ? request_arena::view(req)
+                                             : arena.append(req),
+                     ticket);
+        }
+
+
+        /**
+         * @brief      Flushes the spool (unless it is owned by the sharded
+         * notifier).
+         *
+         * @param[in]  force  Commit even if the sync interval did not elapse
+         *
+         * @return     The status (CURLE_WRITE_ERROR if the spool could not be
+         * flushed, so that requests would not survive a crash)
+         */
+        auto commit_spool(bool force) -> status {
+            if (!spool || shard ||
+                (force ? spool->commit() : spool->maybe_commit())) {
+                return cppurl::status<ffor::multi>{CURLM_OK};
+            }
+            ++_stats.spool.failed_commits;
+            return cppurl::status<ffor::single>{CURLE_WRITE_ERROR};
+        }
+
+
+        /**
+         * @brief      Number of requests of the mapped input which may be
+         * queued now: like a shard, the notifier takes no more than it can
+         * launch, so that a big file is not queued as a whole.
+         */
+        auto input_capacity() const -> size_t {
+            auto capacity{pool.size() *
+                          destinations.front().requests.max_items()};
+            auto queued{pending()};
+            return queued < capacity ? capacity - queued : 0;
+        }
+
+
+        /**
+         * @brief      True iff the mapped input has requests which may be
+         * read now, so the loop should not sleep.
+         */
+        auto input_ready() const -> bool {
+            return input && !input->eof() && !queue_limits.full() &&
+                   input_capacity() > 0;
+        }
+
+
+        /**
+         * @brief      Wakes up the loop unless it was woken up already and
+         * did not take submissions since.
          *
-         * @return     A view consisiting of post field strings.
+         * @return     void
          */
-        [[nodiscard]] auto read_stdin_requests() const {
-            return std::ranges::owning_view{cin_to_string()} |
-                   std::views::split(std::string_view{"\n"}) |
-                   std::views::transform([](auto &&req) -> std::string {
-                       return std::string{
-                           std::string_view{std::forward<decltype(req)>(req)}};
-                   });
+        auto wake() {
+            if (wakeup_pending.exchange(true)) { return; }
+            if (submission_fd != -1) {
+                uint64_t one{1};
+                [[maybe_unused]] auto _{
+                    ::write(submission_fd, &one, sizeof(one))};
+            } else {
+                mhandle.wakeup();
+            }
+        }
+
+
+        /**
+         * @brief      Takes requests passed to enqueue() (at most the
+         * capacity of the queue per call). The wakeup is consumed first, so a
+         * request enqueued meanwhile wakes the loop again.
+         *
+         * @param[in]  paused  True iff the queue is full (block policy), the
+         * requests are then left to producers
+         *
+         * @return     Number of taken requests
+         */
+        auto take_submissions(bool paused) -> size_t {
+            if (submission_fd != -1) {
+                uint64_t signalled{};
+                [[maybe_unused]] auto _{
+                    ::read(submission_fd, &signalled, sizeof(signalled))};
+            }
+            wakeup_pending.store(false);
+            if (paused) { return 0; }
+            return submissions->pop(
+                submissions->capacity(),
+                [this](std::string &&req) { accept(req); });
+        }
+
+
+        /**
+         * @brief      Reads post requests which are currently available on
+         * stdin (does not block) or in the mapped input (see input_capacity)
+         * and those passed to enqueue(), and accepts them (see accept).
+         * Stdin is not read while the queue is above its watermarks (block
+         * policy), so the producer is blocked by the pipe (and enqueue()
+         * fails once its queue is full).
+         * A shard takes requests from the shared queue instead, but not more
+         * than it can launch, so that the rest can be stolen by idle shards.
+         *
+         * @return     Number of read requests or the error of stdin
+         */
+        auto read_requests() -> std::expected<size_t, status> {
+            if (!shard) {
+                auto paused{pause_input()};
+                auto read{submissions ? take_submissions(paused) : 0};
+                if (!paused && input) {
+                    read += input->read(
+                        input_capacity(),
+                        [this](std::string_view req) { accept(req, true); });
+                }
+                if (paused || !reader) { return read; }
+                auto lines{reader->read(
+                    [this](std::string_view req) { accept(req); })};
+                UNEXP_FORWARD_UNEXPECTED(lines);
+                return read + *lines;
+            }
+            uint64_t signalled{};
+            [[maybe_unused]] auto _{
+                ::read(shard->wakeup_fd, &signalled, sizeof(signalled))};
+            auto capacity{pool.size() *
+                          destinations.front().requests.max_items()};
+            auto queued{pending()};
+            if (queued >= capacity) { return 0; }
+            return shard->queue->pop(shard->index,
+                                     capacity - queued,
+                                     [this](queued_request &&req) {
+                                         shard->queued_bytes->fetch_sub(
+                                             req.body.body().size(),
+                                             std::memory_order_relaxed);
+                                         dispatch(std::move(req.body),
+                                                  req.ticket,
+                                                  req.enqueued,
+                                                  req.p);
+                                     });
+        }
+
+
+        /**
+         * @brief      File descriptor signalling new requests (stdin or
+         * wakeup eventfd of a shard).
+         */
+        auto input_fd() const -> int {
+            return shard ? shard->wakeup_fd : reader->fd();
+        }
+
+
+        /**
+         * @brief      True iff new requests may still arrive through
+         * input_fd() and it is not paused.
+         */
+        auto input_open() const -> bool {
+            return shard ||
+                   (reader && !reader->eof() && !queue_limits.full());
+        }
+
+
+        /**
+         * @brief      File descriptors which should be passed to
+         * curl_multi_wait.
+         *
+         * @return     std::span of curl_waitfd
+         */
+        auto input_wait_fds() -> std::span<curl_waitfd> {
+            if (!shard && (!reader || queue_limits.full())) { return {}; }
+            if (!shard) { return reader->wait_fds(); }
+            wakeup_wait_fd.revents = 0;
+            return {&wakeup_wait_fd, 1};
+        }
+
+
+        /**
+         * @brief      Sets everything which does not change between transfers
+         * (share handle, headers, http version) and the url of the first
+         * destination (it is changed only when the handle serves another
+         * one). Called once for every handle created by the pool.
+         *
+         * @param      handle  The handle
+         *
+         * @return     status
+         */
+        [[nodiscard]] auto configure(b_handle &handle) -> status {
+            FORWARD_ERROR(handle.destination(0, destinations.front().url));
+            FORWARD_ERROR(handle.share(share));
+            if (shared_headers.to_underlying()) {
+                FORWARD_ERROR(handle.headers(shared_headers));
+            }
+            FORWARD_ERROR(handle.compress(compression));
+            if (responses.max_size() > 0) {
+                FORWARD_ERROR(handle.capture(responses));
+            }
+            if (http2.enabled) {
+                FORWARD_ERROR(handle.http_version(
+                    http2.prior_knowledge ? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE
+                                          : CURL_HTTP_VERSION_2TLS));
+                FORWARD_ERROR(handle.pipewait(true));
+            }
+            return cppurl::status<ffor::multi>{CURLM_OK};
+        }
+
+
+        /**
+         * @brief      True iff a fresh batch or a retry can be launched to the
+         * destination, i.e. it has not reached its in-flight limit and its
+         * rate limiter allows it.
+         *
+         * @param      d     The destination
+         */
+        auto launch_ready(destination &d) -> bool {
+            return d.in_flight < max_in_flight &&
+                   (d.requests.ready() || d.retries.ready()) &&
+                   d.limiter.ready();
+        }
+
+
+        /**
+         * @brief      Finds a destination which is ready for a launch. The
+         * search starts after the previously found one, so that destinations
+         * take turns.
+         *
+         * @return     The destination (nullptr if there is none)
+         */
+        auto next_ready() -> destination * {
+            for (size_t i{0}; i < destinations.size(); ++i) {
+                auto index{(next_destination + i) % destinations.size()};
+                if (launch_ready(destinations[index])) {
+                    next_destination = (index + 1) % destinations.size();
+                    return &destinations[index];
+                }
+            }
+            return nullptr;
+        }
+
+
+        /**
+         * @brief      Time left until a fresh batch or a retry can be
+         * launched to some destination (including the time for the next token
+         * of its rate limiter).
+         *
+         * @return     Milliseconds to wait (-1 if there is nothing to wait
+         * for)
+         */
+        auto launch_wait_time() -> int {
+            if (pool.size() == 0) { return -1; }
+            int wait{-1};
+            for (auto &d : destinations) {
+                if (d.in_flight >= max_in_flight) { continue; }
+                auto fresh{d.requests.wait_time()};
+                auto retry{d.retries.wait_time()};
+                auto w{fresh < 0 || retry < 0 ? std::max(fresh, retry)
+                                              : std::min(fresh, retry)};
+                if (w < 0) { continue; }
+                w = std::max(w, d.limiter.wait_time());
+                wait = wait < 0 ? w : std::min(wait, w);
+            }
+            return wait;
         }
 
 
         /**
          * @brief      Adds a post request using free handle from the pool and
-         * assigning it a request from requests queue.
+         * assigning it a batch of requests from the queue of the destination
+         * (a single request if batching is off) or a body which is due for a
+         * retry. If both are ready, they take turns, so that retries do not
+         * starve fresh requests. Requests which expired while queued are
+         * dropped (and acknowledged in the spool) here, and a request whose
+         * header fields contain CR or LF is rejected (so that input cannot
+         * add headers), so nothing may be launched.
+         *
+         * @param      d     The destination
          *
          * @return     status
          */
-        [[nodiscard]] auto add_post_request() -> status {
-            auto &handle{pool.get()};
-            FORWARD_ERROR(handle.url(url));
-            FORWARD_ERROR(handle.template post<true>(requests.front()));
-            requests.pop();
+        [[nodiscard]] auto add_post_request(destination &d) -> status {
+            auto retry{d.retries.ready()};
+            if (retry && d.requests.ready()) {
+                retry = d.retry_turn;
+                d.retry_turn = !d.retry_turn;
+            }
+            std::optional<batcher::batch> fresh{};
+            if (!retry) {
+                fresh = d.requests.next(arena);
+                if (spool && !fresh->expired.empty()) {
+                    spool->acknowledge(fresh->expired);
+                }
+                if (fresh->items == 0) {
+                    return cppurl::status<ffor::multi>{CURLM_OK};
+                }
+                if (!extract_header_fields(fresh->body.body())) {
+                    _stats.requests.rejected += fresh->items;
+                    if (spool) { spool->acknowledge(fresh->tickets); }
+                    return cppurl::status<ffor::multi>{CURLM_OK};
+                }
+            }
+            auto h{pool.get()};
+            FORWARD_UNEXPECTED(h);
+            auto &handle{**h};
+            auto index{static_cast<size_t>(&d - destinations.data())};
+            if (handle.destination() != index) {
+                FORWARD_ERROR(handle.destination(index, d.url));
+            }
+            if (retry) {
+                auto e{d.retries.pop()};
+                /*the fields were checked before the first attempt*/
+                extract_header_fields(e.body.body());
+                render_headers(handle);
+                FORWARD_ERROR(handle.post(std::move(e.body),
+                                          e.items,
+                                          e.attempt,
+                                          e.tickets,
+                                          e.enqueued));
+            } else {
+                render_headers(handle);
+                FORWARD_ERROR(handle.post(std::move(fresh->body),
+                                          fresh->items,
+                                          0,
+                                          fresh->tickets,
+                                          fresh->enqueued));
+            }
+            d.limiter.consume(handle.posted().size());
+            ++d.in_flight;
+            if (metrics) { metrics->add_in_flight(1); }
             FORWARD_ERROR(mhandle.add(handle));
             return cppurl::status<ffor::multi>{CURLM_OK};
         };
@@ -147,26 +1052,110 @@ namespace cppurl {
 
         /**
          * @brief      Adds post requests. Reads stdin for new requests, adds
-         * them the the queue and then launches as many post requests as
-         * possible (this number is limited due to max_number_of_connections).
+         * them the the queues and then launches as many post requests as
+         * possible (this number is limited due to max_connections, in-flight
+         * limits of destinations and batching limits).
          *
          * @return     status
          */
         [[nodiscard]] auto add_post_requests() -> status {
+            FORWARD_UNEXPECTED(read_requests());
+            while (pool.size() > 0) {
+                auto d{next_ready()};
+                if (!d) { break; }
+                FORWARD_ERROR(add_post_request(*d));
+            }
+            return cppurl::status<ffor::multi>{CURLM_OK};
+        }
+
 
-            for (auto &&req : read_stdin_requests()) {
-                requests.push(std::move(req));
+        /**
+         * @brief      Schedules a retry of a failed transfer if it is
+         * retryable and its body did not run out of retries.
+         *
+         * @param[in]  handle_info  The handle information
+         * @param      handle       The handle of the transfer
+         *
+         * @return     True iff the retry was scheduled
+         */
+        [[nodiscard]] auto schedule_retry(auto handle_info, b_handle &handle)
+            -> std::expected<bool, status> {
+            auto &retries{destinations[handle.destination()].retries};
+            if (!retries.can_retry(handle.attempt())) { return false; }
+            auto code{handle_info.status().code};
+            long response_code{0};
+            if (code == CURLE_OK) {
+                auto r{handle.response_code()};
+                UNEXP_FORWARD_UNEXPECTED(r);
+                response_code = *r;
+            }
+            if (!retry_scheduler::retryable(code, response_code)) {
+                return false;
             }
-            auto min{std::min(requests.size(), pool.size())};
-            for (size_t i{0}; i < min; ++i) {
-                FORWARD_ERROR(add_post_request());
+            auto retry_after{handle.retry_after()};
+            UNEXP_FORWARD_UNEXPECTED(retry_after);
+            retries.schedule(handle.take_body(),
+                             handle.items(),
+                             handle.attempt(),
+                             handle.tickets(),
+                             handle.enqueued(),
+                             *retry_after);
+            return true;
+        }
+
+
+        /**
+         * @brief      Records metrics of a completed attempt of a transfer
+         * and, after its last attempt, of its outcome.
+         *
+         * @param[in]  handle_info  The handle information
+         * @param      handle       The handle of the transfer
+         * @param[in]  bytes        Size of the posted body
+         * @param[in]  retried      True iff the transfer is going to be
+         * retried
+         *
+         * @return     status
+         */
+        [[nodiscard]] auto record_metrics(auto handle_info,
+                                          b_handle &handle,
+                                          size_t bytes,
+                                          bool retried) -> status {
+            auto timings{handle.timings()};
+            FORWARD_UNEXPECTED(timings);
+            metrics->record_attempt(*timings, bytes);
+            metrics->add_in_flight(-1);
+            if (retried) {
+                metrics->record_retry();
+                return cppurl::status<ffor::multi>{CURLM_OK};
             }
+            auto response_code{handle.response_code()};
+            FORWARD_UNEXPECTED(response_code);
+            metrics->record_outcome(
+                handle_info.status().code,
+                *response_code,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    batcher::clock_type::now() - handle.enqueued()));
             return cppurl::status<ffor::multi>{CURLM_OK};
         }
 
+
+        /**
+         * @brief      Publishes the change of the number of queued requests
+         * to the metrics.
+         *
+         * @return     void
+         */
+        auto publish_queued() {
+            if (!metrics) { return; }
+            auto items{static_cast<int64_t>(queued().first)};
+            metrics->add_queued(items - published_queued);
+            published_queued = items;
+        }
+
       private:
         /**
-         * @brief      Handles a completed transfer case.
+         * @brief      Handles a completed transfer case. A retryable failure
+         * is scheduled for a retry instead of being reported.
          *
          * @param[in]  handle_info               The handle information
          * @param      on_successful_transfer    Function to be launched on
@@ -181,17 +1170,35 @@ namespace cppurl {
             auto &&on_successful_transfer,
             auto &&on_unsuccessful_transfer) -> status {
 
-            if (handle_info.status()) {
+            auto h{handle_info.handle()};
+            FORWARD_UNEXPECTED(h);
+            auto bytes{(*h)->posted().size()};
+            auto retried{schedule_retry(handle_info, **h)};
+            FORWARD_UNEXPECTED(retried);
+            if (metrics) {
+                FORWARD_ERROR(
+                    record_metrics(handle_info, **h, bytes, *retried));
+            }
+            /*transfers scheduled for a retry are reported after their last
+             * attempt*/
+            if (!*retried && handle_info.status()) {
                 FORWARD_ERROR(on_successful_transfer(handle_info));
-            } else {
+            } else if (!*retried) {
                 FORWARD_ERROR(on_unsuccessful_transfer(handle_info));
             }
-            auto h{handle_info.handle()};
-            FORWARD_UNEXPECTED(h);
+            auto connections{(*h)->new_connections()};
+            FORWARD_UNEXPECTED(connections);
+            ++_stats.multiplexing.transfers;
+            _stats.multiplexing.connections +=
+                static_cast<uint64_t>(*connections);
             FORWARD_ERROR(mhandle.remove(**h));
+            --destinations[(*h)->destination()].in_flight;
+            if (spool && !*retried) { spool->acknowledge((*h)->tickets()); }
+            (*h)->release_body();
+            (*h)->release_response();
             pool.add(**h);
-            if (!::should_stop && !requests.empty()) {
-                FORWARD_ERROR(add_post_request());
+            if (auto d{stopped() ? nullptr : next_ready()}) {
+                FORWARD_ERROR(add_post_request(*d));
             }
             return cppurl::status<ffor::multi>{CURLM_OK};
         }
@@ -228,27 +1235,275 @@ namespace cppurl {
             return info.second;
         }
 
+        /**
+         * @brief      Performs transfers which are ready (poll engine only,
+         * socket action engine performs them while waiting).
+         *
+         * @return     status
+         */
+        [[nodiscard]] auto perform_transfers() -> status {
+            if (!loop) { FORWARD_UNEXPECTED(mhandle.perform()); }
+            return cppurl::status<ffor::multi>{CURLM_OK};
+        }
+
+
+        /**
+         * @brief      Waits for transfer or stdin events. The poll engine
+         * waits at most poll_wait_time, the socket action engine sleeps until
+         * something happens (but at most time_for_new_data so that signals
+         * and end of stdin are handled). Both wake up when a pending batch
+         * lingered long enough or a retry is due. Once stopped, only the
+         * posts in flight are waited for.
+         *
+         * @return     status
+         */
+        [[nodiscard]] auto wait_for_events() -> status {
+            auto stopping_now{stopped()};
+            auto linger{stopping_now ? -1 : launch_wait_time()};
+            /*the spool of a shard is committed by the reading thread*/
+            if (auto sync{spool && !shard ? spool->wait_time() : -1};
+                sync >= 0) {
+                linger = linger < 0 ? sync : std::min(linger, sync);
+            }
+            if (!loop) {
+                auto timeout{linger >= 0 ? std::min(linger, poll_wait_time)
+                                         : poll_wait_time};
+                auto fds{stopping_now ? std::span<curl_waitfd>{}
+                                      : input_wait_fds()};
+                /*curl_multi_wait returns at once if there is nothing to wait
+                 * for (e.g. when the rate limiter holds back all posts), while
+                 * curl_multi_poll can be woken up by enqueue()*/
+                if (input_ready() && !stopping_now) { timeout = 0; }
+                if (submissions) {
+                    FORWARD_UNEXPECTED(mhandle.poll(timeout, fds));
+                } else if (fds.empty() && pool.in_use() == 0) {
+                    ::poll(nullptr, 0, timeout);
+                } else {
+                    FORWARD_UNEXPECTED(mhandle.wait(timeout, fds));
+                }
+                return cppurl::status<ffor::multi>{CURLM_OK};
+            }
+            auto should_watch{input_open() && !stopping_now};
+            if (stopping_now && submission_fd != -1) {
+                /*submissions are not taken any more, the wakeup is consumed
+                 * so that it does not end every wait*/
+                uint64_t signalled{};
+                [[maybe_unused]] auto _{
+                    ::read(submission_fd, &signalled, sizeof(signalled))};
+            }
+            if (should_watch && !input_watched) {
+                auto watched{loop->watch(input_fd())};
+                FORWARD_UNEXPECTED(watched);
+                input_watched = *watched;
+            } else if (!should_watch && input_watched) {
+                loop->unwatch(input_fd());
+                input_watched = false;
+            }
+            /*stdin which cannot be watched (e.g. regular file) and the
+             * mapped input are read without sleeping until their end*/
+            auto busy{stopping_now ? pool.in_use() == 0
+                                   : (should_watch && !input_watched) ||
+                                         input_ready()};
+            auto timeout{busy ? 0
+                              : static_cast<int>(
+                                    std::chrono::milliseconds{time_for_new_data}
+                                        .count())};
+            if (linger >= 0) { timeout = std::min(timeout, linger); }
+            FORWARD_UNEXPECTED(loop->wait(timeout));
+            return cppurl::status<ffor::multi>{CURLM_OK};
+        }
+
       public:
         /**
          * @brief      Constructs a new instance of notifier assigning it a
          * destination url and time interval.
          *
-         * @param[in]  url                The destination url
+         * @param[in]  url                The destination url of requests
+         * without a key of options.routes (may be empty if there are routes)
          * @param[in]  time_for_new_data  After this time we repeatedly check
          * for new data
+         * @param[in]  options            Optional settings (e.g. engine)
+         */
+        notifier(std::string_view url,
+                 std::chrono::seconds time_for_new_data,
+                 notifier_options options = {})
+            : notifier{url, time_for_new_data, options, std::nullopt} {
+            if (std::signal(SIGINT, handle_interuption) == SIG_ERR) {
+                throw std::runtime_error(
+                    "post example could not set custom handling for "
+                    "interruption signal");
+            }
+        }
+
+
+        /**
+         * @brief      Constructs a new instance of notifier being a shard of
+         * sharded_notifier. It takes requests from the shared queue and does
+         * not install SIGINT handler (the owner does).
+         *
+         * @param[in]  url                The default destination url
+         * @param[in]  time_for_new_data  Maximal sleep of socket action engine
+         * @param[in]  options            Optional settings (e.g. engine)
+         * @param[in]  link               The shared queue and wakeup eventfd
          */
-        notifier(std::string_view url, std::chrono::seconds time_for_new_data)
-            : url{url}, time_for_new_data{time_for_new_data} {
+        notifier(std::string_view url,
+                 std::chrono::seconds time_for_new_data,
+                 notifier_options options,
+                 std::optional<shard_link> link)
+            : share{options.share ? *options.share : own_share},
+              spool{options.spool},
+              metrics{options.metrics},
+              routes{options.routes},
+              priorities{options.priorities},
+              destinations{make_destinations(url, options)},
+              default_destination{
+                  url.empty() ? std::nullopt
+                              : std::optional{destinations.size() - 1}},
+              max_in_flight{options.max_destination_connections > 0
+                                ? options.max_destination_connections
+                                : (options.max_connections +
+                                   destinations.size() - 1) /
+                                      destinations.size()},
+              queue_limits{options.backpressure},
+              shared_headers{make_shared_headers(
+                  options, destinations.front().requests.content_type())},
+              http2{options.http2},
+              compression{options.compression},
+              responses{options.max_response_size},
+              pool{options.min_connections,
+                   options.max_connections,
+                   [this](b_handle &h) { return configure(h); }},
+              shard{link},
+              time_for_new_data{time_for_new_data},
+              poll_wait_time{static_cast<int>(std::max<int64_t>(
+                  options.poll_wait_time.count(), 0))} {
+
+            for (auto &h : options.headers) {
+                if (text_template t{h}; !t.names().empty()) {
+                    for (auto name : t.names()) { header_fields.add(name); }
+                    header_templates.push_back(t);
+                }
+            }
+            if (!options.body_template.empty()) {
+                body_template.emplace(options.body_template);
+            }
+
+            if (shard) {
+                wakeup_wait_fd.fd = shard->wakeup_fd;
+                wakeup_wait_fd.events = CURL_WAIT_POLLIN;
+            } else {
+                input = options.input;
+                if (options.read_stdin && !input) {
+                    reader.emplace(STDIN_FILENO, options.max_line_size);
+                }
+                if (options.dedup.window.count() > 0) {
+                    dedup.emplace(options.dedup);
+                }
+                if (options.submission_capacity > 0) {
+                    submissions = std::make_unique<mpsc_queue<std::string>>(
+                        options.submission_capacity);
+                }
+                if (!reader && !input && !submissions) {
+                    throw std::runtime_error{"notifier has no input"};
+                }
+            }
+
+            if (options.engine == engine::socket_action) {
+                loop.emplace(mhandle);
+                if (submissions) {
+                    submission_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                    if (submission_fd == -1 ||
+                        !loop->watch(submission_fd).value_or(false)) {
+                        throw std::runtime_error(
+                            "notifier could not watch submissions");
+                    }
+                }
+            }
 
             if (!mhandle.maximal_number_of_connections(
-                    max_num_of_connections)) {
+                    static_cast<int64_t>(options.max_connections))) {
                 throw std::runtime_error(
                     "post example could not set maximal number of connections");
             }
-            if (std::signal(SIGINT, handle_interuption) == SIG_ERR) {
+            if (http2.enabled &&
+                (!mhandle.multiplexing(true) ||
+                 !mhandle.maximal_number_of_host_connections(
+                     static_cast<long>(http2.max_host_connections)) ||
+                 !mhandle.maximal_number_of_concurrent_streams(
+                     static_cast<long>(http2.max_concurrent_streams)))) {
                 throw std::runtime_error(
-                    "post example could not set custom handling for "
-                    "interruption signal");
+                    "post example could not set http/2 multiplexing");
+            }
+        }
+
+
+        notifier(const notifier &) = delete;
+        notifier &operator=(const notifier &) = delete;
+
+
+        /**
+         * @brief      Destroys the object.
+         */
+        ~notifier() noexcept {
+            if (submission_fd != -1) { ::close(submission_fd); }
+        }
+
+      public:
+        /**
+         * @brief      Passes a request to the running notifier. May be called
+         * from any thread, the request is taken by run() (which is woken up
+         * at once) and goes through the same steps as a line of stdin.
+         * Producers never wait for each other. Fails if
+         * notifier_options::submission_capacity is 0.
+         *
+         * @param      body  The request (moved from only if it is queued)
+         *
+         * @return     False iff the queue is full (or there is none)
+         */
+        auto enqueue(std::string &&body) -> bool {
+            if (!submissions || !submissions->push(std::move(body))) {
+                return false;
+            }
+            wake();
+            return true;
+        }
+
+
+        /**
+         * @brief      Passes requests to the running notifier in order until
+         * the queue is full (see enqueue(std::string &&)). The loop is woken
+         * up once.
+         *
+         * @param      batch  The requests (queued ones are moved from)
+         *
+         * @return     Number of queued requests (a prefix of batch)
+         */
+        auto enqueue(std::span<std::string> batch) -> size_t {
+            if (!submissions) { return 0; }
+            size_t queued{0};
+            while (queued < batch.size() &&
+                   submissions->push(std::move(batch[queued]))) {
+                ++queued;
+            }
+            if (queued > 0) { wake(); }
+            return queued;
+        }
+
+
+        /**
+         * @brief      Stops run() of this notifier like the interruption
+         * signal does: no new posts are started, run() returns once the posts
+         * in flight are completed (queued ones and retries are not sent). May
+         * be called from any thread. The flag is cleared once run() returns,
+         * so the notifier may run again.
+         *
+         * @return     void
+         */
+        auto stop() {
+            stopping.store(true, std::memory_order_relaxed);
+            if (submissions) {
+                wakeup_pending.store(false);
+                wake();
             }
         }
 
@@ -256,9 +1511,11 @@ namespace cppurl {
       public:
         /**
          * @brief      Runs an application. Every iteration of the loop launches
-         * transfers, handles completed transfers (if any) and if there is high
-         * time for new data reads it from stdin. Runs until interuption signal
-         * SIGINT is received.
+         * transfers, handles completed transfers (if any) and reads new data
+         * from stdin as soon as it arrives (stdin is watched together with
+         * transfer sockets). After end of stdin is reached, it is checked
+         * again for new data every time_for_new_data. Runs until interuption
+         * signal SIGINT is received.
          *
          * @param      on_successful_transfer    Function to be launched on
          * successful transfer. It must be of the form [](cppurl::handle_info
@@ -275,26 +1532,58 @@ namespace cppurl {
          */
         [[nodiscard]] auto run(auto &&on_successful_transfer,
                                auto &&on_unsuccessful_transfer) -> status {
+            if (spool && !shard) {
+                spool->replay([this](spool::ticket ticket,
+                                     std::string_view req,
+                                     spool::clock_type::time_point appended) {
+                    dispatch(arena.append(req), ticket, appended);
+                });
+            }
             FORWARD_ERROR(add_post_requests());
             std::expected<int, status> ready_handles{0};
             _timer.tick();
             do {
-                FORWARD_UNEXPECTED(mhandle.perform());
+                FORWARD_ERROR(perform_transfers());
                 ready_handles = handle_finished_transfers(
                     on_successful_transfer, on_unsuccessful_transfer);
                 FORWARD_UNEXPECTED(ready_handles);
-                _timer.tock();
-                if (_timer.duration<std::chrono::milliseconds>() >=
-                    time_for_new_data) {
-                    FORWARD_ERROR(add_post_requests());
-                    _timer.tick();
+                if (reader && reader->eof()) {
+                    _timer.tock();
+                    if (_timer.duration<std::chrono::milliseconds>() >=
+                        time_for_new_data) {
+                        reader->resume();
+                        _timer.tick();
+                    }
                 }
-                FORWARD_UNEXPECTED(mhandle.wait(poll_wait_time));
-            } while (!::should_stop ||
+                if (!stopped()) { FORWARD_ERROR(add_post_requests()); }
+                FORWARD_ERROR(commit_spool(false));
+                publish_queued();
+                pool.trim();
+                FORWARD_ERROR(wait_for_events());
+            } while (!stopped() || pool.in_use() > 0 ||
                      (ready_handles && ready_handles.value() > 0));
+            if (metrics) { metrics->add_queued(-published_queued); }
+            published_queued = 0;
+            stopping.store(false, std::memory_order_relaxed);
+
+            return commit_spool(true);
+        }
 
 
-            return cppurl::status<ffor::multi>{CURLM_OK};
+        /**
+         * @brief      Counters of transfers, requests, the queue (including
+         * its priority lanes) and the spool.
+         */
+        auto stats() const -> notifier_stats {
+            auto s{_stats};
+            if (reader) { s.requests.oversized += reader->oversized(); }
+            for (auto &d : destinations) {
+                auto lanes{d.requests.lane_counters()};
+                for (size_t i{0}; i < lanes.size(); ++i) {
+                    s.queue.lanes[i] += lanes[i];
+                }
+            }
+            return s;
         }
     };
 
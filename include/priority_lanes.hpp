@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <queue>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Priority lanes of queued requests and their time to live.
+     * With prefix set, every request line starts with
+     * "lane[+ttl|@deadline]<TAB>", e.g. "0+5000<TAB>body" is queued in the
+     * first lane and expires 5 s after it was read, "2@1760000000000<TAB>body"
+     * expires at the given unix time in milliseconds. Lines without such a
+     * prefix go to the last lane.
+     */
+    struct priority_options {
+        /*number of lanes (lane 0 is served first), at most max_lanes*/
+        size_t lanes{1};
+        /*time to live of requests which do not set one (0 means they never
+         * expire)*/
+        std::chrono::milliseconds ttl{0};
+        /*parse the priority prefix of request lines*/
+        bool prefix{false};
+    };
+
+
+    /**
+     * @brief      Counters of a single lane.
+     */
+    struct lane_stats {
+        uint64_t enqueued{0};
+        uint64_t sent{0};
+        /*requests which reached their deadline before being sent*/
+        uint64_t expired{0};
+        /*requests dropped by drop oldest overflow policy*/
+        uint64_t dropped{0};
+
+        auto &operator+=(const lane_stats &other) {
+            enqueued += other.enqueued;
+            sent += other.sent;
+            expired += other.expired;
+            dropped += other.dropped;
+            return *this;
+        }
+    };
+
+
+    /*upper bound on the number of lanes*/
+    inline constexpr size_t max_lanes{8};
+
+
+    using lanes_stats = std::array<lane_stats, max_lanes>;
+
+
+    /**
+     * @brief      Lane and deadline of a single request.
+     */
+    struct priority {
+        using clock_type = std::chrono::steady_clock;
+
+        size_t lane{0};
+        clock_type::time_point deadline{clock_type::time_point::max()};
+
+
+        /**
+         * @brief      Parses the priority prefix of a request line (see
+         * priority_options).
+         *
+         * @param[in]  line      The line
+         * @param[in]  options   The options
+         * @param[in]  enqueued  Time the line was read (ttl is counted from
+         * it)
+         *
+         * @return     The priority and the size of the prefix (0 if there is
+         * none)
+         */
+        static auto parse(std::string_view line,
+                          const priority_options &options,
+                          clock_type::time_point enqueued)
+            -> std::pair<priority, size_t> {
+            auto last{std::clamp<size_t>(options.lanes, 1, max_lanes) - 1};
+            priority p{.lane = last};
+            if (options.ttl.count() > 0) {
+                p.deadline = enqueued + options.ttl;
+            }
+            if (!options.prefix) { return {p, 0}; }
+            auto end{line.data() + line.size()};
+            size_t lane{};
+            auto [at, ec] = std::from_chars(line.data(), end, lane);
+            if (ec != std::errc{} || at == end) { return {p, 0}; }
+            /*a malformed prefix keeps the default deadline*/
+            auto deadline{p.deadline};
+            if (*at == '+' || *at == '@') {
+                int64_t ms{};
+                auto kind{*at};
+                auto [next, e] = std::from_chars(at + 1, end, ms);
+                if (e != std::errc{} || next == end) { return {p, 0}; }
+                at = next;
+                if (kind == '+') {
+                    deadline = enqueued + std::chrono::milliseconds{ms};
+                } else {
+                    /*unix time is moved onto the steady clock*/
+                    std::chrono::sys_time<std::chrono::milliseconds> wall{
+                        std::chrono::milliseconds{ms}};
+                    deadline =
+                        enqueued + (wall - std::chrono::system_clock::now());
+                }
+            }
+            if (*at != '\t') { return {p, 0}; }
+            p.lane = std::min(lane, last);
+            p.deadline = deadline;
+            return {p, static_cast<size_t>(at + 1 - line.data())};
+        }
+    };
+
+
+    /**
+     * @brief      Multi-level queue. Every lane is a FIFO queue, the front of
+     * the first non-empty lane is served first. Expired requests are not
+     * searched for, they are dropped by the owner once they reach the front
+     * (see expired and expire). T must have members enqueued and deadline.
+     *
+     * @tparam     T     Type of queued requests
+     */
+    template <typename T>
+    class priority_lanes {
+      public:
+        using clock_type = priority::clock_type;
+
+      private:
+        std::vector<std::queue<T>> _lanes{};
+        std::vector<lane_stats> _stats{};
+        size_t _size{0};
+
+      private:
+        /**
+         * @brief      Index of the first non-empty lane. There must be one.
+         */
+        auto first() const -> size_t {
+            size_t i{0};
+            while (_lanes[i].empty()) { ++i; }
+            return i;
+        }
+
+
+        /**
+         * @brief      Pops the front of a lane.
+         *
+         * @param[in]  lane  The lane
+         *
+         * @return     The request
+         */
+        auto take(size_t lane) -> T {
+            auto req{std::move(_lanes[lane].front())};
+            _lanes[lane].pop();
+            --_size;
+            return req;
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  lanes  Number of lanes (clamped to 1..max_lanes)
+         */
+        explicit priority_lanes(size_t lanes = 1)
+            : _lanes(std::clamp<size_t>(lanes, 1, max_lanes)),
+              _stats(_lanes.size()) {}
+
+      public:
+        /**
+         * @brief      Adds a request to the back of a lane (the last one if
+         * lane is out of range).
+         *
+         * @param[in]  lane  The lane
+         * @param      req   The request
+         *
+         * @return     void
+         */
+        auto push(size_t lane, T req) {
+            lane = std::min(lane, _lanes.size() - 1);
+            _lanes[lane].push(std::move(req));
+            ++_stats[lane].enqueued;
+            ++_size;
+        }
+
+
+        /**
+         * @brief      The request served next. There must be some.
+         */
+        auto front() const -> const T & { return _lanes[first()].front(); }
+
+
+        /**
+         * @brief      True iff the request served next reached its deadline.
+         * There must be some.
+         *
+         * @param[in]  now   The current time
+         */
+        auto expired(clock_type::time_point now) const -> bool {
+            return front().deadline <= now;
+        }
+
+
+        /**
+         * @brief      Pops the request served next to send it. There must be
+         * some.
+         *
+         * @return     The request
+         */
+        auto pop() -> T {
+            auto lane{first()};
+            ++_stats[lane].sent;
+            return take(lane);
+        }
+
+
+        /**
+         * @brief      Pops the request served next since it expired. There
+         * must be some.
+         *
+         * @return     The request
+         */
+        auto expire() -> T {
+            auto lane{first()};
+            ++_stats[lane].expired;
+            return take(lane);
+        }
+
+
+        /**
+         * @brief      Pops the oldest request of the last non-empty lane to
+         * make room for new ones. There must be some.
+         *
+         * @return     The request
+         */
+        auto drop() -> T {
+            auto lane{_lanes.size() - 1};
+            while (_lanes[lane].empty()) { --lane; }
+            ++_stats[lane].dropped;
+            return take(lane);
+        }
+
+
+        /**
+         * @brief      Time the oldest request of all lanes was enqueued.
+         * There must be some.
+         */
+        auto oldest() const -> clock_type::time_point {
+            auto t{clock_type::time_point::max()};
+            for (auto &l : _lanes) {
+                if (!l.empty()) { t = std::min(t, l.front().enqueued); }
+            }
+            return t;
+        }
+
+
+        /**
+         * @brief      Counters of every lane.
+         */
+        auto stats() const -> std::span<const lane_stats> { return _stats; }
+
+
+        /**
+         * @brief      Number of queued requests.
+         */
+        auto size() const { return _size; }
+
+
+        /**
+         * @brief      True iff there is no queued request.
+         */
+        auto empty() const { return _size == 0; }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Limits of outgoing posts. A rate of 0 disables the
+     * corresponding limit, a burst of 0 means one second worth of tokens.
+     */
+    struct rate_options {
+        /*posts per second*/
+        double requests_per_second{0};
+        /*posted body bytes per second*/
+        double bytes_per_second{0};
+        /*posts which can be sent at once after an idle period*/
+        double burst_requests{0};
+        /*bytes which can be sent at once after an idle period*/
+        double burst_bytes{0};
+    };
+
+
+    /**
+     * @brief      Token bucket refilled continuously with rate tokens per
+     * second up to its capacity. Tokens may be taken in debt (the bucket
+     * goes below zero), which is used for bytes, since the size of a batch
+     * is known only after it is packed.
+     */
+    class token_bucket {
+      public:
+        using clock_type = std::chrono::steady_clock;
+
+      private:
+        double _rate{0};
+        double _capacity{0};
+        double _tokens{0};
+        clock_type::time_point _last{clock_type::now()};
+
+      private:
+        /**
+         * @brief      Adds tokens accumulated since the last refill.
+         *
+         * @return     void
+         */
+        auto refill(clock_type::time_point now) {
+            std::chrono::duration<double> elapsed{now - _last};
+            _tokens = std::min(_capacity, _tokens + elapsed.count() * _rate);
+            _last = now;
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance (unlimited if rate is 0).
+         *
+         * @param[in]  rate   Tokens per second
+         * @param[in]  burst  Capacity of the bucket (rate if 0, at least 1)
+         */
+        explicit token_bucket(double rate = 0, double burst = 0)
+            : _rate{std::max(rate, 0.0)},
+              _capacity{std::max(burst > 0 ? burst : _rate, 1.0)},
+              _tokens{_capacity} {}
+
+      public:
+        /**
+         * @brief      True iff the bucket does not limit anything.
+         */
+        auto unlimited() const -> bool { return _rate <= 0; }
+
+
+        /**
+         * @brief      Time left until the bucket holds at least n tokens.
+         *
+         * @param[in]  n     Number of tokens
+         *
+         * @return     Milliseconds to wait (0 if they are available now)
+         */
+        auto wait_time(double n = 1) -> int {
+            if (unlimited()) { return 0; }
+            refill(clock_type::now());
+            auto missing{std::min(n, _capacity) - _tokens};
+            if (missing <= 0) { return 0; }
+            return static_cast<int>(std::ceil(missing / _rate * 1000));
+        }
+
+
+        /**
+         * @brief      Takes n tokens, possibly going into debt.
+         *
+         * @param[in]  n     Number of tokens
+         *
+         * @return     void
+         */
+        auto consume(double n) {
+            if (unlimited()) { return; }
+            refill(clock_type::now());
+            _tokens -= n;
+        }
+    };
+
+
+    /**
+     * @brief      Limits posts per second and posted bytes per second with two
+     * token buckets. A post is allowed when a request token is available and
+     * the byte bucket is not in debt, its bytes are charged after it is sent.
+     */
+    class rate_limiter {
+      private:
+        token_bucket _requests;
+        token_bucket _bytes;
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The limits
+         */
+        explicit rate_limiter(rate_options options = {})
+            : _requests{options.requests_per_second, options.burst_requests},
+              _bytes{options.bytes_per_second, options.burst_bytes} {}
+
+      public:
+        /**
+         * @brief      Time left until the next post is allowed.
+         *
+         * @return     Milliseconds to wait (0 if it is allowed now)
+         */
+        auto wait_time() -> int {
+            /*tokens of an empty byte bucket are taken by the next post*/
+            return std::max(_requests.wait_time(1), _bytes.wait_time(0));
+        }
+
+
+        /**
+         * @brief      True iff a post can be sent now.
+         */
+        auto ready() -> bool { return wait_time() == 0; }
+
+
+        /**
+         * @brief      Charges a sent post.
+         *
+         * @param[in]  bytes  Size of its body
+         *
+         * @return     void
+         */
+        auto consume(size_t bytes) {
+            _requests.consume(1);
+            _bytes.consume(static_cast<double>(bytes));
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Chunked arena for request bodies. Bodies are appended to the
+     * current chunk and handed out as reference counted views, so they can be
+     * posted without copying (post<false>). A chunk is freed when the arena
+     * has moved on to the next chunk and the last view into it is released.
+     * If every view into the current chunk is released, it is reused from the
+     * beginning. Only one thread may append, views may be released from any
+     * thread.
+     */
+    class request_arena {
+      public:
+        static constexpr size_t default_chunk_size{1024 * 1024};
+
+      private:
+        /**
+         * @brief      Single chunk. The arena itself holds one reference to
+         * its current chunk.
+         */
+        struct chunk {
+            std::atomic<size_t> references{1};
+            size_t used{0};
+            size_t capacity{};
+            std::unique_ptr<char[]> data{};
+
+            explicit chunk(size_t capacity)
+                : capacity{capacity},
+                  data{std::make_unique_for_overwrite<char[]>(capacity)} {}
+        };
+
+
+        /**
+         * @brief      Drops a reference to the chunk and frees it if it was
+         * the last one.
+         *
+         * @param      c     The chunk
+         *
+         * @return     void
+         */
+        static auto release(chunk *c) {
+            if (c->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete c;
+            }
+        }
+
+      public:
+        /**
+         * @brief      View onto a body stored in the arena. Keeps its chunk
+         * alive.
+         */
+        class ref {
+            friend request_arena;
+
+          private:
+            chunk *_chunk{nullptr};
+            std::string_view _body{};
+
+          private:
+            /**
+             * @brief      Constructs a new instance. The reference count of c
+             * must be already incremented.
+             *
+             * @param      c     The chunk
+             * @param[in]  body  The body stored in c
+             */
+            ref(chunk *c, std::string_view body) : _chunk{c}, _body{body} {}
+
+          public:
+            ref() = default;
+
+
+            ref(const ref &) = delete;
+            ref &operator=(const ref &) = delete;
+
+
+            ref(ref &&other) noexcept
+                : _chunk{std::exchange(other._chunk, nullptr)},
+                  _body{std::exchange(other._body, {})} {}
+
+
+            ref &operator=(ref &&other) noexcept {
+                if (this != &other) {
+                    reset();
+                    _chunk = std::exchange(other._chunk, nullptr);
+                    _body = std::exchange(other._body, {});
+                }
+                return *this;
+            }
+
+
+            /**
+             * @brief      Destroys the object and releases the chunk.
+             */
+            ~ref() noexcept { reset(); }
+
+          public:
+            /**
+             * @brief      Releases the chunk (if any).
+             *
+             * @return     void
+             */
+            auto reset() -> void {
+                if (_chunk) { release(std::exchange(_chunk, nullptr)); }
+                _body = {};
+            }
+
+
+            /**
+             * @brief      The body.
+             */
+            auto body() const -> std::string_view { return _body; }
+
+
+            /**
+             * @brief      Drops first n characters of the body (e.g. a routing
+             * key). The chunk is kept alive as a whole.
+             *
+             * @param[in]  n     Number of characters
+             *
+             * @return     void
+             */
+            auto remove_prefix(size_t n) {
+                _body.remove_prefix(std::min(n, _body.size()));
+            }
+
+
+            /**
+             * @brief      True iff this view refers to some chunk (false for
+             * views made by request_arena::view).
+             */
+            operator bool() const { return _chunk != nullptr; }
+        };
+
+      private:
+        size_t _chunk_size{default_chunk_size};
+        chunk *_current{nullptr};
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  chunk_size  Size of a single chunk (bigger bodies get a
+         * chunk of their own)
+         */
+        explicit request_arena(size_t chunk_size = default_chunk_size)
+            : _chunk_size{std::max(chunk_size, size_t{1})} {}
+
+
+        request_arena(const request_arena &) = delete;
+        request_arena &operator=(const request_arena &) = delete;
+
+
+        /**
+         * @brief      Destroys the object. Chunks still referenced by views
+         * live until the views are released.
+         */
+        ~request_arena() noexcept {
+            if (_current) { release(_current); }
+        }
+
+      public:
+        /**
+         * @brief      View onto a body which is not stored in any arena (e.g.
+         * in a mapped_input). Nothing is kept alive by the view, thus the
+         * body must outlive it.
+         *
+         * @param[in]  body  The body
+         *
+         * @return     The view
+         */
+        static auto view(std::string_view body) -> ref {
+            return ref{nullptr, body};
+        }
+
+
+        /**
+         * @brief      Writes a body of a known size straight into the arena
+         * (e.g. a rendered template), so it is not copied from a buffer.
+         *
+         * @param[in]  size   Size of the body
+         * @param      write  Function of the form [](char *data) which writes
+         * exactly size characters to data
+         *
+         * @return     View onto the stored body
+         */
+        auto append(size_t size, auto &&write) -> ref {
+            if (_current &&
+                _current->references.load(std::memory_order_acquire) == 1) {
+                _current->used = 0;
+            }
+            if (!_current || _current->capacity - _current->used < size) {
+                if (_current) { release(std::exchange(_current, nullptr)); }
+                _current = new chunk{std::max(_chunk_size, size)};
+            }
+            auto data{_current->data.get() + _current->used};
+            write(data);
+            _current->used += size;
+            _current->references.fetch_add(1, std::memory_order_relaxed);
+            return ref{_current, std::string_view{data, size}};
+        }
+
+
+        /**
+         * @brief      Copies body into the arena.
+         *
+         * @param[in]  body  The body
+         *
+         * @return     View onto the stored body
+         */
+        auto append(std::string_view body) -> ref {
+            return append(body.size(), [body](char *data) {
+                std::memcpy(data, body.data(), body.size());
+            });
+        }
+    };
+
+
+}  // namespace cppurl
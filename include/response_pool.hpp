@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Pool of buffers for captured response bodies. A handle takes
+     * a buffer once its response starts to arrive and gives it back after
+     * the transfer is reported, so the number of buffers follows the number
+     * of transfers in flight rather than the number of handles. Buffers keep
+     * their capacity, thus once the pool is warmed up capturing does not
+     * allocate. Not thread safe (every notifier has its own pool).
+     */
+    class response_pool {
+      private:
+        size_t _max_size{};
+        std::vector<std::string> _free{};
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  max_size  Maximal captured size of a single response
+         * (longer responses are truncated)
+         */
+        explicit response_pool(size_t max_size) : _max_size{max_size} {}
+
+
+        response_pool(const response_pool &) = delete;
+        response_pool &operator=(const response_pool &) = delete;
+
+      public:
+        /**
+         * @brief      Takes an empty buffer from the pool.
+         *
+         * @return     The buffer
+         */
+        auto acquire() -> std::string {
+            if (_free.empty()) { return {}; }
+            auto buffer{std::move(_free.back())};
+            _free.pop_back();
+            return buffer;
+        }
+
+
+        /**
+         * @brief      Gives a buffer back to the pool.
+         *
+         * @param      buffer  The buffer
+         *
+         * @return     void
+         */
+        auto release(std::string &&buffer) {
+            buffer.clear();
+            _free.push_back(std::move(buffer));
+        }
+
+
+        /**
+         * @brief      Appends data to a buffer up to the maximal size.
+         *
+         * @param      buffer  The buffer
+         * @param[in]  data    The data
+         *
+         * @return     void
+         */
+        auto append(std::string &buffer, std::string_view data) const {
+            if (buffer.size() >= _max_size) { return; }
+            buffer.append(data.substr(0, _max_size - buffer.size()));
+        }
+
+
+        /**
+         * @brief      Maximal captured size of a single response.
+         */
+        auto max_size() const { return _max_size; }
+    };
+
+
+}  // namespace cppurl
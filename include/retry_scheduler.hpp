@@ -0,0 +1,223 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <random>
+#include <request_arena.hpp>
+#include <span>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Settings of retries of failed transfers.
+     */
+    struct retry_options {
+        /*maximal number of retries of a single body (0 disables retries)*/
+        size_t max_retries{0};
+        /*delay before the first retry, doubled with every next one*/
+        std::chrono::milliseconds base_delay{100};
+        /*upper bound on a single delay (Retry-After may exceed it)*/
+        std::chrono::milliseconds max_delay{30000};
+    };
+
+
+    /**
+     * @brief      Bodies of failed transfers waiting for their next attempt.
+     * Delays grow exponentially with full jitter (uniform in [0, base * 2^n]),
+     * Retry-After sent by the receiver is a lower bound of the delay.
+     */
+    class retry_scheduler {
+      public:
+        using clock_type = std::chrono::steady_clock;
+
+
+        /**
+         * @brief      Body waiting for a retry.
+         */
+        struct entry {
+            clock_type::time_point due{};
+            request_arena::ref body{};
+            size_t items{0};
+            size_t attempt{0};
+            std::vector<uint64_t> tickets{};
+            /*time the oldest packed request was enqueued*/
+            clock_type::time_point enqueued{};
+        };
+
+      private:
+        retry_options _options{};
+        std::vector<entry> _heap{};
+        size_t _items{0};
+        size_t _bytes{0};
+        std::minstd_rand _random{std::random_device{}()};
+
+      private:
+        /**
+         * @brief      Heap order, the earliest entry on top.
+         */
+        static auto later(const entry &a, const entry &b) -> bool {
+            return a.due > b.due;
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  options  The options
+         */
+        explicit retry_scheduler(retry_options options = {})
+            : _options{options} {}
+
+      public:
+        /**
+         * @brief      Checks if a transfer failed in a way which is worth
+         * retrying (network errors, timeouts, http 408, 429 and 5xx).
+         *
+         * @param[in]  code           The curl result of the transfer
+         * @param[in]  response_code  The http response code (0 if none)
+         *
+         * @return     True iff the transfer should be retried
+         */
+        static auto retryable(CURLcode code, long response_code) -> bool {
+            switch (code) {
+                case CURLE_OK:
+                    return response_code == 408 || response_code == 429 ||
+                           (response_code >= 500 && response_code != 501 &&
+                            response_code != 505 && response_code < 600);
+                case CURLE_COULDNT_RESOLVE_HOST:
+                case CURLE_COULDNT_CONNECT:
+                case CURLE_OPERATION_TIMEDOUT:
+                case CURLE_SEND_ERROR:
+                case CURLE_RECV_ERROR:
+                case CURLE_GOT_NOTHING:
+                case CURLE_PARTIAL_FILE:
+                case CURLE_HTTP2:
+                case CURLE_HTTP2_STREAM:
+                case CURLE_SSL_CONNECT_ERROR:
+                case CURLE_AGAIN:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+
+        /**
+         * @brief      Checks if a body may be retried once more.
+         *
+         * @param[in]  attempt  Number of the failed attempt (0 for the first
+         * one)
+         *
+         * @return     True iff attempt < max_retries
+         */
+        auto can_retry(size_t attempt) const -> bool {
+            return attempt < _options.max_retries;
+        }
+
+
+        /**
+         * @brief      Schedules the next attempt of a body. There must be
+         * can_retry(attempt).
+         *
+         * @param      body         The body
+         * @param[in]  items        Number of requests packed into body
+         * @param[in]  attempt      Number of the failed attempt (0 for the
+         * first one)
+         * @param[in]  tickets      Tickets of the packed requests (copied)
+         * @param[in]  enqueued     Time the oldest packed request was
+         * enqueued
+         * @param[in]  retry_after  Delay requested by the receiver (0 if none)
+         *
+         * @return     void
+         */
+        auto schedule(request_arena::ref body,
+                      size_t items,
+                      size_t attempt,
+                      std::span<const uint64_t> tickets,
+                      clock_type::time_point enqueued,
+                      std::chrono::seconds retry_after = {}) -> void {
+            assert(can_retry(attempt));
+            auto ceiling{_options.max_delay};
+            if (attempt < 32) {
+                ceiling = std::min<std::chrono::milliseconds>(
+                    ceiling, _options.base_delay * (1ll << attempt));
+            }
+            std::uniform_int_distribution<std::chrono::milliseconds::rep>
+                jitter{0, ceiling.count()};
+            auto delay{std::max<clock_type::duration>(
+                std::chrono::milliseconds{jitter(_random)}, retry_after)};
+            _heap.push_back({clock_type::now() + delay,
+                             std::move(body),
+                             items,
+                             attempt + 1,
+                             {tickets.begin(), tickets.end()},
+                             enqueued});
+            _items += items;
+            _bytes += _heap.back().body.body().size();
+            std::ranges::push_heap(_heap, later);
+        }
+
+
+        /**
+         * @brief      True iff some body is due.
+         */
+        auto ready() const -> bool {
+            return !_heap.empty() && _heap.front().due <= clock_type::now();
+        }
+
+
+        /**
+         * @brief      Takes the earliest body. There must be some.
+         *
+         * @return     The entry
+         */
+        auto pop() -> entry {
+            std::ranges::pop_heap(_heap, later);
+            auto e{std::move(_heap.back())};
+            _heap.pop_back();
+            _items -= e.items;
+            _bytes -= e.body.body().size();
+            return e;
+        }
+
+
+        /**
+         * @brief      Time left until the earliest body is due.
+         *
+         * @return     Milliseconds to wait (-1 if there is nothing to wait
+         * for)
+         */
+        auto wait_time() const -> int {
+            if (_heap.empty()) { return -1; }
+            auto left{std::chrono::ceil<std::chrono::milliseconds>(
+                _heap.front().due - clock_type::now())};
+            return std::max(static_cast<int>(left.count()), 0);
+        }
+
+
+        /**
+         * @brief      Number of bodies waiting for a retry.
+         */
+        auto size() const { return _heap.size(); }
+
+
+        /**
+         * @brief      Number of requests packed into waiting bodies.
+         */
+        auto items() const { return _items; }
+
+
+        /**
+         * @brief      Size of waiting bodies in bytes.
+         */
+        auto bytes() const { return _bytes; }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <format>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Table of destinations. A request line of the form
+     * "key<TAB>body" is posted to the url of key (the body only). The table is
+     * loaded from a file with one "key url" pair per line (empty lines and
+     * lines starting with '#' are skipped).
+     */
+    class route_table {
+      public:
+        static constexpr char separator{'\t'};
+
+      private:
+        std::vector<std::string> _urls{};
+        std::map<std::string, size_t, std::less<>> _keys{};
+
+      public:
+        route_table() = default;
+
+
+        /**
+         * @brief      Constructs a new instance from a file. Throws if the
+         * file cannot be read or some line is malformed.
+         *
+         * @param[in]  path  Path to the file
+         */
+        explicit route_table(const std::string &path) {
+            std::ifstream file{path};
+            if (!file) {
+                throw std::runtime_error{
+                    std::format("could not open routes file {}", path)};
+            }
+            std::string line{};
+            for (size_t number{1}; std::getline(file, line); ++number) {
+                std::string_view l{line};
+                auto begin{l.find_first_not_of(" \t\r")};
+                if (begin == l.npos || l[begin] == '#') { continue; }
+                l = l.substr(begin, l.find_last_not_of(" \t\r") + 1 - begin);
+                auto end_of_key{l.find_first_of(" \t")};
+                auto url_begin{l.find_first_not_of(" \t", end_of_key)};
+                if (end_of_key == l.npos || url_begin == l.npos ||
+                    !add(l.substr(0, end_of_key), l.substr(url_begin))) {
+                    throw std::runtime_error{std::format(
+                        "malformed or duplicated route in {}:{}",
+                        path,
+                        number)};
+                }
+            }
+        }
+
+      public:
+        /**
+         * @brief      Adds a destination.
+         *
+         * @param[in]  key   The key
+         * @param[in]  url   The url
+         *
+         * @return     False iff the key is already present
+         */
+        auto add(std::string_view key, std::string_view url) -> bool {
+            if (!_keys.try_emplace(std::string{key}, _urls.size()).second) {
+                return false;
+            }
+            _urls.emplace_back(url);
+            return true;
+        }
+
+
+        /**
+         * @brief      Index of the destination of key.
+         *
+         * @param[in]  key   The key
+         *
+         * @return     The index (std::nullopt for unknown keys)
+         */
+        auto find(std::string_view key) const -> std::optional<size_t> {
+            if (auto it{_keys.find(key)}; it != _keys.end()) {
+                return it->second;
+            }
+            return std::nullopt;
+        }
+
+
+        /**
+         * @brief      Url of the i-th destination.
+         */
+        auto url(size_t i) const -> std::string_view { return _urls[i]; }
+
+
+        /**
+         * @brief      Number of destinations.
+         */
+        auto size() const { return _urls.size(); }
+
+
+        /**
+         * @brief      Splits a request line into its key and body.
+         *
+         * @param[in]  line  The line
+         *
+         * @return     The key and the body (the key is empty and the body is
+         * the whole line if there is no separator)
+         */
+        static auto split(std::string_view line)
+            -> std::pair<std::string_view, std::string_view> {
+            auto at{line.find(separator)};
+            if (at == line.npos) { return {{}, line}; }
+            return {line.substr(0, at), line.substr(at + 1)};
+        }
+    };
+
+
+}  // namespace cppurl
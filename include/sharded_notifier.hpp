@@ -0,0 +1,500 @@
+#pragma once
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+#include <exception>
+#include <notifier.hpp>
+#include <thread>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Settings of the sharded notifier.
+     */
+    struct sharding_options {
+        /*number of shards (worker threads), each with its own multi handle
+         * and handle pool*/
+        size_t threads{1};
+        /*pin shard i to core i % std::thread::hardware_concurrency()*/
+        bool pin_threads{false};
+    };
+
+
+    /**
+     * @brief      Notifier spread over several worker threads. The calling
+     * thread reads stdin (or the mapped input), strips the priority prefix
+     * off every request and pushes it to the work stealing queue of its lane,
+     * every shard runs its own notifier which takes requests from the queues
+     * in order of lanes (and steals them from other shards once its own deque
+     * is empty). Shards share DNS cache and TLS sessions. If there is a
+     * spool, the calling thread appends to it and commits it, shards
+     * acknowledge their requests. Watermarks of backpressure_options apply
+     * to the shared queue.
+     */
+    class sharded_notifier : public app<sharded_notifier> {
+      private:
+        static constexpr int poll_wait_time{100};
+        /*sleep while the queue is full (block policy)*/
+        static constexpr int paused_wait_time{10};
+        /*sleep while shards have enough requests of the mapped input*/
+        static constexpr int input_wait_time{1};
+
+      private:
+        std::string_view url{};
+        const std::chrono::seconds time_for_new_data{1};
+        /*DNS cache and TLS sessions shared by all shards*/
+        share_handle share{};
+        sharding_options sharding{};
+        notifier_options options{};
+        prioritized_work_queue<queued_request> queue;
+        /*size of bodies in the queue*/
+        std::atomic<size_t> queued_bytes{0};
+        /*bodies read by the calling thread*/
+        request_arena arena{};
+        watermarks queue_limits;
+        std::optional<deduplicator> dedup{};
+        /*deque from which the next request is evicted (drop oldest)*/
+        size_t next_eviction{0};
+        /*size of the queue last added to metrics*/
+        int64_t published_queued{0};
+        std::vector<int> wakeup_fds{};
+        /*some commit of the spool failed during run*/
+        bool spool_failed{false};
+        /*error of stdin which ended the run*/
+        b_status read_status{CURLE_OK};
+        /*stops all shards (if one of them failed)*/
+        std::atomic<bool> stopping{false};
+        notifier_stats _stats{};
+
+      private:
+        /**
+         * @brief      Wakes up all shards.
+         *
+         * @return     void
+         */
+        auto wake_shards() {
+            uint64_t one{1};
+            for (auto fd : wakeup_fds) {
+                [[maybe_unused]] auto _{::write(fd, &one, sizeof(one))};
+            }
+        }
+
+
+        /**
+         * @brief      Pins a thread to a core.
+         *
+         * @param      thread  The thread
+         * @param[in]  index   Index of the shard
+         *
+         * @return     void
+         */
+        static auto pin(std::thread &thread, size_t index) {
+            auto cores{std::max(std::thread::hardware_concurrency(), 1u)};
+            cpu_set_t set{};
+            CPU_ZERO(&set);
+            CPU_SET(index % cores, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+        }
+
+
+        /**
+         * @brief      Time to wait for stdin, shortened to the next commit of
+         * the spool.
+         */
+        auto wait_time() const -> int {
+            auto sync{options.spool ? options.spool->wait_time() : -1};
+            return sync >= 0 ? std::min(sync, poll_wait_time) : poll_wait_time;
+        }
+
+
+        /**
+         * @brief      Flushes the spool (if any). If it could not be flushed,
+         * all shards are stopped, since requests would not survive a crash.
+         *
+         * @param[in]  force  Commit even if the sync interval did not elapse
+         *
+         * @return     void
+         */
+        auto commit_spool(bool force = false) {
+            auto spool{options.spool};
+            if (!spool || (force ? spool->commit() : spool->maybe_commit())) {
+                return;
+            }
+            ++_stats.spool.failed_commits;
+            spool_failed = true;
+            stopping = true;
+        }
+
+
+        /**
+         * @brief      Makes room for a new request if the queue reached its
+         * high watermark and the policy is to drop requests. Drop oldest
+         * evicts requests of the last non-empty lane, from the front of its
+         * deques in turn.
+         *
+         * @return     False iff the new request should be dropped
+         */
+        auto make_room() -> bool {
+            auto policy{queue_limits.overflow()};
+            if (policy == overflow_policy::block) { return true; }
+            while (queue_limits.above_high(
+                queue.size(), queued_bytes.load(std::memory_order_relaxed))) {
+                if (policy == overflow_policy::drop_newest ||
+                    !queue.drop(next_eviction++,
+                                [&](size_t lane, queued_request &&req) {
+                                    queued_bytes.fetch_sub(
+                                        req.body.body().size(),
+                                        std::memory_order_relaxed);
+                                    ++_stats.queue.dropped_oldest;
+                                    ++_stats.queue.lanes[lane].dropped;
+                                    if (options.spool) {
+                                        options.spool->acknowledge(
+                                            {&req.ticket, 1});
+                                    }
+                                })) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+
+        /**
+         * @brief      Checks watermarks of the queue if the policy is to block
+         * the input.
+         *
+         * @return     True iff reading of stdin is paused
+         */
+        auto pause_input() -> bool {
+            if (queue_limits.overflow() != overflow_policy::block) {
+                return false;
+            }
+            if (queue_limits.update(
+                    queue.size(),
+                    queued_bytes.load(std::memory_order_relaxed))) {
+                ++_stats.queue.paused;
+            }
+            return queue_limits.full();
+        }
+
+
+        /**
+         * @brief      Strips the priority prefix (if enabled) off a request
+         * and pushes it to the queue of its lane.
+         *
+         * @param[in]  req       The request
+         * @param[in]  ticket    Its spool ticket
+         * @param[in]  mapped    True iff req points into the mapped input (it
+         * is not copied to the arena)
+         * @param[in]  enqueued  Time the request was read (ttl is counted
+         * from it)
+         *
+         * @return     void
+         */
+        auto push(std::string_view req,
+                  spool::ticket ticket,
+                  bool mapped,
+                  batcher::clock_type::time_point enqueued =
+                      batcher::clock_type::now()) {
+            auto [p, prefix] =
+                priority::parse(req, options.priorities, enqueued);
+            req.remove_prefix(prefix);
+            queued_bytes.fetch_add(req.size(), std::memory_order_relaxed);
+            queue.push(
+                p.lane,
+                {mapped ? request_arena::view(req) : arena.append(req),
+                 ticket,
+                 enqueued,
+                 p});
+        }
+
+
+        /**
+         * @brief      Appends a request to the spool (if any) and pushes it to
+         * the queue, unless it is a repeated one or it is dropped by the
+         * overflow policy.
+         *
+         * @param[in]  req     The request
+         * @param[in]  mapped  True iff req points into the mapped input (it
+         * is not copied to the arena)
+         *
+         * @return     void
+         */
+        auto enqueue(std::string_view req, bool mapped = false) {
+            if (dedup && dedup->duplicate(req)) {
+                ++_stats.requests.suppressed;
+                if (options.metrics) { options.metrics->record_suppressed(); }
+                return;
+            }
+            auto spool{options.spool};
+            auto ticket{spool ? spool->append(req) : spool::no_ticket};
+            if (spool && ticket == spool::no_ticket) {
+                ++_stats.spool.unspooled;
+            }
+            if (!make_room()) {
+                ++_stats.queue.dropped_newest;
+                if (spool) { spool->acknowledge({&ticket, 1}); }
+                return;
+            }
+            push(req, ticket, mapped);
+        }
+
+
+        /**
+         * @brief      Publishes the change of the size of the queue to the
+         * metrics (shards publish their own queues).
+         *
+         * @param[in]  size  The size of the queue
+         *
+         * @return     void
+         */
+        auto publish_queued(size_t size) {
+            if (!options.metrics) { return; }
+            options.metrics->add_queued(static_cast<int64_t>(size) -
+                                        published_queued);
+            published_queued = static_cast<int64_t>(size);
+        }
+
+
+        /**
+         * @brief      Reads stdin and pushes its requests to the queue until
+         * interruption signal SIGINT is received. Stdin is not read while the
+         * queue is full (block policy). After end of stdin is reached, it is
+         * checked again for new data every time_for_new_data. A read error
+         * stops all shards.
+         *
+         * @return     void
+         */
+        auto distribute_stdin() {
+            stdin_reader reader{STDIN_FILENO, options.max_line_size};
+            timer<std::chrono::steady_clock> t{};
+            pollfd stdin_fd{reader.fd(), POLLIN, 0};
+            while (!::should_stop && !stopping) {
+                publish_queued(queue.size());
+                if (pause_input()) {
+                    commit_spool();
+                    ::poll(nullptr, 0, std::min(wait_time(), paused_wait_time));
+                    continue;
+                }
+                auto read{reader.read(
+                    [&](std::string_view req) { enqueue(req); })};
+                if (!read) {
+                    read_status = read.error();
+                    stopping = true;
+                    break;
+                }
+                if (*read > 0) { wake_shards(); }
+                commit_spool();
+                if (!reader.eof()) {
+                    t.tick();
+                    ::poll(&stdin_fd, 1, wait_time());
+                    continue;
+                }
+                ::poll(nullptr, 0, wait_time());
+                t.tock();
+                if (t.duration<std::chrono::milliseconds>() >=
+                    time_for_new_data) {
+                    reader.resume();
+                }
+            }
+            _stats.requests.oversized += reader.oversized();
+        }
+
+
+        /**
+         * @brief      Pushes requests of the mapped input to the queue (as
+         * views into the mapping) until its end and then waits for
+         * interruption signal SIGINT. The queue is kept below what all shards
+         * can launch at once (and below its watermarks with block policy), so
+         * that a big file is not queued as a whole.
+         *
+         * @param      input  The mapped input
+         *
+         * @return     void
+         */
+        auto distribute_input(mapped_input &input) {
+            auto capacity{queue.shards() * options.max_connections *
+                          (options.batching.framing == framing::none
+                               ? size_t{1}
+                               : options.batching.max_items)};
+            while (!::should_stop && !stopping) {
+                auto queued{queue.size()};
+                publish_queued(queued);
+                commit_spool();
+                if (input.eof()) {
+                    ::poll(nullptr, 0, wait_time());
+                } else if (pause_input() || queued >= capacity) {
+                    ::poll(nullptr, 0, std::min(wait_time(), input_wait_time));
+                } else if (input.read(capacity - queued,
+                                      [&](std::string_view req) {
+                                          enqueue(req, true);
+                                      }) > 0) {
+                    wake_shards();
+                }
+            }
+        }
+
+
+        /**
+         * @brief      Distributes requests of stdin or the mapped input among
+         * the shards until interruption signal SIGINT is received. Requests
+         * left in the spool by previous runs go first.
+         *
+         * @return     void
+         */
+        auto distribute() {
+            auto spool{options.spool};
+            if (spool) {
+                spool->replay([&](spool::ticket ticket,
+                                  std::string_view req,
+                                  spool::clock_type::time_point appended) {
+                    push(req, ticket, false, appended);
+                });
+                wake_shards();
+            }
+            if (options.input) {
+                distribute_input(*options.input);
+            } else {
+                distribute_stdin();
+            }
+            wake_shards();
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  url                The destination url
+         * @param[in]  time_for_new_data  After this time we repeatedly check
+         * for new data
+         * @param[in]  sharding           Number of shards and their pinning
+         * @param[in]  options            Settings of every shard
+         */
+        sharded_notifier(std::string_view url,
+                         std::chrono::seconds time_for_new_data,
+                         sharding_options sharding,
+                         notifier_options options = {})
+            : url{url},
+              time_for_new_data{time_for_new_data},
+              sharding{sharding},
+              options{options},
+              queue{sharding.threads, options.priorities.lanes},
+              queue_limits{options.backpressure} {
+            if (!this->options.share) { this->options.share = &share; }
+            if (options.dedup.window.count() > 0) {
+                dedup.emplace(options.dedup);
+            }
+            /*every shard gets an equal part of the rate limits*/
+            auto &rate{this->options.rate};
+            auto parts{static_cast<double>(queue.shards())};
+            rate.requests_per_second /= parts;
+            rate.bytes_per_second /= parts;
+            rate.burst_requests /= parts;
+            rate.burst_bytes /= parts;
+            for (size_t i{0}; i < queue.shards(); ++i) {
+                auto fd{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)};
+                if (fd == -1) {
+                    throw std::runtime_error(
+                        "sharded notifier could not create eventfd");
+                }
+                wakeup_fds.push_back(fd);
+            }
+            if (std::signal(SIGINT, handle_interuption) == SIG_ERR) {
+                throw std::runtime_error(
+                    "sharded notifier could not set custom handling for "
+                    "interruption signal");
+            }
+        }
+
+
+        sharded_notifier(const sharded_notifier &) = delete;
+        sharded_notifier &operator=(const sharded_notifier &) = delete;
+
+
+        /**
+         * @brief      Destroys the object.
+         */
+        ~sharded_notifier() noexcept {
+            for (auto fd : wakeup_fds) { ::close(fd); }
+        }
+
+      public:
+        /**
+         * @brief      Runs all shards and distributes requests among them until
+         * interruption signal SIGINT is received. If any shard fails, all of
+         * them are stopped.
+         *
+         * @param      on_successful_transfer    See notifier::run. Called
+         * concurrently from all shards, thus it must be thread safe.
+         * @param      on_unsuccessful_transfer  See notifier::run. Called
+         * concurrently from all shards, thus it must be thread safe.
+         *
+         * @return     status of the first failed shard, CURLE_READ_ERROR if
+         * stdin could not be read, CURLE_WRITE_ERROR if the spool could not
+         * be flushed or status_ok
+         */
+        [[nodiscard]] auto run(auto &&on_successful_transfer,
+                               auto &&on_unsuccessful_transfer)
+            -> notifier::status {
+            std::vector<notifier::status> statuses(queue.shards(), status_ok);
+            std::vector<std::exception_ptr> exceptions(queue.shards());
+            std::vector<notifier_stats> stats(queue.shards());
+            std::vector<std::thread> shards{};
+            spool_failed = false;
+            read_status = {CURLE_OK};
+            stopping = false;
+            for (size_t i{0}; i < queue.shards(); ++i) {
+                shards.emplace_back([&, i] {
+                    try {
+                        notifier n{url,
+                                   time_for_new_data,
+                                   options,
+                                   shard_link{&queue,
+                                              &queued_bytes,
+                                              i,
+                                              wakeup_fds[i],
+                                              &stopping}};
+                        statuses[i] = n.run(on_successful_transfer,
+                                            on_unsuccessful_transfer);
+                        stats[i] = n.stats();
+                    } catch (...) {
+                        exceptions[i] = std::current_exception();
+                    }
+                    if (!statuses[i] || exceptions[i]) { stopping = true; }
+                });
+                if (sharding.pin_threads) { pin(shards.back(), i); }
+            }
+            distribute();
+            for (auto &shard : shards) { shard.join(); }
+            publish_queued(0);
+            commit_spool(true);
+            for (auto &s : stats) { _stats += s; }
+            for (auto &e : exceptions) {
+                if (e) { std::rethrow_exception(e); }
+            }
+            for (auto s : statuses) {
+                if (!s) { return s; }
+            }
+            if (!read_status) { return read_status; }
+            if (spool_failed) {
+                return cppurl::status<ffor::single>{CURLE_WRITE_ERROR};
+            }
+            return status_ok;
+        }
+
+
+        /**
+         * @brief      Counters of all shards and of the reading thread
+         * (available after run).
+         */
+        auto stats() const -> const notifier_stats & { return _stats; }
+    };
+
+
+}  // namespace cppurl
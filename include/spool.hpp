@@ -0,0 +1,551 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Settings of the spool.
+     */
+    struct spool_options {
+        /*directory of segment files (created if missing)*/
+        std::string directory{};
+        /*size of a single segment file (bigger records get a segment of their
+         * own)*/
+        size_t segment_size{64 * 1024 * 1024};
+        /*appends and acknowledgements are flushed to disk together at most
+         * this often*/
+        std::chrono::milliseconds sync_interval{10};
+    };
+
+
+    /**
+     * @brief      Crash safe log of queued requests. Every request is appended
+     * to a memory mapped segment file when it is read and acknowledged when
+     * its transfer is completed. Segments whose records are all acknowledged
+     * are deleted. Requests which were not acknowledged (because of SIGINT or
+     * a crash) are replayed by the next instance opened on the same
+     * directory, thus every request is delivered at least once. Every record
+     * keeps the wall clock time it was appended, so time to live of replayed
+     * requests is counted from the time they were first read.
+     *
+     * Writes to the mapping survive a crash of the process. To survive a
+     * crash of the machine, they are flushed by commit() (msync, plus
+     * fdatasync and directory fsync for new segments), which groups all
+     * changes made since the previous commit.
+     *
+     * Only one thread may append and commit, acknowledgements may come from
+     * any thread.
+     */
+    class spool {
+      public:
+        using clock_type = std::chrono::steady_clock;
+        /*position of a record: sequence number of its segment and offset*/
+        using ticket = uint64_t;
+        static constexpr ticket no_ticket{0};
+
+      private:
+        enum record_state : uint8_t {
+            empty = 0,
+            pending = 1,
+            acknowledged = 2
+        };
+
+
+        /**
+         * @brief      Header of a record. It is followed by the body and
+         * padding to alignment. A zeroed header marks the end of a segment.
+         */
+        struct record_header {
+            uint32_t size;
+            uint32_t checksum;
+            /*unix time in milliseconds the record was appended*/
+            int64_t appended;
+            uint8_t state;
+            uint8_t padding[7];
+        };
+        static constexpr size_t alignment{alignof(record_header)};
+        static constexpr size_t state_offset{offsetof(record_header, state)};
+
+
+        /**
+         * @brief      Single memory mapped segment file.
+         */
+        struct segment {
+            uint64_t sequence{};
+            std::string path{};
+            int fd{-1};
+            char *data{nullptr};
+            size_t size{0};
+            size_t used{0};
+            /*number of records which are not acknowledged*/
+            size_t pending{0};
+            /*file was created or resized and needs fdatasync*/
+            bool new_file{false};
+            /*range modified since the last commit*/
+            size_t dirty_begin{SIZE_MAX};
+            size_t dirty_end{0};
+
+            segment() = default;
+            segment(const segment &) = delete;
+            segment &operator=(const segment &) = delete;
+
+            ~segment() noexcept {
+                if (data) { ::munmap(data, size); }
+                if (fd != -1) { ::close(fd); }
+            }
+
+            auto touch(size_t begin, size_t end) {
+                dirty_begin = std::min(dirty_begin, begin);
+                dirty_end = std::max(dirty_end, end);
+            }
+        };
+
+      private:
+        spool_options _options{};
+        int _directory_fd{-1};
+        bool _directory_dirty{false};
+        /*segments are shared with commit() which flushes them unlocked*/
+        std::map<uint64_t, std::shared_ptr<segment>> _segments{};
+        segment *_current{nullptr};
+        uint64_t _next_sequence{1};
+        std::vector<ticket> _replay{};
+        size_t _pending{0};
+        std::atomic<bool> _dirty{false};
+        clock_type::time_point _last_commit{clock_type::now()};
+        std::mutex _mutex{};
+
+      private:
+        static auto checksum(uint32_t size,
+                             int64_t appended,
+                             std::string_view body) {
+            /*FNV-1a, detects records torn by a crash of the machine*/
+            uint32_t h{2166136261u ^ size};
+            auto mix{[&h](uint8_t c) { h = (h ^ c) * 16777619u; }};
+            for (size_t i{0}; i < sizeof(appended); ++i) {
+                mix(static_cast<uint8_t>(static_cast<uint64_t>(appended) >>
+                                         (8 * i)));
+            }
+            for (auto c : body) { mix(static_cast<uint8_t>(c)); }
+            return h;
+        }
+
+
+        static auto unix_milliseconds() -> int64_t {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                .count();
+        }
+
+
+        static auto record_size(size_t body_size) {
+            auto size{sizeof(record_header) + body_size};
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+
+        static auto make_ticket(const segment &s, size_t offset) -> ticket {
+            return s.sequence << 32 | offset;
+        }
+
+
+        auto segment_path(uint64_t sequence) const {
+            return std::format(
+                "{}/segment-{:016x}.spool", _options.directory, sequence);
+        }
+
+
+        /**
+         * @brief      Maps a segment file.
+         *
+         * @param      s     The segment with its fd and size set
+         *
+         * @return     False iff mmap failed
+         */
+        static auto map(segment &s) -> bool {
+            auto data{::mmap(nullptr,
+                             s.size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED,
+                             s.fd,
+                             0)};
+            if (data == MAP_FAILED) { return false; }
+            s.data = static_cast<char *>(data);
+            return true;
+        }
+
+
+        /**
+         * @brief      Loads an existing segment and collects its pending
+         * records for replay. Scanning stops at the first empty or torn
+         * record.
+         *
+         * @param[in]  sequence  The sequence number
+         * @param[in]  path      The path
+         *
+         * @return     void
+         */
+        auto load(uint64_t sequence, std::string path) {
+            auto s{std::make_shared<segment>()};
+            s->sequence = sequence;
+            s->path = std::move(path);
+            s->fd = ::open(s->path.c_str(), O_RDWR | O_CLOEXEC);
+            struct stat st {};
+            if (s->fd == -1 || ::fstat(s->fd, &st) == -1) {
+                throw std::runtime_error{
+                    std::format("could not open spool segment {}", s->path)};
+            }
+            s->size = static_cast<size_t>(st.st_size);
+            if (s->size > 0 && !map(*s)) {
+                throw std::runtime_error{
+                    std::format("could not map spool segment {}", s->path)};
+            }
+            while (s->size - s->used >= sizeof(record_header)) {
+                record_header h{};
+                std::memcpy(&h, s->data + s->used, sizeof(h));
+                if (h.state != pending && h.state != acknowledged) { break; }
+                if (s->size - s->used - sizeof(h) < h.size) { break; }
+                std::string_view body{s->data + s->used + sizeof(h), h.size};
+                if (checksum(h.size, h.appended, body) != h.checksum) {
+                    break;
+                }
+                if (h.state == pending) {
+                    _replay.push_back(make_ticket(*s, s->used));
+                    ++s->pending;
+                }
+                s->used += record_size(h.size);
+            }
+            _pending += s->pending;
+            if (s->pending == 0) {
+                ::unlink(s->path.c_str());
+                _directory_dirty = true;
+                return;
+            }
+            _segments.emplace(sequence, std::move(s));
+        }
+
+
+        /**
+         * @brief      Creates a new segment and makes it current.
+         *
+         * @param[in]  size  The size
+         *
+         * @return     False iff the file could not be created (e.g. disk is
+         * full)
+         */
+        auto create(size_t size) -> bool {
+            auto s{std::make_shared<segment>()};
+            s->sequence = _next_sequence;
+            s->path = segment_path(s->sequence);
+            s->size = size;
+            s->fd = ::open(s->path.c_str(),
+                           O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                           0644);
+            if (s->fd == -1) { return false; }
+            /*allocated blocks, so that writes to the mapping cannot fail*/
+            if (::posix_fallocate(s->fd, 0, static_cast<off_t>(size)) != 0 ||
+                !map(*s)) {
+                ::unlink(s->path.c_str());
+                return false;
+            }
+            s->new_file = true;
+            _directory_dirty = true;
+            ++_next_sequence;
+            _current = s.get();
+            _segments.emplace(s->sequence, std::move(s));
+            return true;
+        }
+
+
+        /**
+         * @brief      Deletes a segment if all its records are acknowledged
+         * and nothing is appended to it any more.
+         *
+         * @param[in]  it    The segment
+         *
+         * @return     void
+         */
+        auto reclaim(decltype(_segments)::iterator it) {
+            if (it->second->pending > 0 || it->second.get() == _current) {
+                return;
+            }
+            ::unlink(it->second->path.c_str());
+            _directory_dirty = true;
+            _dirty = true;
+            _segments.erase(it);
+        }
+
+      public:
+        /**
+         * @brief      Opens the spool directory and loads segments left by
+         * previous instances. Throws if the directory cannot be used.
+         *
+         * @param[in]  options  The options
+         */
+        explicit spool(spool_options options) : _options{std::move(options)} {
+            _options.segment_size =
+                std::clamp(_options.segment_size,
+                           size_t{4096},
+                           size_t{std::numeric_limits<uint32_t>::max()});
+            std::error_code ec{};
+            std::filesystem::create_directories(_options.directory, ec);
+            _directory_fd = ::open(
+                _options.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (ec || _directory_fd == -1) {
+                throw std::runtime_error{std::format(
+                    "could not open spool directory {}", _options.directory)};
+            }
+            std::vector<std::pair<uint64_t, std::string>> found{};
+            for (auto &entry :
+                 std::filesystem::directory_iterator{_options.directory}) {
+                auto name{entry.path().filename().string()};
+                std::string_view n{name};
+                if (!n.starts_with("segment-") || !n.ends_with(".spool")) {
+                    continue;
+                }
+                n = n.substr(8, n.size() - 8 - 6);
+                uint64_t sequence{};
+                auto [end, error] = std::from_chars(
+                    n.data(), n.data() + n.size(), sequence, 16);
+                if (error != std::errc{} || end != n.data() + n.size()) {
+                    continue;
+                }
+                found.emplace_back(sequence, entry.path().string());
+            }
+            std::ranges::sort(found);
+            for (auto &[sequence, path] : found) {
+                load(sequence, std::move(path));
+                _next_sequence = std::max(_next_sequence, sequence + 1);
+            }
+            if (_directory_dirty) { ::fsync(_directory_fd); }
+            _directory_dirty = false;
+        }
+
+
+        spool(const spool &) = delete;
+        spool &operator=(const spool &) = delete;
+
+
+        /**
+         * @brief      Destroys the object. Flushes everything and deletes the
+         * current segment if all its records are acknowledged.
+         */
+        ~spool() noexcept {
+            if (_current && _current->pending == 0) {
+                auto it{_segments.find(_current->sequence)};
+                _current = nullptr;
+                reclaim(it);
+            }
+            static_cast<void>(commit());
+            _segments.clear();
+            if (_directory_fd != -1) { ::close(_directory_fd); }
+        }
+
+      public:
+        /**
+         * @brief      Appends a request.
+         *
+         * @param[in]  body  The request
+         *
+         * @return     Ticket of the record or no_ticket if it could not be
+         * stored (the request should be sent anyway)
+         */
+        auto append(std::string_view body) -> ticket {
+            if (body.size() >= std::numeric_limits<uint32_t>::max() -
+                                   sizeof(record_header) - alignment) {
+                return no_ticket;
+            }
+            auto size{record_size(body.size())};
+            std::scoped_lock lock{_mutex};
+            if (!_current || _current->size - _current->used < size) {
+                auto previous{_current};
+                _current = nullptr;
+                if (previous) { reclaim(_segments.find(previous->sequence)); }
+                if (!create(std::max(_options.segment_size, size))) {
+                    return no_ticket;
+                }
+            }
+            auto at{_current->data + _current->used};
+            auto appended{unix_milliseconds()};
+            record_header h{
+                static_cast<uint32_t>(body.size()),
+                checksum(static_cast<uint32_t>(body.size()), appended, body),
+                appended,
+                pending,
+                {}};
+            std::memcpy(at + sizeof(h), body.data(), body.size());
+            std::memcpy(at, &h, sizeof(h));
+            auto t{make_ticket(*_current, _current->used)};
+            _current->touch(_current->used, _current->used + size);
+            _current->used += size;
+            ++_current->pending;
+            ++_pending;
+            _dirty.store(true, std::memory_order_relaxed);
+            return t;
+        }
+
+
+        /**
+         * @brief      Acknowledges records of completed transfers.
+         *
+         * @param[in]  tickets  Tickets of the records
+         *
+         * @return     void
+         */
+        auto acknowledge(std::span<const ticket> tickets) {
+            if (tickets.empty()) { return; }
+            std::scoped_lock lock{_mutex};
+            for (auto t : tickets) {
+                auto it{_segments.find(t >> 32)};
+                if (t == no_ticket || it == _segments.end()) { continue; }
+                auto &s{*it->second};
+                auto offset{static_cast<size_t>(t & 0xffffffffu)};
+                auto &state{s.data[offset + state_offset]};
+                if (state != pending) { continue; }
+                state = acknowledged;
+                s.touch(offset + state_offset, offset + state_offset + 1);
+                --s.pending;
+                --_pending;
+                reclaim(it);
+            }
+            _dirty.store(true, std::memory_order_relaxed);
+        }
+
+
+        /**
+         * @brief      Passes requests which were not acknowledged by previous
+         * instances to f (only once, their records are not copied).
+         *
+         * @param      f     Function of the form (ticket, std::string_view,
+         * clock_type::time_point appended). The time the record was appended
+         * is moved to the steady clock of this process (it is never later
+         * than now).
+         *
+         * @return     Number of replayed requests
+         */
+        auto replay(auto &&f) -> size_t {
+            auto tickets{std::exchange(_replay, {})};
+            auto now{clock_type::now()};
+            auto unix_now{unix_milliseconds()};
+            for (auto t : tickets) {
+                std::string_view body{};
+                int64_t appended{};
+                {
+                    std::scoped_lock lock{_mutex};
+                    auto it{_segments.find(t >> 32)};
+                    if (it == _segments.end()) { continue; }
+                    record_header h{};
+                    auto at{it->second->data + (t & 0xffffffffu)};
+                    std::memcpy(&h, at, sizeof(h));
+                    body = {at + sizeof(h), h.size};
+                    appended = h.appended;
+                }
+                auto age{std::chrono::milliseconds{
+                    std::max(unix_now - appended, int64_t{0})}};
+                f(t, body, now - age);
+            }
+            return tickets.size();
+        }
+
+
+        /**
+         * @brief      Flushes all appends and acknowledgements made since the
+         * previous commit to disk.
+         *
+         * @return     False iff some flush failed
+         */
+        [[nodiscard]] auto commit() -> bool {
+            std::vector<std::tuple<std::shared_ptr<segment>, size_t, size_t>>
+                dirty{};
+            bool directory{false};
+            {
+                std::scoped_lock lock{_mutex};
+                _dirty.store(false, std::memory_order_relaxed);
+                for (auto &[_, s] : _segments) {
+                    if (s->dirty_begin >= s->dirty_end && !s->new_file) {
+                        continue;
+                    }
+                    dirty.emplace_back(s, s->dirty_begin, s->dirty_end);
+                    s->dirty_begin = SIZE_MAX;
+                    s->dirty_end = 0;
+                }
+                directory = std::exchange(_directory_dirty, false);
+            }
+            _last_commit = clock_type::now();
+            auto page{static_cast<size_t>(::sysconf(_SC_PAGESIZE))};
+            bool ok{true};
+            for (auto &[s, begin, end] : dirty) {
+                if (begin < end) {
+                    begin = begin / page * page;
+                    ok &= ::msync(s->data + begin, end - begin, MS_SYNC) == 0;
+                }
+                if (std::exchange(s->new_file, false)) {
+                    ok &= ::fdatasync(s->fd) == 0;
+                }
+            }
+            if (directory) { ok &= ::fsync(_directory_fd) == 0; }
+            return ok;
+        }
+
+
+        /**
+         * @brief      Time left until the next commit is due.
+         *
+         * @return     Milliseconds to wait (-1 if there is nothing to commit)
+         */
+        auto wait_time() const -> int {
+            if (!_dirty.load(std::memory_order_relaxed)) { return -1; }
+            auto left{std::chrono::ceil<std::chrono::milliseconds>(
+                _options.sync_interval - (clock_type::now() - _last_commit))};
+            return std::max(static_cast<int>(left.count()), 0);
+        }
+
+
+        /**
+         * @brief      Commits if the sync interval elapsed since the previous
+         * commit and there is something to commit.
+         *
+         * @return     False iff some flush failed
+         */
+        [[nodiscard]] auto maybe_commit() -> bool {
+            return wait_time() == 0 ? commit() : true;
+        }
+
+
+        /**
+         * @brief      Number of requests which are not acknowledged.
+         */
+        auto size() {
+            std::scoped_lock lock{_mutex};
+            return _pending;
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cppurl.hpp>
+#include <cstdint>
+#include <expected>
+#include <line_scanner.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Incremental reader of newline separated requests. The file
+     * descriptor is switched to non-blocking mode, thus reading never stalls
+     * the transfer loop. Use wait_fds() to let curl_multi_wait wake up as soon
+     * as new data arrives. Lines longer than max_line_size are skipped, so
+     * that input without newlines cannot grow the buffered tail without
+     * bound.
+     */
+    class stdin_reader {
+      public:
+        static constexpr size_t default_max_line_size{1024 * 1024};
+
+      private:
+        static constexpr size_t read_chunk_size{64 * 1024};
+        /*upper bound on read calls per read(), so that a fast producer cannot
+         * starve in-flight transfers*/
+        static constexpr size_t max_reads_per_call{16};
+
+      private:
+        int _fd{STDIN_FILENO};
+        int _original_flags{-1};
+        bool _eof{false};
+        size_t _max_line_size{default_max_line_size};
+        /*the rest of an oversized line is skipped up to its newline*/
+        bool _skipping{false};
+        uint64_t _oversized{0};
+        std::vector<char> _chunk{};
+        std::string _partial_line{};
+        curl_waitfd _wait_fd{};
+
+      public:
+        /**
+         * @brief      Constructs a new instance and switches fd to
+         * non-blocking mode.
+         *
+         * @param[in]  fd             The file descriptor to be read
+         * @param[in]  max_line_size  Longer lines are skipped (and counted)
+         */
+        explicit stdin_reader(int fd = STDIN_FILENO,
+                              size_t max_line_size = default_max_line_size)
+            : _fd{fd},
+              _original_flags{fcntl(fd, F_GETFL)},
+              _max_line_size{max_line_size},
+              _chunk(read_chunk_size) {
+            if (_original_flags == -1 ||
+                fcntl(_fd, F_SETFL, _original_flags | O_NONBLOCK) == -1) {
+                throw std::system_error{
+                    errno,
+                    std::generic_category(),
+                    "stdin reader could not switch to non-blocking mode"};
+            }
+            _wait_fd.fd = _fd;
+            _wait_fd.events = CURL_WAIT_POLLIN;
+        }
+
+
+        stdin_reader(const stdin_reader &) = delete;
+        stdin_reader &operator=(const stdin_reader &) = delete;
+
+
+        /**
+         * @brief      Destroys the object and restores original fd flags.
+         */
+        ~stdin_reader() noexcept { fcntl(_fd, F_SETFL, _original_flags); }
+
+      private:
+        /**
+         * @brief      Splits freshly read bytes into lines. Complete lines are
+         * passed to on_line, an incomplete tail is kept for the next read
+         * unless the line grows over max_line_size.
+         *
+         * @param[in]  data     Freshly read bytes
+         * @param      on_line  Function called for every complete line
+         *
+         * @return     Number of complete lines
+         */
+        auto split(std::string_view data, auto &&on_line) -> size_t {
+            size_t lines{0};
+            auto tail{line_scanner::split(data, [&](std::string_view line) {
+                auto size{_partial_line.size() + line.size()};
+                if (_skipping || size > _max_line_size) {
+                    _oversized += _skipping ? 0 : 1;
+                    _skipping = false;
+                } else if (size > 0) {
+                    if (!_partial_line.empty()) {
+                        _partial_line.append(line);
+                        line = _partial_line;
+                    }
+                    on_line(line);
+                    ++lines;
+                }
+                _partial_line.clear();
+            })};
+            auto rest{data.substr(tail)};
+            if (_skipping) { return lines; }
+            if (_partial_line.size() + rest.size() > _max_line_size) {
+                ++_oversized;
+                _skipping = true;
+                _partial_line.clear();
+                return lines;
+            }
+            _partial_line.append(rest);
+            return lines;
+        }
+
+      public:
+        /**
+         * @brief      Reads everything that is available without blocking.
+         * Empty lines are skipped. An unterminated last line is reported when
+         * end of file is reached.
+         *
+         * @param      on_line  Function of the form [](std::string_view line)
+         * called for every complete line. The view is valid only during the
+         * call.
+         *
+         * @return     Number of complete lines or CURLE_READ_ERROR
+         */
+        auto read(auto &&on_line) -> std::expected<size_t, b_status> {
+            size_t lines{0};
+            for (size_t i{0}; !_eof && i < max_reads_per_call; ++i) {
+                auto n{::read(_fd, _chunk.data(), _chunk.size())};
+                if (n > 0) {
+                    lines += split(std::string_view{_chunk.data(),
+                                                    static_cast<size_t>(n)},
+                                   on_line);
+                } else if (n == 0) {
+                    _eof = true;
+                    _skipping = false;
+                    if (!_partial_line.empty()) {
+                        on_line(std::string_view{_partial_line});
+                        _partial_line.clear();
+                        ++lines;
+                    }
+                } else if (errno == EINTR) {
+                    continue;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                } else {
+                    return std::unexpected{b_status{CURLE_READ_ERROR}};
+                }
+            }
+            return lines;
+        }
+
+
+        /**
+         * @brief      Allows reading again after end of file was reached (e.g.
+         * when the input is a growing regular file).
+         *
+         * @return     void
+         */
+        auto resume() { _eof = false; }
+
+
+        /**
+         * @brief      The file descriptor being read.
+         */
+        auto fd() const { return _fd; }
+
+
+        /**
+         * @brief      True iff end of file was reached.
+         */
+        auto eof() const { return _eof; }
+
+
+        /**
+         * @brief      Number of lines skipped since they were longer than
+         * max_line_size.
+         */
+        auto oversized() const { return _oversized; }
+
+
+        /**
+         * @brief      File descriptors which should be passed to
+         * curl_multi_wait. Empty once end of file was reached.
+         *
+         * @return     std::span of curl_waitfd
+         */
+        auto wait_fds() -> std::span<curl_waitfd> {
+            if (_eof) { return {}; }
+            _wait_fd.revents = 0;
+            return {&_wait_fd, 1};
+        }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <json_fields.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Text with {name} placeholders, e.g. a request body
+     * {"id":{id},"text":"{text}"} or a header "Idempotency-Key: {id}". A
+     * placeholder is a name of letters, digits and '_' in braces, any other
+     * brace is a part of the text (so JSON needs no escaping). Values are
+     * inserted as they are. The text is rendered into a buffer owned by the
+     * template, which keeps its capacity, so rendering does not allocate once
+     * the buffer fits the longest result, or straight into memory of the
+     * caller (see bind_line and write).
+     */
+    class text_template {
+      private:
+        static constexpr size_t initial_capacity{4096};
+
+        /**
+         * @brief      Literal text followed by a placeholder (the last
+         * segment has none).
+         */
+        struct segment {
+            std::string_view literal{};
+            /*index into _names*/
+            size_t field{0};
+            bool has_field{false};
+        };
+
+      private:
+        std::string _text{};
+        std::vector<segment> _segments{};
+        /*distinct placeholders in order of their first occurrence*/
+        std::vector<std::string_view> _names{};
+        std::vector<std::string_view> _values{};
+        std::string _buffer{};
+
+      private:
+        static auto name_char(char c) -> bool {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+
+        /**
+         * @brief      Splits the text into segments.
+         *
+         * @return     void
+         */
+        auto parse() {
+            std::string_view text{_text};
+            size_t literal{0};
+            for (size_t at{text.find('{')}; at != text.npos;
+                 at = text.find('{', at + 1)) {
+                auto end{at + 1};
+                while (end < text.size() && name_char(text[end])) { ++end; }
+                if (end == at + 1 || end == text.size() || text[end] != '}') {
+                    continue;
+                }
+                auto name{text.substr(at + 1, end - at - 1)};
+                auto found{std::ranges::find(_names, name)};
+                if (found == _names.end()) {
+                    found = _names.insert(_names.end(), name);
+                }
+                _segments.push_back(
+                    {text.substr(literal, at - literal),
+                     static_cast<size_t>(found - _names.begin()),
+                     true});
+                literal = end + 1;
+                at = end;
+            }
+            _segments.push_back({text.substr(literal)});
+        }
+
+
+        /**
+         * @brief      Value of the placeholder of a segment (empty if it has
+         * none or it is missing).
+         */
+        auto value(const segment &s) const -> std::string_view {
+            return s.has_field && s.field < _values.size() ? _values[s.field]
+                                                           : std::string_view{};
+        }
+
+
+        /**
+         * @brief      Renders the text with _values (missing ones are empty).
+         *
+         * @return     View onto the buffer (valid until the next render)
+         */
+        auto render() -> std::string_view {
+            _buffer.clear();
+            for (auto &s : _segments) {
+                _buffer.append(s.literal);
+                _buffer.append(value(s));
+            }
+            return _buffer;
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  text  The text
+         */
+        explicit text_template(std::string text) : _text{std::move(text)} {
+            parse();
+            _values.reserve(_names.size());
+            _buffer.reserve(std::max(initial_capacity, 2 * _text.size()));
+        }
+
+
+        /*segments point into _text*/
+        text_template(const text_template &other)
+            : text_template{other._text} {}
+
+
+        text_template &operator=(const text_template &) = delete;
+
+      public:
+        /**
+         * @brief      Renders the text with values of a line, separated by
+         * tabs in order of names() (e.g. "42<TAB>hello" for the body above).
+         * Missing values are empty, surplus ones are ignored.
+         *
+         * @param[in]  line  The line
+         *
+         * @return     View onto the buffer (valid until the next render)
+         */
+        auto render_line(std::string_view line) -> std::string_view {
+            bind_line(line);
+            return render();
+        }
+
+
+        /**
+         * @brief      Takes the values of a line (see render_line) for the
+         * next write. The line must outlive it.
+         *
+         * @param[in]  line  The line
+         *
+         * @return     Size of the rendered text
+         */
+        auto bind_line(std::string_view line) -> size_t {
+            _values.clear();
+            while (_values.size() < _names.size()) {
+                auto tab{line.find('\t')};
+                _values.push_back(line.substr(0, tab));
+                if (tab == line.npos) { break; }
+                line.remove_prefix(tab + 1);
+            }
+            size_t size{0};
+            for (auto &s : _segments) {
+                size += s.literal.size() + value(s).size();
+            }
+            return size;
+        }
+
+
+        /**
+         * @brief      Writes the text rendered with the values taken by the
+         * last bind_line.
+         *
+         * @param      out   Memory with room for the size returned by
+         * bind_line
+         *
+         * @return     void
+         */
+        auto write(char *out) const {
+            for (auto &s : _segments) {
+                out = std::ranges::copy(s.literal, out).out;
+                out = std::ranges::copy(value(s), out).out;
+            }
+        }
+
+
+        /**
+         * @brief      Renders the text with values of JSON fields extracted
+         * from a body, e.g. "Idempotency-Key: {id}" takes the "id" field.
+         * The fields must include names().
+         *
+         * @param[in]  fields  The extracted fields
+         *
+         * @return     View onto the buffer (valid until the next render)
+         */
+        auto render_fields(const json_fields &fields) -> std::string_view {
+            _values.clear();
+            for (auto name : _names) { _values.push_back(fields.value(name)); }
+            return render();
+        }
+
+
+        /**
+         * @brief      Names of the placeholders in order of their first
+         * occurrence.
+         */
+        auto names() const -> const std::vector<std::string_view> & {
+            return _names;
+        }
+
+
+        /**
+         * @brief      The text as it was given.
+         */
+        auto text() const -> std::string_view { return _text; }
+    };
+
+
+}  // namespace cppurl
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+namespace cppurl {
+
+
+    /**
+     * @brief      Set of per-shard deques. Items are pushed round robin, every
+     * shard pops from the front of its own deque and, once it is empty,
+     * steals from the back of the other deques. This is not a lock-free
+     * (Chase-Lev) deque: every deque is a std::deque guarded by its own
+     * mutex, which is held only while items are moved in or out, so shards
+     * contend only while stealing.
+     *
+     * @tparam     T     Type of items
+     */
+    template <typename T>
+    class work_stealing_queue {
+      private:
+        /**
+         * @brief      Single deque (padded to avoid false sharing of locks).
+         */
+        struct alignas(64) lane {
+            std::mutex mutex{};
+            std::deque<T> items{};
+        };
+
+      private:
+        size_t _size{};
+        std::unique_ptr<lane[]> _lanes{};
+        std::atomic<size_t> _next{0};
+        /*number of queued items (approximate while items are moved)*/
+        std::atomic<size_t> _count{0};
+
+      private:
+        /**
+         * @brief      Moves at most n items from the front of the deque.
+         *
+         * @param      l      The deque
+         * @param[in]  n      Maximal number of items
+         * @param      taken  Taken items are appended to it
+         *
+         * @return     void
+         */
+        static auto take_front(lane &l, size_t n, std::vector<T> &taken) {
+            std::scoped_lock lock{l.mutex};
+            n = std::min(n, l.items.size());
+            for (size_t i{0}; i < n; ++i) {
+                taken.push_back(std::move(l.items.front()));
+                l.items.pop_front();
+            }
+        }
+
+
+        /**
+         * @brief      Steals at most n items (but no more than half, rounded
+         * up) from the back of the deque.
+         *
+         * @param      l      The deque
+         * @param[in]  n      Maximal number of items
+         * @param      taken  Stolen items are appended to it
+         *
+         * @return     void
+         */
+        static auto steal_back(lane &l, size_t n, std::vector<T> &taken) {
+            std::scoped_lock lock{l.mutex};
+            n = std::min(n, (l.items.size() + 1) / 2);
+            for (size_t i{0}; i < n; ++i) {
+                taken.push_back(std::move(l.items.back()));
+                l.items.pop_back();
+            }
+        }
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  number_of_lanes  Number of shards
+         */
+        explicit work_stealing_queue(size_t number_of_lanes)
+            : _size{std::max(number_of_lanes, size_t{1})},
+              _lanes{std::make_unique<lane[]>(_size)} {}
+
+      public:
+        /**
+         * @brief      Pushes an item to the next deque (round robin).
+         *
+         * @param      item  The item
+         *
+         * @return     Index of the deque
+         */
+        auto push(T item) -> size_t {
+            auto i{_next.fetch_add(1, std::memory_order_relaxed) % _size};
+            std::scoped_lock lock{_lanes[i].mutex};
+            _lanes[i].items.push_back(std::move(item));
+            _count.fetch_add(1, std::memory_order_relaxed);
+            return i;
+        }
+
+
+        /**
+         * @brief      Pops at most n items for a given shard. Own deque is
+         * used first, the remaining items are stolen from other deques.
+         * Items are passed to out only after all locks are released, so
+         * pushes and steals never wait for its work.
+         *
+         * @param[in]  shard  Index of the shard
+         * @param[in]  n      Maximal number of items
+         * @param      out    Function of the form [](T &&item) called for
+         * every item (it must not pop from a queue of the same type)
+         *
+         * @return     Number of popped items
+         */
+        auto pop(size_t shard, size_t n, auto &&out) -> size_t {
+            /*reused by every pop of this thread*/
+            thread_local std::vector<T> taken{};
+            taken.clear();
+            take_front(_lanes[shard % _size], n, taken);
+            for (size_t i{1}; i < _size && taken.size() < n; ++i) {
+                steal_back(
+                    _lanes[(shard + i) % _size], n - taken.size(), taken);
+            }
+            auto popped{taken.size()};
+            _count.fetch_sub(popped, std::memory_order_relaxed);
+            for (auto &item : taken) { out(std::move(item)); }
+            taken.clear();
+            return popped;
+        }
+
+
+        /**
+         * @brief      Number of deques.
+         */
+        auto lanes() const { return _size; }
+
+
+        /**
+         * @brief      Number of queued items.
+         */
+        auto size() const { return _count.load(std::memory_order_relaxed); }
+    };
+
+
+    /**
+     * @brief      Work stealing queue per priority lane. Shards take items of
+     * the first lane first (stealing them from each other), so an urgent item
+     * does not wait behind the backlog of later lanes.
+     *
+     * @tparam     T     Type of items
+     */
+    template <typename T>
+    class prioritized_work_queue {
+      private:
+        /*deque, since work_stealing_queue cannot be moved*/
+        std::deque<work_stealing_queue<T>> _lanes{};
+
+      public:
+        /**
+         * @brief      Constructs a new instance.
+         *
+         * @param[in]  shards  Number of shards
+         * @param[in]  lanes   Number of priority lanes (at least 1)
+         */
+        prioritized_work_queue(size_t shards, size_t lanes) {
+            for (size_t i{0}; i < std::max(lanes, size_t{1}); ++i) {
+                _lanes.emplace_back(shards);
+            }
+        }
+
+      public:
+        /**
+         * @brief      Pushes an item to a lane (the last one if lane is out
+         * of range).
+         *
+         * @param[in]  lane  The lane
+         * @param      item  The item
+         *
+         * @return     void
+         */
+        auto push(size_t lane, T item) {
+            _lanes[std::min(lane, _lanes.size() - 1)].push(std::move(item));
+        }
+
+
+        /**
+         * @brief      Pops at most n items for a given shard, lane by lane
+         * (see work_stealing_queue::pop).
+         *
+         * @param[in]  shard  Index of the shard
+         * @param[in]  n      Maximal number of items
+         * @param      out    Function of the form [](T &&item) called for
+         * every item
+         *
+         * @return     Number of popped items
+         */
+        auto pop(size_t shard, size_t n, auto &&out) -> size_t {
+            size_t popped{0};
+            for (auto &l : _lanes) {
+                if (popped == n) { break; }
+                popped += l.pop(shard, n - popped, out);
+            }
+            return popped;
+        }
+
+
+        /**
+         * @brief      Pops an item of the last non-empty lane to make room for
+         * new ones.
+         *
+         * @param[in]  shard  Deque of the lane tried first
+         * @param      out    Function of the form [](size_t lane, T &&item)
+         * called for the item
+         *
+         * @return     False iff the queue is empty
+         */
+        auto drop(size_t shard, auto &&out) -> bool {
+            for (auto lane{_lanes.size()}; lane-- > 0;) {
+                if (_lanes[lane].pop(shard, 1, [&](T &&item) {
+                        out(lane, std::move(item));
+                    }) > 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+        /**
+         * @brief      Number of shards.
+         */
+        auto shards() const { return _lanes.front().lanes(); }
+
+
+        /**
+         * @brief      Number of queued items.
+         */
+        auto size() const {
+            size_t n{0};
+            for (auto &l : _lanes) { n += l.size(); }
+            return n;
+        }
+    };
+
+
+}  // namespace cppurl
@@ -1,41 +1,297 @@
+/*values of repeated options (e.g. --header) are not split at commas*/
+#define CXXOPTS_VECTOR_DELIMITER '\0'
 #include <cxxopts.hpp>
+#include <logger.hpp>
+#include <metrics_exporter.hpp>
 #include <notifier.hpp>
+#include <sharded_notifier.hpp>
 
 auto parse_options(int argc, char const *argv[]) {
     cxxopts::Options options("notifier",
                              "////////////////// Send post requests to a given "
                              "url //////////////////\n\n");
     options.add_options()(
-        "u,url", "the post url", cxxopts::value<std::string>())(
+        "u,url",
+        "the post url (of requests without a key of --routes)",
+        cxxopts::value<std::string>())(
+        "routes",
+        "file with \"key url\" lines; a request \"key<TAB>body\" is posted "
+        "to the url of key",
+        cxxopts::value<std::string>())(
         "i,interval",
-        "notification interval in seconds",
-        cxxopts::value<int>()->default_value("5")) /**/ ("h,help", "Usage");
+        "interval in seconds for checking stdin again after its end",
+        cxxopts::value<int>()->default_value("5"))(
+        "input",
+        "read requests from a memory mapped file instead of stdin",
+        cxxopts::value<std::string>())(
+        "input-framing",
+        "framing of requests in --input: lines or length-prefixed (32 bit "
+        "little endian size before every request)",
+        cxxopts::value<std::string>()->default_value("lines"))(
+        "max-line-size",
+        "lines of stdin longer than that many bytes are skipped",
+        cxxopts::value<int64_t>()->default_value("1048576"))(
+        "H,header",
+        "header \"Name: value\" of every post (repeatable); {field} in the "
+        "value is replaced by the JSON field of the posted body (not with "
+        "--batch)",
+        cxxopts::value<std::vector<std::string>>())(
+        "body-template",
+        "body with {field} placeholders; every request gives only the values "
+        "of its fields separated by tabs",
+        cxxopts::value<std::string>())(
+        "e,engine",
+        "transfer engine: poll or socket_action",
+        cxxopts::value<std::string>()->default_value("poll"))(
+        "poll-wait-time",
+        "maximal sleep of the poll engine between checks of its input in "
+        "milliseconds",
+        cxxopts::value<int>()->default_value("100"))(
+        "t,threads",
+        "number of worker threads (shards)",
+        cxxopts::value<int>()->default_value("1"))(
+        "pin-threads",
+        "pin every worker thread to a core",
+        cxxopts::value<bool>()->default_value("false"))(
+        "max-connections",
+        "maximal number of simultaneous transfers (per thread)",
+        cxxopts::value<int>()->default_value("100"))(
+        "min-connections",
+        "number of handles kept even when idle (per thread)",
+        cxxopts::value<int>()->default_value("0"))(
+        "max-destination-connections",
+        "maximal number of simultaneous transfers to a single destination "
+        "(per thread, 0 means --max-connections divided by the number of "
+        "destinations)",
+        cxxopts::value<int>()->default_value("0"))(
+        "b,batch",
+        "pack many requests into one post: none, ndjson or json_array",
+        cxxopts::value<std::string>()->default_value("none"))(
+        "batch-items",
+        "maximal number of requests in one batch",
+        cxxopts::value<int>()->default_value("100"))(
+        "batch-bytes",
+        "maximal size of one batch in bytes",
+        cxxopts::value<int>()->default_value("1048576"))(
+        "batch-linger",
+        "maximal time in milliseconds a request waits for its batch",
+        cxxopts::value<int>()->default_value("10"))(
+        "lanes",
+        "number of priority lanes (at most 8, lane 0 is sent first)",
+        cxxopts::value<int>()->default_value("1"))(
+        "priority-prefix",
+        "every request starts with \"lane[+ttl|@deadline]<TAB>\" (ttl in "
+        "milliseconds, deadline in unix milliseconds)",
+        cxxopts::value<bool>()->default_value("false"))(
+        "ttl",
+        "time to live in milliseconds of requests without one (0 means they "
+        "never expire)",
+        cxxopts::value<int>()->default_value("0"))(
+        "dedup-window",
+        "suppress requests equal to one read less than that many "
+        "milliseconds ago (0 means no suppression)",
+        cxxopts::value<int>()->default_value("0"))(
+        "dedup-key",
+        "compare only the value of this JSON field instead of whole requests",
+        cxxopts::value<std::string>()->default_value(""))(
+        "dedup-capacity",
+        "number of requests remembered for suppression",
+        cxxopts::value<int>()->default_value("65536"))(
+        "http2",
+        "multiplex transfers over http/2 connections",
+        cxxopts::value<bool>()->default_value("false"))(
+        "http2-prior-knowledge",
+        "use http/2 without upgrade for plain http urls (h2c)",
+        cxxopts::value<bool>()->default_value("false"))(
+        "max-host-connections",
+        "maximal number of connections to the host (0 means no limit)",
+        cxxopts::value<int>()->default_value("0"))(
+        "max-concurrent-streams",
+        "maximal number of http/2 streams on a single connection",
+        cxxopts::value<int>()->default_value("100"))(
+        "r,retries",
+        "maximal number of retries of a failed request (network errors, "
+        "http 408, 429 and 5xx)",
+        cxxopts::value<int>()->default_value("0"))(
+        "retry-base-delay",
+        "delay in milliseconds before the first retry (doubled every retry)",
+        cxxopts::value<int>()->default_value("100"))(
+        "retry-max-delay",
+        "maximal delay in milliseconds between retries",
+        cxxopts::value<int>()->default_value("30000"))(
+        "rate",
+        "maximal number of posts per second (0 means no limit)",
+        cxxopts::value<double>()->default_value("0"))(
+        "byte-rate",
+        "maximal number of posted bytes per second (0 means no limit)",
+        cxxopts::value<double>()->default_value("0"))(
+        "burst",
+        "number of posts sent at once after idle time (0 means --rate)",
+        cxxopts::value<double>()->default_value("0"))(
+        "byte-burst",
+        "number of bytes sent at once after idle time (0 means --byte-rate)",
+        cxxopts::value<double>()->default_value("0"))(
+        "queue-high-items",
+        "number of queued posts at which the queue is full (0 means no limit)",
+        cxxopts::value<int>()->default_value("0"))(
+        "queue-low-items",
+        "number of queued posts at which reading resumes (0 means half of "
+        "--queue-high-items)",
+        cxxopts::value<int>()->default_value("0"))(
+        "queue-high-bytes",
+        "size in bytes of queued posts at which the queue is full (0 means no "
+        "limit)",
+        cxxopts::value<int64_t>()->default_value("0"))(
+        "queue-low-bytes",
+        "size in bytes of queued posts at which reading resumes (0 means half "
+        "of --queue-high-bytes)",
+        cxxopts::value<int64_t>()->default_value("0"))(
+        "overflow",
+        "policy of a full queue: block (stop reading stdin), drop-oldest or "
+        "drop-newest",
+        cxxopts::value<std::string>()->default_value("block"))(
+        "capture-response",
+        "print up to that many bytes of every response body along with its "
+        "http code (0 means responses go to stdout as they arrive)",
+        cxxopts::value<int>()->default_value("0"))(
+        "compress",
+        "content encoding of posted bodies: none, gzip or zstd",
+        cxxopts::value<std::string>()->default_value("none"))(
+        "compress-min-size",
+        "bodies smaller than that many bytes are sent uncompressed",
+        cxxopts::value<int>()->default_value("1024"))(
+        "compress-level",
+        "compression level (0 means the default level of the method)",
+        cxxopts::value<int>()->default_value("0"))(
+        "spool",
+        "directory of the on-disk spool; requests not sent before exit or "
+        "crash are sent on the next start",
+        cxxopts::value<std::string>())(
+        "spool-segment-size",
+        "size of a single spool file in MiB",
+        cxxopts::value<int>()->default_value("64"))(
+        "spool-sync-interval",
+        "interval in milliseconds of flushing the spool to disk",
+        cxxopts::value<int>()->default_value("10"))(
+        "metrics",
+        "export latency histograms and counters in Prometheus text format to "
+        "a file or to a unix socket (unix:PATH)",
+        cxxopts::value<std::string>())(
+        "metrics-interval",
+        "interval in milliseconds of rewriting the metrics file",
+        cxxopts::value<int>()->default_value("10000"))(
+        "log-level",
+        "debug, info, warning, error or off (transfers are logged at info, "
+        "failed ones at warning)",
+        cxxopts::value<std::string>()->default_value("info"))(
+        "log-sample",
+        "log 1 of every N transfers below warning",
+        cxxopts::value<int>()->default_value("1"))(
+        "log-flush-interval",
+        "interval in milliseconds of writing the log",
+        cxxopts::value<int>()->default_value("100")) /**/ (
+        "h,help", "Usage");
     options.allow_unrecognised_options();
     return std::pair{options, options.parse(argc, argv)};
 }
 
 
-auto on_successful_transfer() {
-    return [](cppurl::handle_info info) -> cppurl::notifier::status {
+auto parse_engine(std::string_view name) -> cppurl::engine {
+    if (name == "poll") { return cppurl::engine::poll; }
+    if (name == "socket_action") { return cppurl::engine::socket_action; }
+    throw std::invalid_argument{std::format("unknown engine {}", name)};
+}
+
+
+auto parse_record_framing(std::string_view name) -> cppurl::record_framing {
+    if (name == "lines") { return cppurl::record_framing::lines; }
+    if (name == "length-prefixed") {
+        return cppurl::record_framing::length_prefixed;
+    }
+    throw std::invalid_argument{std::format("unknown input framing {}", name)};
+}
+
+
+auto parse_framing(std::string_view name) -> cppurl::framing {
+    if (name == "none") { return cppurl::framing::none; }
+    if (name == "ndjson") { return cppurl::framing::ndjson; }
+    if (name == "json_array") { return cppurl::framing::json_array; }
+    throw std::invalid_argument{std::format("unknown batch framing {}", name)};
+}
+
+
+auto parse_overflow(std::string_view name) -> cppurl::overflow_policy {
+    if (name == "block") { return cppurl::overflow_policy::block; }
+    if (name == "drop-oldest") { return cppurl::overflow_policy::drop_oldest; }
+    if (name == "drop-newest") { return cppurl::overflow_policy::drop_newest; }
+    throw std::invalid_argument{
+        std::format("unknown overflow policy {}", name)};
+}
+
+
+auto parse_compression(std::string_view name) -> cppurl::compression {
+    if (name == "none") { return cppurl::compression::none; }
+    if (name == "gzip") { return cppurl::compression::gzip; }
+    if (name == "zstd" && cppurl::compressor::has_zstd()) {
+        return cppurl::compression::zstd;
+    }
+    throw std::invalid_argument{
+        std::format("unknown or unavailable compression {}", name)};
+}
+
+
+auto parse_log_level(std::string_view name) -> cppurl::log_level {
+    if (name == "debug") { return cppurl::log_level::debug; }
+    if (name == "info") { return cppurl::log_level::info; }
+    if (name == "warning") { return cppurl::log_level::warning; }
+    if (name == "error") { return cppurl::log_level::error; }
+    if (name == "off") { return cppurl::log_level::off; }
+    throw std::invalid_argument{std::format("unknown log level {}", name)};
+}
+
+
+auto log_response(cppurl::logger &log,
+                  cppurl::log_level level,
+                  cppurl::handle_info &info) -> cppurl::notifier::status {
+    auto response{info.response()};
+    FORWARD_UNEXPECTED(response);
+    if (response->empty()) { return cppurl::status_ok; }
+    auto code{info.response_code()};
+    FORWARD_UNEXPECTED(code);
+    log.log(level, cppurl::logger::event::response, *code, *response);
+    return cppurl::status_ok;
+}
+
+
+/*callbacks are called concurrently when --threads > 1, every thread logs to
+ * a ring of its own*/
+auto on_successful_transfer(cppurl::logger &log) {
+    return [&log](cppurl::handle_info info) -> cppurl::notifier::status {
+        constexpr auto level{cppurl::log_level::info};
+        if (!log.sample(level)) { return cppurl::status_ok; }
         auto h{info.handle()};
         FORWARD_UNEXPECTED(h);
-        std::cout << std::format(
-            "\n///\nHandle for {} has completed successfully\n///\n",
-            (*h)->url());
-        return cppurl::status_ok;
+        log.log(level,
+                cppurl::logger::event::transfer_succeeded,
+                static_cast<int64_t>((*h)->items()),
+                (*h)->url());
+        return log_response(log, level, info);
     };
 }
 
 
-auto on_unsuccessful_transfer() {
-    return [](cppurl::handle_info info) -> cppurl::notifier::status {
+auto on_unsuccessful_transfer(cppurl::logger &log) {
+    return [&log](cppurl::handle_info info) -> cppurl::notifier::status {
+        constexpr auto level{cppurl::log_level::warning};
+        if (!log.sample(level)) { return cppurl::status_ok; }
         auto h{info.handle()};
         FORWARD_UNEXPECTED(h);
-        std::cout << std::format(
-            "\n///\nHandle for {} has failed. Reason: {}\n///\n",
-            (*h)->url(),
-            info.status().what());
-        return cppurl::status_ok;
+        log.log(level,
+                cppurl::logger::event::transfer_failed,
+                static_cast<int64_t>((*h)->items()),
+                (*h)->url(),
+                info.status().what());
+        return log_response(log, level, info);
     };
 }
 
@@ -50,6 +306,73 @@ auto on_success(auto &t, std::string_view url) {
 }
 
 
+auto on_stats(const cppurl::notifier_stats &stats) {
+    auto &transfers{stats.multiplexing};
+    std::cout << std::format(
+        "{} transfers over {} new connections ({:.1f} streams per "
+        "connection)\n",
+        transfers.transfers,
+        transfers.connections,
+        transfers.streams_per_connection());
+    auto &requests{stats.requests};
+    if (requests.unrouted > 0) {
+        std::cout << std::format("{} requests had no destination\n",
+                                 requests.unrouted);
+    }
+    if (requests.suppressed > 0) {
+        std::cout << std::format("{} repeated requests were suppressed\n",
+                                 requests.suppressed);
+    }
+    if (requests.oversized > 0) {
+        std::cout << std::format(
+            "{} lines were skipped (longer than --max-line-size)\n",
+            requests.oversized);
+    }
+    if (requests.rejected > 0) {
+        std::cout << std::format(
+            "{} requests were rejected (CR or LF in a header value)\n",
+            requests.rejected);
+    }
+    if (stats.spool.unspooled > 0) {
+        std::cout << std::format(
+            "{} requests could not be written to the spool\n",
+            stats.spool.unspooled);
+    }
+    if (stats.spool.failed_commits > 0) {
+        std::cout << std::format("{} commits of the spool failed\n",
+                                 stats.spool.failed_commits);
+    }
+    auto &queue{stats.queue};
+    if (queue.paused > 0) {
+        std::cout << std::format("reading was paused {} times (queue full)\n",
+                                 queue.paused);
+    }
+    if (queue.dropped_oldest + queue.dropped_newest > 0) {
+        std::cout << std::format(
+            "{} oldest and {} newest requests were dropped (queue full)\n",
+            queue.dropped_oldest,
+            queue.dropped_newest);
+    }
+    /*a single lane is reported only if some of its requests expired*/
+    auto lanes{std::ranges::count_if(
+        queue.lanes, [](auto &lane) { return lane.enqueued > 0; })};
+    auto expired{std::ranges::any_of(
+        queue.lanes, [](auto &lane) { return lane.expired > 0; })};
+    if (lanes < 2 && !expired) { return; }
+    for (size_t i{0}; i < queue.lanes.size(); ++i) {
+        auto &lane{queue.lanes[i]};
+        if (lane.enqueued == 0) { continue; }
+        std::cout << std::format(
+            "lane {}: {} enqueued, {} sent, {} expired, {} dropped\n",
+            i,
+            lane.enqueued,
+            lane.sent,
+            lane.expired,
+            lane.dropped);
+    }
+}
+
+
 auto on_fail(auto status, std::string_view url) {
     std::cout << std::format(
         "Post requests for url = {} failed! Reason:{}\n\n", url, status.what());
@@ -67,10 +390,175 @@ int main(int argc, char const *argv[]) {
             std::cout << options.help() << std::endl;
             return 0;
         }
-        url = result["url"].as<std::string>();
+        if (result.count("url")) { url = result["url"].as<std::string>(); }
+        std::optional<cppurl::route_table> routes{};
+        if (result.count("routes")) {
+            routes.emplace(result["routes"].as<std::string>());
+        }
+        if (url.empty() && !routes) {
+            throw std::invalid_argument{"either url or routes must be given"};
+        }
+        std::optional<cppurl::mapped_input> input{};
+        if (result.count("input")) {
+            if (result.count("spool")) {
+                throw std::invalid_argument{
+                    "input is read from its start on every run, thus it "
+                    "cannot be spooled"};
+            }
+            input.emplace(result["input"].as<std::string>(),
+                          parse_record_framing(
+                              result["input-framing"].as<std::string>()));
+        }
+        std::optional<cppurl::spool> spool{};
+        if (result.count("spool")) {
+            spool.emplace(cppurl::spool_options{
+                .directory = result["spool"].as<std::string>(),
+                .segment_size =
+                    static_cast<size_t>(
+                        std::max(result["spool-segment-size"].as<int>(), 1)) *
+                    1024 * 1024,
+                .sync_interval = std::chrono::milliseconds{
+                    std::max(result["spool-sync-interval"].as<int>(), 0)}});
+        }
+        std::optional<cppurl::metrics> metrics{};
+        std::optional<cppurl::metrics_exporter> exporter{};
+        if (result.count("metrics")) {
+            metrics.emplace();
+            exporter.emplace(
+                *metrics,
+                cppurl::metrics_export_options{
+                    .path = result["metrics"].as<std::string>(),
+                    .interval = std::chrono::milliseconds{
+                        std::max(result["metrics-interval"].as<int>(), 1)}});
+        }
         auto interval{std::chrono::seconds{result["interval"].as<int>()}};
-        cppurl::notifier ex1{url, interval};
-        status = ex1.run(on_successful_transfer(), on_unsuccessful_transfer());
+        auto max_connections{result["max-connections"].as<int>()};
+        auto min_connections{result["min-connections"].as<int>()};
+        if (max_connections < 1 || min_connections < 0 ||
+            min_connections > max_connections) {
+            throw std::invalid_argument{
+                "connections must satisfy 0 <= min <= max and max > 0"};
+        }
+        cppurl::notifier_options notifier_options{
+            .engine = parse_engine(result["engine"].as<std::string>()),
+            .poll_wait_time = std::chrono::milliseconds{
+                std::max(result["poll-wait-time"].as<int>(), 1)},
+            .max_connections = static_cast<size_t>(max_connections),
+            .min_connections = static_cast<size_t>(min_connections),
+            .max_destination_connections = static_cast<size_t>(
+                std::max(result["max-destination-connections"].as<int>(), 0)),
+            .routes = routes ? &*routes : nullptr,
+            .batching = {
+                .framing = parse_framing(result["batch"].as<std::string>()),
+                .max_items = static_cast<size_t>(
+                    std::max(result["batch-items"].as<int>(), 1)),
+                .max_bytes = static_cast<size_t>(
+                    std::max(result["batch-bytes"].as<int>(), 1)),
+                .linger = std::chrono::milliseconds{
+                    std::max(result["batch-linger"].as<int>(), 0)}},
+            .priorities = {.lanes = static_cast<size_t>(std::clamp(
+                               result["lanes"].as<int>(),
+                               1,
+                               static_cast<int>(cppurl::max_lanes))),
+                           .ttl = std::chrono::milliseconds{
+                               std::max(result["ttl"].as<int>(), 0)},
+                           .prefix = result["priority-prefix"].as<bool>()},
+            .dedup = {.window = std::chrono::milliseconds{std::max(
+                          result["dedup-window"].as<int>(), 0)},
+                      .capacity = static_cast<size_t>(
+                          std::max(result["dedup-capacity"].as<int>(), 1)),
+                      .key = result["dedup-key"].as<std::string>()},
+            .http2 = {
+                .enabled = result["http2"].as<bool>() ||
+                           result["http2-prior-knowledge"].as<bool>(),
+                .prior_knowledge = result["http2-prior-knowledge"].as<bool>(),
+                .max_host_connections = static_cast<size_t>(
+                    std::max(result["max-host-connections"].as<int>(), 0)),
+                .max_concurrent_streams = static_cast<size_t>(
+                    std::max(result["max-concurrent-streams"].as<int>(), 1))},
+            .compression = {.method = parse_compression(
+                                result["compress"].as<std::string>()),
+                            .min_size = static_cast<size_t>(std::max(
+                                result["compress-min-size"].as<int>(), 0)),
+                            .level = result["compress-level"].as<int>()},
+            .retries = {
+                .max_retries = static_cast<size_t>(
+                    std::max(result["retries"].as<int>(), 0)),
+                .base_delay = std::chrono::milliseconds{
+                    std::max(result["retry-base-delay"].as<int>(), 0)},
+                .max_delay = std::chrono::milliseconds{
+                    std::max(result["retry-max-delay"].as<int>(), 0)}},
+            .rate = {.requests_per_second = result["rate"].as<double>(),
+                     .bytes_per_second = result["byte-rate"].as<double>(),
+                     .burst_requests = result["burst"].as<double>(),
+                     .burst_bytes = result["byte-burst"].as<double>()},
+            .backpressure =
+                {.high_items = static_cast<size_t>(
+                     std::max(result["queue-high-items"].as<int>(), 0)),
+                 .low_items = static_cast<size_t>(
+                     std::max(result["queue-low-items"].as<int>(), 0)),
+                 .high_bytes = static_cast<size_t>(
+                     std::max(result["queue-high-bytes"].as<int64_t>(),
+                              int64_t{0})),
+                 .low_bytes = static_cast<size_t>(
+                     std::max(result["queue-low-bytes"].as<int64_t>(),
+                              int64_t{0})),
+                 .overflow = parse_overflow(
+                     result["overflow"].as<std::string>())},
+            .max_response_size = static_cast<size_t>(
+                std::max(result["capture-response"].as<int>(), 0)),
+            .spool = spool ? &*spool : nullptr,
+            .metrics = metrics ? &*metrics : nullptr,
+            .max_line_size = static_cast<size_t>(
+                std::max(result["max-line-size"].as<int64_t>(), int64_t{1})),
+            .input = input ? &*input : nullptr,
+            .headers = result.count("header")
+                           ? result["header"].as<std::vector<std::string>>()
+                           : std::vector<std::string>{},
+            .body_template = result.count("body-template")
+                                 ? result["body-template"].as<std::string>()
+                                 : std::string{}};
+        cppurl::logger log{cppurl::logger_options{
+            .level = parse_log_level(result["log-level"].as<std::string>()),
+            .sample_every = static_cast<size_t>(
+                std::max(result["log-sample"].as<int>(), 1)),
+            .flush_interval = std::chrono::milliseconds{
+                std::max(result["log-flush-interval"].as<int>(), 1)}}};
+        /*records are written by the logger thread, everything printed
+         * directly goes after log.flush()*/
+        auto flush_log{[&] {
+            if (::should_stop) {
+                log.message(cppurl::log_level::info,
+                            "\n///\nReceived interruption signal\n///\n");
+            }
+            log.flush();
+        }};
+        auto threads{result["threads"].as<int>()};
+        if (threads < 1) {
+            throw std::invalid_argument{"number of threads must be positive"};
+        }
+        if (threads == 1) {
+            cppurl::notifier ex1{url, interval, notifier_options};
+            status = ex1.run(on_successful_transfer(log),
+                             on_unsuccessful_transfer(log));
+            flush_log();
+            on_stats(ex1.stats());
+        } else {
+            cppurl::sharded_notifier ex1{
+                url,
+                interval,
+                {.threads = static_cast<size_t>(threads),
+                 .pin_threads = result["pin-threads"].as<bool>()},
+                notifier_options};
+            status = ex1.run(on_successful_transfer(log),
+                             on_unsuccessful_transfer(log));
+            flush_log();
+            on_stats(ex1.stats());
+        }
+        if (input && input->truncated()) {
+            std::cout << "Input ends with an incomplete length prefixed "
+                         "request, which was not sent\n";
+        }
     } catch (const std::exception &e) {
         std::cout << std::format("Exception was thrown. Reason: {}\n\n",
                                  e.what());
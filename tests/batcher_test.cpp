@@ -0,0 +1,121 @@
+#include <batcher.hpp>
+#include <chrono>
+#include <cstdint>
+#include <request_arena.hpp>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::batch_options;
+    using cppurl::batcher;
+    using cppurl::framing;
+    using cppurl::request_arena;
+
+
+    /**
+     * @brief      Without framing every request is a batch of its own, posted
+     * as the stored view.
+     */
+    auto unframed() {
+        request_arena arena{};
+        batcher b{};
+        auto req{arena.append("a")};
+        auto data{req.body().data()};
+        b.push(std::move(req), 7);
+        CHECK(b.ready() && b.size() == 1 && b.bytes() == 1);
+        auto batch{b.next(arena)};
+        CHECK(batch.items == 1 && batch.body.body() == "a");
+        CHECK(batch.body.body().data() == data);
+        CHECK((std::vector<uint64_t>(batch.tickets.begin(),
+                                     batch.tickets.end()) ==
+               std::vector<uint64_t>{7}));
+        CHECK(b.empty() && b.bytes() == 0);
+    }
+
+
+    /**
+     * @brief      Requests are packed as ndjson or a JSON array, up to
+     * max_items.
+     */
+    auto framed() {
+        request_arena arena{};
+        for (auto [f, first, second] :
+             {std::tuple{framing::ndjson, "1\n2\n", "3\n"},
+              std::tuple{framing::json_array, "[1,2]", "[3]"}}) {
+            batcher b{batch_options{.framing = f, .max_items = 2}};
+            b.push(arena.append("1"), 1);
+            b.push(arena.append("2"));
+            b.push(arena.append("3"), 3);
+            CHECK(b.ready());
+            auto batch{b.next(arena)};
+            CHECK(batch.items == 2 && batch.body.body() == first);
+            CHECK(batch.tickets.size() == 1 && batch.tickets[0] == 1);
+            batch = b.next(arena);
+            CHECK(batch.items == 1 && batch.body.body() == second);
+            CHECK(batch.tickets.size() == 1 && batch.tickets[0] == 3);
+            CHECK(b.empty());
+        }
+    }
+
+
+    /**
+     * @brief      A batch does not grow over max_bytes, but a single request
+     * bigger than that is still sent.
+     */
+    auto max_bytes() {
+        request_arena arena{};
+        batcher b{batch_options{.framing = framing::json_array,
+                                .max_items = 10,
+                                .max_bytes = 7}};
+        b.push(arena.append("12"));
+        b.push(arena.append("34"));
+        b.push(arena.append("too long"));
+        CHECK(b.ready());
+        CHECK(b.next(arena).body.body() == "[12,34]");
+        auto batch{b.next(arena)};
+        CHECK(batch.items == 1 && batch.body.body() == "[too long]");
+    }
+
+
+    /**
+     * @brief      A partial batch waits for linger since its oldest request,
+     * expired requests are dropped and their tickets returned.
+     */
+    auto linger_and_expiry() {
+        using clock_type = batcher::clock_type;
+        request_arena arena{};
+        batcher b{batch_options{.framing = framing::ndjson,
+                                .linger = std::chrono::seconds{10}},
+                  2};
+        auto now{clock_type::now()};
+        b.push(arena.append("old"), 1, now - std::chrono::seconds{20},
+               {.lane = 1});
+        CHECK(b.ready() && b.wait_time() == 0);
+        b.push(arena.append("gone"), 2, now,
+               {.lane = 0, .deadline = now - std::chrono::seconds{1}});
+        b.push(arena.append("urgent"), 3, now, {.lane = 0});
+        auto batch{b.next(arena)};
+        CHECK(batch.items == 2 && batch.body.body() == "urgent\nold\n");
+        CHECK(batch.expired.size() == 1 && batch.expired[0] == 2);
+        CHECK(batch.enqueued == now - std::chrono::seconds{20});
+
+        b.push(arena.append("new"), 4, clock_type::now());
+        CHECK(!b.ready());
+        CHECK(b.wait_time() > 9000 && b.wait_time() <= 10000);
+    }
+
+}  // namespace
+
+
+int main() {
+    unframed();
+    framed();
+    max_bytes();
+    linger_and_expiry();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+
+/**
+ * @brief      Aborts the test if the condition does not hold (unlike assert,
+ * also in release builds).
+ */
+#define CHECK(condition)                                                    \
+    {                                                                       \
+        if (!(condition)) {                                                 \
+            std::fprintf(                                                   \
+                stderr, "%s:%d: %s\n", __FILE__, __LINE__, #condition);     \
+            std::abort();                                                   \
+        }                                                                   \
+    }
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <deduplicator.hpp>
+#include <string>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using namespace std::chrono_literals;
+    using cppurl::deduplicator;
+
+
+    /**
+     * @brief      A request repeated within the window is suppressed, the
+     * window is counted from the accepted request only.
+     */
+    auto window_expiry() {
+        deduplicator d{{.window = 100ms}};
+        deduplicator::clock_type::time_point t{};
+        CHECK(!d.duplicate("a", t));
+        CHECK(d.duplicate("a", t + 50ms));
+        CHECK(!d.duplicate("b", t + 50ms));
+        /*the suppressed request did not extend the window*/
+        CHECK(!d.duplicate("a", t + 100ms));
+        CHECK(d.duplicate("a", t + 199ms));
+        CHECK(!d.duplicate("a", t + 200ms));
+    }
+
+
+    /**
+     * @brief      A zero window never suppresses.
+     */
+    auto zero_window() {
+        deduplicator d{{}};
+        deduplicator::clock_type::time_point t{};
+        CHECK(!d.duplicate("a", t));
+        CHECK(!d.duplicate("a", t));
+    }
+
+
+    /**
+     * @brief      A full table evicts the request closest to the end of its
+     * window, which may pass again.
+     */
+    auto eviction() {
+        /*a single run of slots*/
+        deduplicator d{{.window = 1h, .capacity = 8}};
+        deduplicator::clock_type::time_point t{};
+        for (int i{0}; i < 9; ++i) {
+            CHECK(!d.duplicate(std::to_string(i), t + i * 1ms));
+        }
+        /*0 was evicted by 8, and 0 evicts 1*/
+        CHECK(!d.duplicate("0", t + 10ms));
+        CHECK(!d.duplicate("1", t + 11ms));
+        for (int i{3}; i < 9; ++i) {
+            CHECK(d.duplicate(std::to_string(i), t + 12ms));
+        }
+    }
+
+
+    /**
+     * @brief      With a key, requests with an equal field are equal and
+     * requests without it are never suppressed.
+     */
+    auto key() {
+        deduplicator d{{.window = 1h, .key = "id"}};
+        deduplicator::clock_type::time_point t{};
+        CHECK(!d.duplicate(R"({"id":1,"text":"a"})", t));
+        CHECK(d.duplicate(R"({"text":"b","id":1})", t));
+        CHECK(!d.duplicate(R"({"id":2,"text":"a"})", t));
+        CHECK(!d.duplicate(R"({"text":"a"})", t));
+        CHECK(!d.duplicate(R"({"text":"a"})", t));
+    }
+
+}  // namespace
+
+
+int main() {
+    window_expiry();
+    zero_window();
+    eviction();
+    key();
+}
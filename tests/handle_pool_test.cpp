@@ -0,0 +1,140 @@
+#include <chrono>
+#include <cppurl.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::b_handle;
+    using cppurl::b_status;
+    using pool_type = cppurl::handle_pool<>;
+
+
+    /**
+     * @brief      Handles are created up front up to min, on demand up to
+     * max and configured once. size() counts free handles and those which
+     * can still be created.
+     */
+    auto grow() {
+        size_t configured{0};
+        pool_type pool{2, 4, [&](b_handle &) {
+                           ++configured;
+                           return b_status{CURLE_OK};
+                       }};
+        CHECK(configured == 2 && pool.allocated() == 2);
+        CHECK(pool.size() == 4 && pool.in_use() == 0);
+        std::vector<b_handle *> handles{};
+        for (size_t i{0}; i < 4; ++i) {
+            auto h{pool.get()};
+            CHECK(h && *h);
+            handles.push_back(*h);
+        }
+        CHECK(configured == 4 && pool.allocated() == 4);
+        CHECK(pool.size() == 0 && pool.in_use() == 4);
+        pool.add(*handles.back());
+        CHECK(pool.size() == 1 && pool.in_use() == 3);
+        /*a free handle is reused without configuring it again*/
+        auto h{pool.get()};
+        CHECK(h && *h == handles.back() && configured == 4);
+        for (auto handle : handles) { pool.add(*handle); }
+        CHECK(pool.size() == 4 && pool.in_use() == 0);
+    }
+
+
+    /**
+     * @brief      Idle free handles are destroyed until min handles are left
+     * (handles in use included), handles in use are kept.
+     */
+    auto trim() {
+        pool_type kept{0, 2};
+        auto a{kept.get()};
+        CHECK(a);
+        kept.add(**a);
+        /*the default idle timeout did not elapse*/
+        CHECK(kept.trim() == 0 && kept.allocated() == 1);
+
+        pool_type pool{1, 4, {}, std::chrono::seconds{0}};
+        std::vector<b_handle *> handles{};
+        for (size_t i{0}; i < 4; ++i) { handles.push_back(*pool.get()); }
+        pool.add(*handles[0]);
+        pool.add(*handles[1]);
+        pool.add(*handles[2]);
+        CHECK(pool.trim() == 3);
+        CHECK(pool.allocated() == 1 && pool.in_use() == 1);
+        CHECK(pool.size() == 3);
+        pool.add(*handles[3]);
+        CHECK(pool.trim() == 0 && pool.allocated() == 1);
+        CHECK(pool.size() == 4 && pool.in_use() == 0);
+        /*the handle left is reused*/
+        auto h{pool.get()};
+        CHECK(h && *h == handles[3]);
+    }
+
+
+    /**
+     * @brief      A failed configuration of a new handle is returned by get()
+     * and thrown by the constructor for handles created up front.
+     */
+    auto configure_failure() {
+        auto fail{true};
+        pool_type pool{0, 2, [&](b_handle &) {
+                           return b_status{fail ? CURLE_FAILED_INIT
+                                                : CURLE_OK};
+                       }};
+        auto h{pool.get()};
+        CHECK(!h && h.error().code == CURLE_FAILED_INIT);
+        CHECK(pool.allocated() == 0 && pool.size() == 2);
+        fail = false;
+        CHECK(pool.get());
+
+        auto thrown{false};
+        try {
+            pool_type up_front{1, 2, [](b_handle &) {
+                                   return b_status{CURLE_FAILED_INIT};
+                               }};
+        } catch (const std::runtime_error &) { thrown = true; }
+        CHECK(thrown);
+    }
+
+
+    /**
+     * @brief      Handles may be added back from other threads.
+     */
+    auto concurrent_add() {
+        constexpr size_t handles{64};
+        pool_type pool{0, handles};
+        for (size_t round{0}; round < 100; ++round) {
+            std::vector<b_handle *> taken{};
+            for (size_t i{0}; i < handles; ++i) {
+                taken.push_back(*pool.get());
+            }
+            CHECK(pool.size() == 0);
+            std::vector<std::thread> threads{};
+            for (size_t t{0}; t < 4; ++t) {
+                threads.emplace_back([&, t] {
+                    for (auto i{t}; i < handles; i += 4) {
+                        pool.add(*taken[i]);
+                    }
+                });
+            }
+            for (auto &t : threads) { t.join(); }
+            CHECK(pool.size() == handles && pool.in_use() == 0);
+        }
+        CHECK(pool.allocated() == handles);
+    }
+
+}  // namespace
+
+
+int main() {
+    cppurl::curl_global global{};
+    grow();
+    trim();
+    configure_failure();
+    concurrent_add();
+}
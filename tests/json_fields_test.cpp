@@ -0,0 +1,75 @@
+#include <json_fields.hpp>
+#include <string_view>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::json_fields;
+
+
+    /**
+     * @brief      Values of JSON fields.
+     */
+    auto find() {
+        auto f{[](std::string_view body, std::string_view name) {
+            return json_fields::find(body, name);
+        }};
+        CHECK(f(R"({"id":42,"x":1})", "id") == "42");
+        CHECK(f(R"({"id" : "a\"b" })", "id") == R"(a\"b)");
+        CHECK(f(R"({"user":{"id":7}})", "id") == "7");
+        CHECK(f(R"({"xid":1,"id":true})", "id") == "true");
+        CHECK(f(R"({"text":"id","id":5})", "id") == "5");
+        CHECK(f(R"({"id":)", "id").empty());
+        CHECK(f(R"({"idx":1})", "id").empty());
+        CHECK(f(R"({"id":"unterminated)", "id") == "unterminated");
+    }
+
+
+    /**
+     * @brief      The values of all added fields are extracted at once,
+     * names added twice are extracted once.
+     */
+    auto extract() {
+        json_fields fields{};
+        CHECK(fields.empty());
+        fields.add("id");
+        fields.add("kind");
+        fields.add("id");
+        CHECK(!fields.empty());
+        CHECK(fields.value("id").empty());
+        fields.extract(R"({"kind":"a","id":3})");
+        CHECK(fields.value("id") == "3" && fields.value("kind") == "a");
+        CHECK(fields.value("other").empty());
+        fields.extract(R"({"other":1})");
+        CHECK(fields.value("id").empty() && fields.value("kind").empty());
+    }
+
+
+    /**
+     * @brief      CR or LF in an extracted value, other fields do not count.
+     */
+    auto contain() {
+        json_fields fields{};
+        fields.add("id");
+        fields.add("kind");
+        fields.extract(R"({"kind":"a","id":3})");
+        CHECK(!fields.contain("\r\n"));
+        fields.extract("{\"kind\":\"a\\r\nb\",\"id\":3}");
+        CHECK(fields.contain("\r\n"));
+        fields.extract("{\"id\":3\r,\"kind\":\"a\"}");
+        CHECK(fields.contain("\r\n"));
+        fields.extract("{\"x\":\"\r\n\",\"id\":3}");
+        CHECK(!fields.contain("\r\n"));
+    }
+
+}  // namespace
+
+
+int main() {
+    find();
+    extract();
+    contain();
+}
@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <line_scanner.hpp>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::line_scanner;
+    using cppurl::simd;
+
+
+    /**
+     * @brief      Lines and offset of the tail returned by split.
+     */
+    struct result {
+        std::vector<std::string_view> lines{};
+        size_t tail{};
+
+        auto operator==(const result &) const -> bool = default;
+    };
+
+
+    auto split(std::string_view data, simd s) {
+        result r{};
+        r.tail = line_scanner::split(
+            data, [&](std::string_view line) { r.lines.push_back(line); }, s);
+        return r;
+    }
+
+
+    /**
+     * @brief      Instruction sets supported by this cpu.
+     */
+    auto supported() {
+        std::vector<simd> all{simd::scalar};
+#ifdef CPPURL_X86
+        if (__builtin_cpu_supports("sse2")) { all.push_back(simd::sse2); }
+        if (__builtin_cpu_supports("avx2")) { all.push_back(simd::avx2); }
+#endif
+        return all;
+    }
+
+
+    /**
+     * @brief      Every supported instruction set splits data like the
+     * scalar loop.
+     */
+    auto agree(std::string_view data) {
+        auto expected{split(data, simd::scalar)};
+        for (auto s : supported()) { CHECK(split(data, s) == expected); }
+        return expected;
+    }
+
+
+    /**
+     * @brief      Short and empty lines, with and without an unterminated
+     * tail, inside one block and across blocks.
+     */
+    auto short_lines() {
+        CHECK(agree("").lines.empty());
+        auto r{agree("a\n\nbc\ntail")};
+        CHECK((r.lines == std::vector<std::string_view>{"a", "", "bc"}));
+        CHECK(r.tail == 6);
+
+        std::string data{};
+        for (int i{0}; i < 100; ++i) { data += std::string(i % 7, 'x') + '\n'; }
+        r = agree(data);
+        CHECK(r.lines.size() == 100 && r.tail == data.size());
+        data += "unterminated";
+        r = agree(data);
+        CHECK(r.lines.size() == 100 && r.tail == data.size() - 12);
+    }
+
+
+    /**
+     * @brief      Lines longer than long_line_blocks blocks are finished by
+     * skip(), also when the newline is the first or last byte of a block
+     * and when a long line is the unterminated tail.
+     */
+    auto long_lines() {
+        for (size_t size : {255, 256, 257, 319, 320, 1000, 4096}) {
+            std::string data{"a\n"};
+            data += std::string(size, 'x') + '\n';
+            data += "b\n";
+            data += std::string(size, 'y') + '\n';
+            data += std::string(size, 'z');
+            auto r{agree(data)};
+            CHECK(r.lines.size() == 4);
+            CHECK(r.lines[1].size() == size && r.lines[3].size() == size);
+            CHECK(r.tail == data.size() - size);
+        }
+        /*only newlines after a long line*/
+        auto r{agree(std::string(300, 'x') + std::string(200, '\n'))};
+        CHECK(r.lines.size() == 200 && r.lines[0].size() == 300);
+    }
+
+
+    /**
+     * @brief      Random buffers with a varying density of newlines.
+     */
+    auto random_buffers() {
+        std::mt19937 gen{42};
+        for (int round{0}; round < 2000; ++round) {
+            std::uniform_int_distribution<size_t> size_of{0, 2000};
+            /*one newline in one_in bytes on average*/
+            std::uniform_int_distribution<unsigned> byte{0, 255};
+            auto one_in{1u << (round % 10)};
+            std::string data(size_of(gen), '\0');
+            for (auto &c : data) {
+                c = gen() % one_in == 0 ? '\n' : static_cast<char>(byte(gen));
+            }
+            agree(data);
+        }
+    }
+
+}  // namespace
+
+
+int main() {
+    short_lines();
+    long_lines();
+    random_buffers();
+}
@@ -0,0 +1,155 @@
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mapped_input.hpp>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::mapped_input;
+    using cppurl::record_framing;
+
+
+    /**
+     * @brief      Unique temporary file removed at the end of the test.
+     */
+    struct temporary_file {
+        std::filesystem::path path{};
+
+        explicit temporary_file(std::string_view content) {
+            auto pattern{(std::filesystem::temp_directory_path() /
+                          "mapped_input_test.XXXXXX")
+                             .string()};
+            auto fd{::mkstemp(pattern.data())};
+            CHECK(fd != -1);
+            ::close(fd);
+            path = pattern;
+            std::ofstream{path, std::ios::binary}.write(
+                content.data(), static_cast<std::streamsize>(content.size()));
+        }
+
+        ~temporary_file() { std::filesystem::remove(path); }
+    };
+
+
+    /**
+     * @brief      A record with its 32 bit little endian size.
+     */
+    auto record(std::string_view body) {
+        auto size{static_cast<uint32_t>(body.size())};
+        std::string r{};
+        for (int i{0}; i < 4; ++i) {
+            r.push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+        }
+        return r.append(body);
+    }
+
+
+    /**
+     * @brief      Reads all requests of a file.
+     */
+    auto read_all(mapped_input &input, size_t max = SIZE_MAX) {
+        std::vector<std::string> requests{};
+        input.read(max, [&](std::string_view req) {
+            requests.emplace_back(req);
+        });
+        return requests;
+    }
+
+
+    /**
+     * @brief      Lines are split at newlines, empty ones are skipped and
+     * the last one needs no newline.
+     */
+    auto lines() {
+        temporary_file f{"a\n\nbc\n\nd"};
+        mapped_input input{f.path};
+        CHECK(input.size() == 8);
+        CHECK((read_all(input, 2) == std::vector<std::string>{"a", "bc"}));
+        CHECK(!input.eof());
+        CHECK((read_all(input) == std::vector<std::string>{"d"}));
+        CHECK(input.eof() && !input.truncated());
+        CHECK(read_all(input).empty());
+    }
+
+
+    /**
+     * @brief      Length prefixed records may contain newlines, zero-length
+     * records are skipped.
+     */
+    auto length_prefixed() {
+        temporary_file f{record("a\nb") + record("") + record("c") +
+                         record("")};
+        mapped_input input{f.path, record_framing::length_prefixed};
+        CHECK((read_all(input, 1) == std::vector<std::string>{"a\nb"}));
+        CHECK((read_all(input) == std::vector<std::string>{"c"}));
+        CHECK(input.eof() && !input.truncated());
+        CHECK(input.offset() == input.size());
+    }
+
+
+    /**
+     * @brief      A file ending in the middle of the size or the body of a
+     * record is truncated, the partial record is not read.
+     */
+    auto truncated() {
+        for (auto tail : {std::string{"\x05\x00", 2},
+                          record("abcde").substr(0, 7)}) {
+            temporary_file f{record("a") + tail};
+            mapped_input input{f.path, record_framing::length_prefixed};
+            CHECK((read_all(input) == std::vector<std::string>{"a"}));
+            CHECK(input.eof() && input.truncated());
+        }
+        /*a size beyond the end of the file*/
+        temporary_file f{std::string{"\xff\xff\xff\xff", 4} + "abc"};
+        mapped_input input{f.path, record_framing::length_prefixed};
+        CHECK(read_all(input).empty());
+        CHECK(input.eof() && input.truncated());
+    }
+
+
+    /**
+     * @brief      An empty file is not mapped and has no requests.
+     */
+    auto empty() {
+        temporary_file f{""};
+        for (auto framing :
+             {record_framing::lines, record_framing::length_prefixed}) {
+            mapped_input input{f.path, framing};
+            CHECK(input.eof() && !input.truncated());
+            CHECK(read_all(input).empty());
+        }
+    }
+
+
+    /**
+     * @brief      A missing file throws.
+     */
+    auto missing() {
+        auto thrown{false};
+        try {
+            mapped_input input{"/nonexistent/mapped_input_test.bin"};
+        } catch (const std::system_error &) { thrown = true; }
+        CHECK(thrown);
+    }
+
+}  // namespace
+
+
+int main() {
+    lines();
+    length_prefixed();
+    truncated();
+    empty();
+    missing();
+}
@@ -0,0 +1,84 @@
+#include <atomic>
+#include <cstddef>
+#include <mpsc_queue.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::mpsc_queue;
+
+
+    /**
+     * @brief      A full queue rejects items (and leaves them intact), and
+     * items come out in order.
+     */
+    auto bounded() {
+        mpsc_queue<std::string> q{3};
+        CHECK(q.capacity() == 4);
+        for (int i{0}; i < 4; ++i) { CHECK(q.push(std::to_string(i))); }
+        std::string rejected{"x"};
+        CHECK(!q.push(std::move(rejected)));
+        CHECK(rejected == "x");
+        std::vector<std::string> items{};
+        CHECK(q.pop(3, [&](std::string &&s) { items.push_back(s); }) == 3);
+        CHECK(q.push("4"));
+        CHECK(q.pop(10, [&](std::string &&s) { items.push_back(s); }) == 2);
+        CHECK((items == std::vector<std::string>{"0", "1", "2", "3", "4"}));
+        CHECK(q.size() == 0);
+    }
+
+
+    /**
+     * @brief      Producers push to a small queue concurrently, retrying
+     * while it is full. Every item arrives exactly once and items of a
+     * single producer keep their order.
+     */
+    auto producers() {
+        constexpr size_t producers{4};
+        constexpr size_t per_producer{50'000};
+        struct item {
+            size_t producer{0};
+            size_t sequence{0};
+        };
+        mpsc_queue<item> q{64};
+        std::atomic<bool> start{false};
+        std::vector<std::thread> threads{};
+        for (size_t p{0}; p < producers; ++p) {
+            threads.emplace_back([&, p] {
+                while (!start.load()) { std::this_thread::yield(); }
+                for (size_t i{0}; i < per_producer; ++i) {
+                    while (!q.push({p, i})) { std::this_thread::yield(); }
+                }
+            });
+        }
+        start = true;
+        std::vector<size_t> next(producers, 0);
+        size_t received{0};
+        while (received < producers * per_producer) {
+            auto popped{q.pop(q.capacity(), [&](item &&it) {
+                CHECK(it.producer < producers);
+                CHECK(it.sequence == next[it.producer]);
+                ++next[it.producer];
+            })};
+            if (popped == 0) { std::this_thread::yield(); }
+            received += popped;
+        }
+        for (auto &t : threads) { t.join(); }
+        for (auto n : next) { CHECK(n == per_producer); }
+        CHECK(q.size() == 0);
+        CHECK(q.pop(1, [](item &&) {}) == 0);
+    }
+
+}  // namespace
+
+
+int main() {
+    bounded();
+    producers();
+}
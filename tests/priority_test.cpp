@@ -0,0 +1,132 @@
+#include <chrono>
+#include <format>
+#include <priority_lanes.hpp>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <work_stealing_queue.hpp>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using namespace std::chrono_literals;
+    using cppurl::priority;
+    using cppurl::priority_options;
+
+
+    constexpr priority_options prefixed{.lanes = 3, .ttl = 1s, .prefix = true};
+
+
+    /**
+     * @brief      Lane and size of the prefix of a line.
+     */
+    auto parse(std::string_view line,
+               const priority_options &options = prefixed) {
+        return priority::parse(line, options, priority::clock_type::now());
+    }
+
+
+    /**
+     * @brief      Lanes, time to live and deadlines of valid prefixes.
+     */
+    auto valid() {
+        priority::clock_type::time_point t{};
+        auto [p, prefix] = priority::parse("0\tbody", prefixed, t);
+        CHECK(p.lane == 0 && prefix == 2 && p.deadline == t + 1s);
+        std::tie(p, prefix) = priority::parse("1+500\tbody", prefixed, t);
+        CHECK(p.lane == 1 && prefix == 6 && p.deadline == t + 500ms);
+        /*lanes beyond the last one are clamped*/
+        std::tie(p, prefix) = priority::parse("7\tbody", prefixed, t);
+        CHECK(p.lane == 2 && prefix == 2);
+        /*an empty body is still a request*/
+        std::tie(p, prefix) = priority::parse("1\t", prefixed, t);
+        CHECK(p.lane == 1 && prefix == 2);
+        auto now{priority::clock_type::now()};
+        auto wall{std::chrono::floor<std::chrono::milliseconds>(
+                      std::chrono::system_clock::now()) +
+                  10s};
+        auto line{
+            std::format("0@{}\tbody", wall.time_since_epoch().count())};
+        std::tie(p, prefix) = priority::parse(line, prefixed, now);
+        CHECK(p.lane == 0 && prefix == line.size() - 4);
+        CHECK(p.deadline > now + 9s && p.deadline <= now + 10s);
+    }
+
+
+    /**
+     * @brief      Malformed prefixes are part of the body, the line goes to
+     * the last lane with the default deadline.
+     */
+    auto malformed() {
+        priority::clock_type::time_point t{};
+        for (std::string_view line : {"",
+                                      "body",
+                                      "1",
+                                      "1 body",
+                                      "-1\tbody",
+                                      "x1\tbody",
+                                      "1+\tbody",
+                                      "1+50",
+                                      "1+50x\tbody",
+                                      "1@\tbody",
+                                      "1@5 body",
+                                      "1+5+5\tbody",
+                                      "99999999999999999999999\tbody"}) {
+            auto [p, prefix] = priority::parse(line, prefixed, t);
+            CHECK(prefix == 0);
+            CHECK(p.lane == 2);
+            CHECK(p.deadline == t + 1s);
+        }
+    }
+
+
+    /**
+     * @brief      Without prefix parsing lines keep their prefixes, and
+     * without ttl they never expire.
+     */
+    auto disabled() {
+        auto [p, prefix] = parse("0\tbody", {.lanes = 2});
+        CHECK(p.lane == 1 && prefix == 0);
+        CHECK(p.deadline == priority::clock_type::time_point::max());
+        std::tie(p, prefix) = parse("0\tbody", {.prefix = true});
+        CHECK(p.lane == 0 && prefix == 2);
+    }
+
+
+    /**
+     * @brief      Shards take items lane by lane, drops take the last
+     * non-empty lane.
+     */
+    auto shared_lanes() {
+        cppurl::prioritized_work_queue<int> q{2, 3};
+        q.push(2, 20);
+        q.push(1, 10);
+        q.push(9, 21);
+        q.push(0, 0);
+        CHECK(q.size() == 4 && q.shards() == 2);
+        std::vector<int> dropped{};
+        CHECK(q.drop(0, [&](size_t lane, int item) {
+            CHECK(lane == 2);
+            dropped.push_back(item);
+        }));
+        CHECK(dropped.size() == 1 && dropped.front() / 10 == 2);
+        std::vector<int> popped{};
+        CHECK(q.pop(1, 2, [&](int item) { popped.push_back(item); }) == 2);
+        CHECK((popped == std::vector{0, 10}));
+        CHECK(q.pop(0, 5, [&](int item) { popped.push_back(item); }) == 1);
+        CHECK(q.size() == 0);
+        CHECK(!q.drop(0, [](size_t, int) {}));
+    }
+
+}  // namespace
+
+
+int main() {
+    valid();
+    malformed();
+    disabled();
+    shared_lanes();
+}
@@ -0,0 +1,101 @@
+#include <chrono>
+#include <rate_limiter.hpp>
+#include <thread>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::rate_limiter;
+    using cppurl::rate_options;
+    using cppurl::token_bucket;
+    using namespace std::chrono_literals;
+
+
+    /**
+     * @brief      Posts which can be sent at once.
+     */
+    auto burst_of(rate_limiter &limiter) {
+        int posts{0};
+        while (limiter.ready() && posts < 1000) {
+            limiter.consume(0);
+            ++posts;
+        }
+        return posts;
+    }
+
+
+    /**
+     * @brief      Without rates nothing is limited.
+     */
+    auto unlimited() {
+        rate_limiter limiter{};
+        CHECK(burst_of(limiter) == 1000);
+        limiter.consume(1'000'000);
+        CHECK(limiter.wait_time() == 0);
+        CHECK(token_bucket{}.unlimited());
+    }
+
+
+    /**
+     * @brief      After an idle period a burst is sent at once (one second
+     * worth of the rate by default), then posts are spaced by 1 / rate.
+     */
+    auto burst() {
+        rate_limiter limiter{rate_options{.requests_per_second = 10,
+                                          .burst_requests = 3}};
+        CHECK(burst_of(limiter) == 3);
+        auto wait{limiter.wait_time()};
+        CHECK(wait > 0 && wait <= 100);
+
+        rate_limiter by_default{rate_options{.requests_per_second = 5}};
+        CHECK(burst_of(by_default) == 5);
+    }
+
+
+    /**
+     * @brief      Tokens are refilled continuously, but not above the burst.
+     */
+    auto refill() {
+        rate_limiter limiter{rate_options{.requests_per_second = 20,
+                                          .burst_requests = 2}};
+        CHECK(burst_of(limiter) == 2);
+        /*at least one token after 50 ms (more if the sleep overshoots)*/
+        std::this_thread::sleep_for(60ms);
+        CHECK(burst_of(limiter) >= 1);
+        std::this_thread::sleep_for(300ms);
+        CHECK(burst_of(limiter) == 2);
+    }
+
+
+    /**
+     * @brief      Bytes are charged after a post, so the byte bucket goes
+     * into debt and holds back posts until it is paid off.
+     */
+    auto byte_debt() {
+        rate_limiter limiter{rate_options{.bytes_per_second = 1000,
+                                          .burst_bytes = 100}};
+        CHECK(limiter.ready());
+        limiter.consume(600);
+        auto wait{limiter.wait_time()};
+        CHECK(wait > 400 && wait <= 500);
+        CHECK(!limiter.ready());
+
+        /*a request bigger than the capacity waits only for a full bucket*/
+        token_bucket bucket{10, 2};
+        bucket.consume(2);
+        auto full{bucket.wait_time(5)};
+        CHECK(full > 100 && full <= 200);
+    }
+
+}  // namespace
+
+
+int main() {
+    unlimited();
+    burst();
+    refill();
+    byte_debt();
+}
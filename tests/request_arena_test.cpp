@@ -0,0 +1,133 @@
+#include <cstring>
+#include <optional>
+#include <request_arena.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::request_arena;
+
+
+    /**
+     * @brief      Bodies are appended one after another to the same chunk.
+     */
+    auto contiguous() {
+        request_arena arena{64};
+        auto a{arena.append("abc")};
+        auto b{arena.append("de")};
+        CHECK(a && b);
+        CHECK(a.body() == "abc" && b.body() == "de");
+        CHECK(b.body().data() == a.body().data() + 3);
+    }
+
+
+    /**
+     * @brief      The current chunk is reused from its beginning once every
+     * view into it is released, but not while some view is alive.
+     */
+    auto reuse() {
+        request_arena arena{64};
+        auto a{arena.append("abc")};
+        auto start{a.body().data()};
+        auto b{arena.append("de")};
+        a.reset();
+        CHECK(!a && a.body().empty());
+        auto c{arena.append("f")};
+        CHECK(c.body().data() == start + 5);
+        b.reset();
+        c.reset();
+        auto d{arena.append("ghi")};
+        CHECK(d.body().data() == start && d.body() == "ghi");
+    }
+
+
+    /**
+     * @brief      A full chunk is replaced, its views stay valid until they
+     * are released (also after the arena is destroyed). Bodies bigger than a
+     * chunk get a chunk of their own. Freed chunks are checked by the
+     * address sanitizer.
+     */
+    auto chunks() {
+        std::vector<request_arena::ref> refs{};
+        {
+            request_arena arena{8};
+            refs.push_back(arena.append("12345"));
+            refs.push_back(arena.append("67890"));
+            CHECK(refs[1].body().data() != refs[0].body().data() + 5);
+            refs.push_back(arena.append(std::string(100, 'x')));
+            refs.push_back(arena.append("y"));
+            refs.push_back(arena.append(3, [](char *data) {
+                std::memcpy(data, "abc", 3);
+            }));
+        }
+        CHECK(refs[0].body() == "12345" && refs[1].body() == "67890");
+        CHECK(refs[2].body() == std::string(100, 'x'));
+        CHECK(refs[3].body() == "y" && refs[4].body() == "abc");
+        refs.clear();
+    }
+
+
+    /**
+     * @brief      Views are moved (not copied), remove_prefix keeps the
+     * chunk alive and views made by view() refer to no chunk.
+     */
+    auto views() {
+        std::optional<request_arena> arena{std::in_place, 16};
+        auto a{arena->append("key\tbody")};
+        a.remove_prefix(4);
+        CHECK(a.body() == "body");
+        auto b{std::move(a)};
+        CHECK(!a && b && b.body() == "body");
+        a = std::move(b);
+        CHECK(a && !b);
+        arena.reset();
+        CHECK(a.body() == "body");
+        a.remove_prefix(10);
+        CHECK(a.body().empty());
+        auto v{request_arena::view("outside")};
+        CHECK(!v && v.body() == "outside");
+        request_arena::ref none{};
+        CHECK(!none && none.body().empty());
+    }
+
+
+    /**
+     * @brief      Views may be released by other threads while the arena
+     * appends.
+     */
+    auto concurrent_release() {
+        request_arena arena{256};
+        std::vector<request_arena::ref> refs{};
+        for (int i{0}; i < 10'000; ++i) {
+            refs.push_back(arena.append(std::to_string(i)));
+        }
+        std::thread releaser{[refs = std::move(refs)]() mutable {
+            for (size_t i{0}; i < refs.size(); ++i) {
+                CHECK(refs[i].body() == std::to_string(i));
+                refs[i].reset();
+            }
+        }};
+        for (int i{0}; i < 10'000; ++i) {
+            auto r{arena.append(std::to_string(i))};
+            CHECK(r.body() == std::to_string(i));
+        }
+        releaser.join();
+    }
+
+}  // namespace
+
+
+int main() {
+    contiguous();
+    reuse();
+    chunks();
+    views();
+    concurrent_release();
+}
@@ -0,0 +1,181 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cppurl.hpp>
+#include <format>
+#include <request_arena.hpp>
+#include <retry_scheduler.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::request_arena;
+    using cppurl::retry_options;
+    using cppurl::retry_scheduler;
+    using namespace std::chrono_literals;
+
+
+    /**
+     * @brief      Network errors, timeouts, 408, 429 and most 5xx are
+     * retried, client errors are not.
+     */
+    auto retryable() {
+        CHECK(retry_scheduler::retryable(CURLE_COULDNT_CONNECT, 0));
+        CHECK(retry_scheduler::retryable(CURLE_OPERATION_TIMEDOUT, 0));
+        CHECK(retry_scheduler::retryable(CURLE_OK, 408));
+        CHECK(retry_scheduler::retryable(CURLE_OK, 429));
+        CHECK(retry_scheduler::retryable(CURLE_OK, 503));
+        CHECK(!retry_scheduler::retryable(CURLE_OK, 200));
+        CHECK(!retry_scheduler::retryable(CURLE_OK, 400));
+        CHECK(!retry_scheduler::retryable(CURLE_OK, 501));
+        CHECK(!retry_scheduler::retryable(CURLE_OK, 505));
+        CHECK(!retry_scheduler::retryable(CURLE_URL_MALFORMAT, 0));
+    }
+
+
+    /**
+     * @brief      The n-th delay is at most base * 2^n and at most max_delay,
+     * Retry-After is a lower bound even above max_delay.
+     */
+    auto backoff() {
+        request_arena arena{};
+        retry_scheduler retries{retry_options{
+            .max_retries = 40, .base_delay = 100ms, .max_delay = 1000ms}};
+        CHECK(retries.can_retry(39) && !retries.can_retry(40));
+        for (size_t attempt{0}; attempt < 40; ++attempt) {
+            for (int i{0}; i < 20; ++i) {
+                retries.schedule(arena.append("x"), 1, attempt, {}, {});
+                auto ceiling{attempt < 4 ? 100 << attempt : 1000};
+                CHECK(retries.wait_time() <= ceiling);
+                auto e{retries.pop()};
+                CHECK(e.attempt == attempt + 1);
+            }
+        }
+        retries.schedule(arena.append("x"), 1, 0, {}, {}, 5s);
+        CHECK(retries.wait_time() > 4900 && retries.wait_time() <= 5000);
+        CHECK(!retries.ready());
+    }
+
+
+    /**
+     * @brief      Bodies are popped in order of their due time, with their
+     * tickets, and counted in items() and bytes() while they wait.
+     */
+    auto order() {
+        request_arena arena{};
+        retry_scheduler retries{retry_options{.max_retries = 1,
+                                              .base_delay = 0ms}};
+        CHECK(retries.wait_time() == -1 && !retries.ready());
+        std::vector<uint64_t> tickets{1, 2};
+        auto enqueued{retry_scheduler::clock_type::now()};
+        retries.schedule(arena.append("later"), 2, 0, tickets, enqueued, 1s);
+        retries.schedule(arena.append("now"), 1, 0, {}, enqueued);
+        CHECK(retries.size() == 2 && retries.items() == 3);
+        CHECK(retries.bytes() == 8);
+        CHECK(retries.ready() && retries.wait_time() == 0);
+        auto first{retries.pop()};
+        CHECK(first.body.body() == "now" && first.items == 1);
+        CHECK(!retries.ready());
+        auto second{retries.pop()};
+        CHECK(second.body.body() == "later" && second.tickets == tickets);
+        CHECK(second.enqueued == enqueued);
+        CHECK(retries.size() == 0 && retries.items() == 0);
+        CHECK(retries.bytes() == 0);
+    }
+
+
+    /**
+     * @brief      Answers a single post with the given head on 127.0.0.1.
+     */
+    class one_shot_server {
+      private:
+        int _fd{::socket(AF_INET, SOCK_STREAM, 0)};
+        uint16_t _port{0};
+        std::thread _thread{};
+
+      public:
+        explicit one_shot_server(std::string head) {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t size{sizeof(addr)};
+            CHECK(_fd != -1);
+            CHECK(::bind(_fd, reinterpret_cast<sockaddr *>(&addr), size) ==
+                  0);
+            CHECK(::listen(_fd, 1) == 0);
+            CHECK(::getsockname(
+                      _fd, reinterpret_cast<sockaddr *>(&addr), &size) == 0);
+            _port = ntohs(addr.sin_port);
+            _thread = std::thread{[this, head = std::move(head)] {
+                auto c{::accept(_fd, nullptr, nullptr)};
+                std::string in{};
+                char buffer[4096];
+                /*the posted body is "x"*/
+                while (!in.ends_with("\r\n\r\nx")) {
+                    auto n{::recv(c, buffer, sizeof(buffer), 0)};
+                    if (n <= 0) { break; }
+                    in.append(buffer, static_cast<size_t>(n));
+                }
+                auto out{head + "Content-Length: 0\r\n"
+                                "Connection: close\r\n\r\n"};
+                ::send(c, out.data(), out.size(), MSG_NOSIGNAL);
+                ::close(c);
+            }};
+        }
+
+        ~one_shot_server() {
+            _thread.join();
+            ::close(_fd);
+        }
+
+        auto url() const { return std::format("http://127.0.0.1:{}/", _port); }
+    };
+
+
+    /**
+     * @brief      Posts "x" and returns the delay of Retry-After.
+     */
+    auto retry_after_of(std::string head) {
+        one_shot_server server{std::move(head)};
+        cppurl::b_handle h{};
+        CHECK(h.url(server.url()));
+        CHECK(h.post<true>("x"));
+        CHECK(h.perform());
+        auto code{h.response_code()};
+        CHECK(code && *code == 503);
+        auto delay{h.retry_after()};
+        CHECK(delay);
+        return *delay;
+    }
+
+
+    /**
+     * @brief      The Retry-After header is read from the response (0 if
+     * there is none).
+     */
+    auto retry_after() {
+        CHECK(retry_after_of("HTTP/1.1 503 Service Unavailable\r\n"
+                             "Retry-After: 7\r\n") == 7s);
+        CHECK(retry_after_of("HTTP/1.1 503 Service Unavailable\r\n") == 0s);
+    }
+
+}  // namespace
+
+
+int main() {
+    cppurl::curl_global global{};
+    retryable();
+    backoff();
+    order();
+    retry_after();
+}
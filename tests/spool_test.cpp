@@ -0,0 +1,222 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <spool.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::spool;
+    using cppurl::spool_options;
+    using namespace std::chrono_literals;
+
+
+    /**
+     * @brief      Unique temporary directory removed at the end of the test.
+     */
+    struct temporary_directory {
+        std::string path{};
+
+        temporary_directory() {
+            auto pattern{(std::filesystem::temp_directory_path() /
+                          "spool_test.XXXXXX")
+                             .string()};
+            CHECK(::mkdtemp(pattern.data()) != nullptr);
+            path = pattern;
+        }
+
+        ~temporary_directory() { std::filesystem::remove_all(path); }
+
+        auto segments() const {
+            return std::distance(std::filesystem::directory_iterator{path},
+                                 std::filesystem::directory_iterator{});
+        }
+    };
+
+
+    /**
+     * @brief      Replayed request.
+     */
+    struct replayed {
+        spool::ticket ticket{};
+        std::string body{};
+        spool::clock_type::time_point appended{};
+    };
+
+
+    auto replay_all(spool &s) {
+        std::vector<replayed> all{};
+        s.replay([&](spool::ticket t,
+                     std::string_view body,
+                     spool::clock_type::time_point appended) {
+            all.push_back({t, std::string{body}, appended});
+        });
+        return all;
+    }
+
+
+    /**
+     * @brief      Runs f(spool) in a child process which exits without
+     * destroying the spool, like a crashed process.
+     */
+    auto crash_after(const spool_options &options, auto &&f) {
+        auto pid{::fork()};
+        CHECK(pid != -1);
+        if (pid == 0) {
+            spool s{options};
+            f(s);
+            ::_exit(0);
+        }
+        int status{};
+        CHECK(::waitpid(pid, &status, 0) == pid);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+
+    /**
+     * @brief      A ticket holds the sequence number of its segment in the
+     * upper and the offset of its record in the lower 32 bits, no_ticket is
+     * never returned for a stored request.
+     */
+    auto tickets() {
+        temporary_directory d{};
+        spool s{{.directory = d.path}};
+        auto a{s.append("a")};
+        auto b{s.append("b")};
+        CHECK(a != spool::no_ticket && b != spool::no_ticket);
+        CHECK(a == (uint64_t{1} << 32));
+        CHECK(b >> 32 == 1 && (b & 0xffffffffu) > 0);
+        CHECK((b & 0xffffffffu) % 8 == 0);
+        CHECK(s.size() == 2);
+        /*unknown, no_ticket and repeated acknowledgements are ignored*/
+        s.acknowledge(std::vector<spool::ticket>{a, a, spool::no_ticket,
+                                                 uint64_t{7} << 32});
+        CHECK(s.size() == 1);
+        CHECK(s.commit());
+    }
+
+
+    /**
+     * @brief      Requests which were not acknowledged before a crash are
+     * replayed once, in order, with the time they were appended. The spool
+     * is empty once they are acknowledged.
+     */
+    auto replay_after_crash() {
+        temporary_directory d{};
+        spool_options options{.directory = d.path};
+        auto before{spool::clock_type::now()};
+        crash_after(options, [](spool &s) {
+            auto first{s.append("first")};
+            s.append("second");
+            s.append("third");
+            s.acknowledge({&first, 1});
+            /*no commit, writes to the mapping survive the process*/
+        });
+        std::this_thread::sleep_for(50ms);
+        {
+            spool s{options};
+            CHECK(s.size() == 2);
+            auto all{replay_all(s)};
+            CHECK(all.size() == 2);
+            CHECK(all[0].body == "second" && all[1].body == "third");
+            for (auto &r : all) {
+                CHECK(r.appended >= before - 1s);
+                CHECK(spool::clock_type::now() - r.appended >= 50ms);
+            }
+            /*only once*/
+            CHECK(replay_all(s).empty());
+            std::vector<spool::ticket> tickets{all[0].ticket, all[1].ticket};
+            s.acknowledge(tickets);
+            CHECK(s.size() == 0);
+        }
+        spool s{options};
+        CHECK(s.size() == 0 && replay_all(s).empty());
+        CHECK(d.segments() == 0);
+    }
+
+
+    /**
+     * @brief      A segment is deleted once all its records are
+     * acknowledged and it is no longer appended to. A record bigger than a
+     * segment gets a segment of its own.
+     */
+    auto segments() {
+        temporary_directory d{};
+        spool s{{.directory = d.path, .segment_size = 4096}};
+        std::string body(1000, 'x');
+        std::vector<spool::ticket> first{};
+        for (int i{0}; i < 3; ++i) { first.push_back(s.append(body)); }
+        auto next{s.append(body)};
+        CHECK(next >> 32 == 1);
+        auto second{s.append(body)};
+        CHECK(second >> 32 == 2);
+        CHECK(d.segments() == 2);
+        first.push_back(next);
+        s.acknowledge(first);
+        CHECK(d.segments() == 1);
+        auto big{s.append(std::string(10000, 'y'))};
+        CHECK(big >> 32 == 3 && d.segments() == 2);
+        s.acknowledge({&second, 1});
+        CHECK(d.segments() == 1);
+        s.acknowledge({&big, 1});
+        /*the current segment is deleted when the spool is closed*/
+        CHECK(d.segments() == 1 && s.size() == 0);
+    }
+
+
+    /**
+     * @brief      Replay stops at a torn record, the records before it are
+     * kept.
+     */
+    auto torn_record() {
+        temporary_directory d{};
+        spool_options options{.directory = d.path};
+        crash_after(options, [](spool &s) {
+            s.append("kept");
+            s.append("also kept");
+            s.append("torn");
+        });
+        spool::ticket last{};
+        {
+            spool s{options};
+            auto all{replay_all(s)};
+            CHECK(all.size() == 3);
+            last = all.back().ticket;
+        }
+        auto path{std::filesystem::directory_iterator{d.path}->path()};
+        auto fd{::open(path.c_str(), O_RDWR)};
+        CHECK(fd != -1);
+        /*flips a byte of the checksum of the last record*/
+        auto at{static_cast<off_t>((last & 0xffffffffu) + 4)};
+        char c{};
+        CHECK(::pread(fd, &c, 1, at) == 1);
+        c = static_cast<char>(~c);
+        CHECK(::pwrite(fd, &c, 1, at) == 1);
+        ::close(fd);
+        spool s{options};
+        auto all{replay_all(s)};
+        CHECK(all.size() == 2);
+        CHECK(all[0].body == "kept" && all[1].body == "also kept");
+    }
+
+}  // namespace
+
+
+int main() {
+    tickets();
+    replay_after_crash();
+    segments();
+    torn_record();
+}
@@ -0,0 +1,122 @@
+#include <unistd.h>
+
+#include <stdin_reader.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::stdin_reader;
+
+
+    /**
+     * @brief      Pipe whose read end is given to the reader.
+     */
+    struct pipe_fds {
+        int read_end{-1};
+        int write_end{-1};
+
+        pipe_fds() {
+            int fds[2];
+            CHECK(::pipe(fds) == 0);
+            read_end = fds[0];
+            write_end = fds[1];
+        }
+
+        auto write(std::string_view data) {
+            CHECK(::write(write_end, data.data(), data.size()) ==
+                  static_cast<ssize_t>(data.size()));
+        }
+
+        auto close_write_end() {
+            ::close(write_end);
+            write_end = -1;
+        }
+
+        ~pipe_fds() {
+            ::close(read_end);
+            if (write_end != -1) { ::close(write_end); }
+        }
+    };
+
+
+    /**
+     * @brief      Reads all lines which are available.
+     */
+    auto read_all(stdin_reader &reader) {
+        std::vector<std::string> lines{};
+        auto read{reader.read(
+            [&](std::string_view line) { lines.emplace_back(line); })};
+        CHECK(read && *read == lines.size());
+        return lines;
+    }
+
+
+    /**
+     * @brief      A line split over two writes is reported once it is
+     * complete, empty lines are skipped and the unterminated last line is
+     * reported at end of file.
+     */
+    auto lines() {
+        pipe_fds p{};
+        stdin_reader reader{p.read_end};
+        p.write("a\n\nb");
+        CHECK((read_all(reader) == std::vector<std::string>{"a"}));
+        CHECK(!reader.eof());
+        p.write("c\nd");
+        CHECK((read_all(reader) == std::vector<std::string>{"bc"}));
+        p.close_write_end();
+        CHECK((read_all(reader) == std::vector<std::string>{"d"}));
+        CHECK(reader.eof() && reader.wait_fds().empty());
+    }
+
+
+    /**
+     * @brief      Lines longer than max_line_size are skipped, whether they
+     * end in the same read, a later read or at end of file.
+     */
+    auto oversized() {
+        pipe_fds p{};
+        stdin_reader reader{p.read_end, 4};
+        p.write("abcd\nabcde\nxy\n");
+        CHECK((read_all(reader) == std::vector<std::string>{"abcd", "xy"}));
+        CHECK(reader.oversized() == 1);
+        /*the tail is dropped as soon as it is too long*/
+        p.write("ab");
+        CHECK(read_all(reader).empty());
+        p.write("cde");
+        CHECK(read_all(reader).empty());
+        p.write("fgh\nok\n");
+        CHECK((read_all(reader) == std::vector<std::string>{"ok"}));
+        CHECK(reader.oversized() == 2);
+        p.write("toolong");
+        p.close_write_end();
+        CHECK(read_all(reader).empty());
+        CHECK(reader.eof() && reader.oversized() == 3);
+    }
+
+
+    /**
+     * @brief      A read error is returned instead of thrown.
+     */
+    auto read_error() {
+        pipe_fds p{};
+        /*the write end cannot be read*/
+        stdin_reader reader{p.write_end};
+        auto read{reader.read([](std::string_view) {})};
+        CHECK(!read && read.error().code == CURLE_READ_ERROR);
+    }
+
+}  // namespace
+
+
+int main() {
+    lines();
+    oversized();
+    read_error();
+}
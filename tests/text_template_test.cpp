@@ -0,0 +1,116 @@
+#include <json_fields.hpp>
+#include <optional>
+#include <request_arena.hpp>
+#include <string>
+#include <string_view>
+#include <text_template.hpp>
+#include <vector>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::json_fields;
+    using cppurl::text_template;
+
+
+    /**
+     * @brief      Names of the placeholders of a text.
+     */
+    auto names(std::string text) {
+        text_template t{std::move(text)};
+        return std::vector<std::string>{t.names().begin(), t.names().end()};
+    }
+
+
+    /**
+     * @brief      Placeholders are names in braces, any other brace (e.g. of
+     * JSON) is literal text.
+     */
+    auto parsing() {
+        using names_type = std::vector<std::string>;
+        CHECK((names(R"({"id":{id},"text":"{text}"})") ==
+               names_type{"id", "text"}));
+        CHECK((names("{b}{a}{b}") == names_type{"b", "a"}));
+        CHECK((names("{{id}}") == names_type{"id"}));
+        CHECK((names("{a_1}{A2}") == names_type{"a_1", "A2"}));
+        for (auto literal :
+             {"", "{}", "{ id}", "{id }", "{a-b}", "{id", "id}", "{\"id\"}"}) {
+            CHECK(names(literal).empty());
+        }
+    }
+
+
+    /**
+     * @brief      Values of a line are separated by tabs in order of names,
+     * missing ones are empty and surplus ones are ignored.
+     */
+    auto lines() {
+        text_template t{R"({"id":{id},"text":"{text}","again":{id}})"};
+        CHECK(t.render_line("42\thello") ==
+              R"({"id":42,"text":"hello","again":42})");
+        CHECK(t.render_line("7") == R"({"id":7,"text":"","again":7})");
+        CHECK(t.render_line("1\ta\tsurplus") ==
+              R"({"id":1,"text":"a","again":1})");
+        CHECK(t.render_line("") == R"({"id":,"text":"","again":})");
+        text_template braces{"{{id}}"};
+        CHECK(braces.render_line("5") == "{5}");
+        text_template plain{"no placeholders"};
+        CHECK(plain.render_line("x\ty") == "no placeholders");
+    }
+
+
+    /**
+     * @brief      Rendering straight into memory of the caller gives the same
+     * text as render_line.
+     */
+    auto binding() {
+        text_template t{"[{a}|{b}|{a}]"};
+        cppurl::request_arena arena{16};
+        for (std::string_view line : {"x\tyy", "", "long value\t", "1\t2\t3"}) {
+            auto expected{std::string{t.render_line(line)}};
+            auto size{t.bind_line(line)};
+            CHECK(size == expected.size());
+            auto body{arena.append(size, [&](char *data) { t.write(data); })};
+            CHECK(body.body() == expected);
+        }
+    }
+
+
+    /**
+     * @brief      Values of JSON fields of a body.
+     */
+    auto fields() {
+        text_template t{"Idempotency-Key: {id}-{kind}"};
+        json_fields fields{};
+        for (auto name : t.names()) { fields.add(name); }
+        fields.extract(R"({"kind":"a","id":3})");
+        CHECK(t.render_fields(fields) == "Idempotency-Key: 3-a");
+        fields.extract(R"({"other":1})");
+        CHECK(t.render_fields(fields) == "Idempotency-Key: -");
+    }
+
+
+    /**
+     * @brief      A copy does not refer to the text of the original.
+     */
+    auto copy() {
+        std::optional<text_template> original{std::in_place, "<{a}>"};
+        text_template copied{*original};
+        original.reset();
+        CHECK(copied.render_line("x") == "<x>");
+        CHECK(copied.text() == "<{a}>");
+    }
+
+}  // namespace
+
+
+int main() {
+    parsing();
+    lines();
+    binding();
+    fields();
+    copy();
+}
@@ -0,0 +1,87 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <work_stealing_queue.hpp>
+
+#include "check.hpp"
+
+
+namespace {
+
+
+    using cppurl::work_stealing_queue;
+
+
+    /**
+     * @brief      Pops all items which a shard can get at once.
+     */
+    auto pop_all(work_stealing_queue<int> &q, size_t shard, size_t n) {
+        std::vector<int> items{};
+        q.pop(shard, n, [&](int &&item) { items.push_back(item); });
+        return items;
+    }
+
+
+    /**
+     * @brief      A shard takes its own deque from the front, then steals at
+     * most half of another deque from its back.
+     */
+    auto stealing() {
+        work_stealing_queue<int> q{2};
+        /*round robin: 0, 2, 4 go to shard 0 and 1, 3, 5 to shard 1*/
+        for (int i{0}; i < 6; ++i) { q.push(i); }
+        CHECK(q.size() == 6);
+        CHECK((pop_all(q, 0, 2) == std::vector<int>{0, 2}));
+        CHECK((pop_all(q, 0, 10) == std::vector<int>{4, 5, 3}));
+        CHECK(q.size() == 1);
+        CHECK((pop_all(q, 1, 10) == std::vector<int>{1}));
+        CHECK(q.size() == 0 && pop_all(q, 1, 10).empty());
+    }
+
+
+    /**
+     * @brief      Items are passed on after the locks are released, so the
+     * callback may push to the same queue.
+     */
+    auto push_from_callback() {
+        work_stealing_queue<int> q{1};
+        q.push(1);
+        auto popped{q.pop(0, 1, [&](int &&item) { q.push(item + 1); })};
+        CHECK(popped == 1 && q.size() == 1);
+        CHECK((pop_all(q, 0, 1) == std::vector<int>{2}));
+    }
+
+
+    /**
+     * @brief      Every item pushed by a producer is popped exactly once by
+     * concurrent shards.
+     */
+    auto concurrent() {
+        constexpr size_t shards{4};
+        constexpr int items{100'000};
+        work_stealing_queue<int> q{shards};
+        std::vector<std::atomic<int>> seen(items);
+        std::atomic<int> popped{0};
+        std::vector<std::thread> threads{};
+        for (size_t s{0}; s < shards; ++s) {
+            threads.emplace_back([&, s] {
+                while (popped.load() < items) {
+                    popped += static_cast<int>(
+                        q.pop(s, 16, [&](int &&item) { ++seen[item]; }));
+                }
+            });
+        }
+        for (int i{0}; i < items; ++i) { q.push(i); }
+        for (auto &t : threads) { t.join(); }
+        CHECK(popped.load() == items && q.size() == 0);
+        for (auto &n : seen) { CHECK(n.load() == 1); }
+    }
+
+}  // namespace
+
+
+int main() {
+    stealing();
+    push_from_callback();
+    concurrent();
+}